@@ -11,6 +11,11 @@
     @io.github.libxposed.api.annotations.AfterInvocation <methods>;
 }
 
+# JNI
+-keepclasseswithmembernames,includedescriptorclasses class * {
+    native <methods>;
+}
+
 # Kotlin
 -assumenosideeffects class kotlin.jvm.internal.Intrinsics {
 	public static void check*(...);
@@ -0,0 +1,341 @@
+#include "bridge.hpp"
+#include "class_profile.hpp"
+#include "config.hpp"
+#include "fs_cache.hpp"
+#include "fsync_policy.hpp"
+#include "hook_stats.hpp"
+#include "kv_store.hpp"
+#include "logging.hpp"
+#include "mmap_stream.hpp"
+#include "mutf8.hpp"
+#include "property_cache.hpp"
+#include "quiescence.hpp"
+#include "remote_file.hpp"
+#include "stdio_policy.hpp"
+#include "telemetry.hpp"
+#include "trace.hpp"
+#include <bit>
+#include <climits>
+#include <cstdlib>
+#include <iterator>
+#include <jni.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/system_properties.h>
+
+/*
+ * =========================================================================================
+ *  JNI entry points for `NativeBridge.kt`
+ * =========================================================================================
+ *
+ * The Kotlin side of the module talks to this library through the
+ * `io.github.libxposed.example.NativeBridge` object. Every `external fun`
+ * declared there is implemented here and bound eagerly from `JNI_OnLoad`
+ * with `RegisterNatives`, so no call ever goes through ART's name-mangled
+ * symbol lookup, and nothing but `JNI_OnLoad` and `native_init` needs to be
+ * exported.
+ *
+ * There are three binding styles, from most to least expensive per call:
+ *
+ *   regular          full JNI transition; may block, allocate, throw
+ *   @FastNative      skips the thread state change; short, non-blocking
+ *                    calls that still need `JNIEnv` (string arguments)
+ *   @CriticalNative  static, primitives only, no `JNIEnv`/`jclass`; for the
+ *                    hot stats, config and trace calls
+ *
+ * The annotations only exist since Android 8.0 (API 26). Older runtimes call
+ * every method with `JNIEnv *` and `jclass`, so `@CriticalNative`
+ * implementations are registered through an adapter there (`WithEnv`).
+ */
+
+// Copies `string` into `buffer` as (modified) UTF-8 without allocating, or
+// returns nothing if it does not fit. One `GetStringRegion` plus our own
+// encoder (see `mutf8.hpp`) instead of three passes over the string in ART
+// for `GetStringUTFLength`, `GetStringLength` and `GetStringUTFRegion`.
+template <size_t N>
+static std::optional<std::string_view> utf_view(JNIEnv *env, jstring string,
+                                                char (&buffer)[N]) {
+  // Every UTF-16 unit takes at least one byte.
+  jsize length = env->GetStringLength(string);
+  if (length < 0 || static_cast<size_t>(length) >= N) return std::nullopt;
+  jchar units[N];
+  env->GetStringRegion(string, 0, length, units);
+  ptrdiff_t bytes = utf16_to_mutf8(units, length, buffer, N - 1);
+  if (bytes < 0) return std::nullopt;
+  return std::string_view(buffer, bytes);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  @CriticalNative: no JNIEnv, no jclass, primitives only.
+ * -----------------------------------------------------------------------------
+ */
+
+static jlong hook_calls(jint id) {
+  if (static_cast<uint32_t>(id) >= kHookCount) return -1;
+  return static_cast<jlong>(stat_total(static_cast<HookId>(id)));
+}
+
+static jint config_rules_version() {
+  return static_cast<jint>(config_read().rules_version);
+}
+
+static jlong span_begin(jint tag) {
+  return static_cast<jlong>(trace_span_begin(tag));
+}
+
+static void span_end(jlong id) { trace_span_end(static_cast<uint64_t>(id)); }
+
+// The log sink is called on hot hook paths and takes only primitives: a
+// record ID and two arguments, formatted later by `trace_flush`.
+static void log_record(jint id, jlong a, jlong b) {
+  trace_log(static_cast<uint32_t>(id), a, b);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  @FastNative: short calls that need JNIEnv for their string arguments.
+ * -----------------------------------------------------------------------------
+ */
+
+static jlong kv_get_long(JNIEnv *env, jclass, jstring key, jlong fallback) {
+  char buffer[kKvMaxKey + 1];
+  auto view = utf_view(env, key, buffer);
+  return view ? module_settings().get_long(*view, fallback) : fallback;
+}
+
+static jboolean kv_get_boolean(JNIEnv *env, jclass, jstring key,
+                               jboolean fallback) {
+  char buffer[kKvMaxKey + 1];
+  auto view = utf_view(env, key, buffer);
+  if (!view) return fallback;
+  return module_settings().get_bool(*view, fallback) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jdouble kv_get_double(JNIEnv *env, jclass, jstring key,
+                             jdouble fallback) {
+  char buffer[kKvMaxKey + 1];
+  auto view = utf_view(env, key, buffer);
+  return view ? module_settings().get_double(*view, fallback) : fallback;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Regular: calls that may block, map files, install hooks or are rare.
+ * -----------------------------------------------------------------------------
+ */
+
+// Writers take the store's lock and may probe every slot, so they are not
+// @FastNative: a writer waiting for the lock would hold up GC suspension.
+static jboolean kv_put(JNIEnv *env, jstring key, KvValue value) {
+  char buffer[kKvMaxKey + 1];
+  auto view = utf_view(env, key, buffer);
+  return view && module_settings().put(*view, value) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean kv_put_long(JNIEnv *env, jclass, jstring key, jlong value) {
+  return kv_put(env, key, {kKvLong, static_cast<uint64_t>(value)});
+}
+
+static jboolean kv_put_boolean(JNIEnv *env, jclass, jstring key,
+                               jboolean value) {
+  return kv_put(env, key, {kKvBool, value ? 1u : 0u});
+}
+
+static jboolean kv_put_double(JNIEnv *env, jclass, jstring key,
+                              jdouble value) {
+  return kv_put(env, key, {kKvDouble, std::bit_cast<uint64_t>(value)});
+}
+
+static jboolean kv_remove(JNIEnv *env, jclass, jstring key) {
+  char buffer[kKvMaxKey + 1];
+  auto view = utf_view(env, key, buffer);
+  return view && module_settings().remove(*view) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean map_telemetry(JNIEnv *, jclass, jint fd) {
+  return telemetry_map(fd) ? JNI_TRUE : JNI_FALSE;
+}
+
+static void push_config(JNIEnv *, jclass, jint rules_version,
+                        jint enabled_hooks, jint sample_every, jint budget_us,
+                        jint features) {
+  config_publish({
+      .rules_version = static_cast<uint32_t>(rules_version),
+      .enabled_hooks = static_cast<uint32_t>(enabled_hooks),
+      .sample_every = static_cast<uint32_t>(sample_every),
+      .budget_us = static_cast<uint32_t>(budget_us),
+      .features = static_cast<uint32_t>(features),
+  });
+}
+
+static jboolean kv_open(JNIEnv *, jclass, jint fd, jboolean writable) {
+  return module_settings().map(fd, writable) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jlong map_remote_file(JNIEnv *env, jclass, jstring name, jint fd) {
+  char buffer[kMaxRemoteFileName + 1];
+  auto view = utf_view(env, name, buffer);
+  return view ? remote_file_map(*view, fd) : -1;
+}
+
+static jstring remote_file_text(JNIEnv *env, jclass, jstring name) {
+  char buffer[kMaxRemoteFileName + 1];
+  auto view = utf_view(env, name, buffer);
+  if (!view) return nullptr;
+  // Copy inside a read-side section, so a concurrent remap cannot release it.
+  uint32_t token = quiescence_enter();
+  std::string text(remote_file_view(*view));
+  quiescence_exit(token);
+  return env->NewStringUTF(text.c_str());
+}
+
+static jint start_class_profile(JNIEnv *env, jclass, jstring path,
+                                jobject loader) {
+  if (!(config_read().features & kFeatureClassProfile)) return 0;
+  char buffer[PATH_MAX];
+  auto view = utf_view(env, path, buffer);
+  if (!view) return 0;
+  buffer[view->size()] = '\0';
+  return static_cast<jint>(class_profile_start(env, buffer, loader));
+}
+
+static void configure_fs_cache(JNIEnv *env, jclass, jstring prefixes,
+                               jint ttl_ms) {
+  char buffer[kMaxFsPrefixes * (kMaxFsPrefix + 1)];
+  auto view = utf_view(env, prefixes, buffer);
+  // Too long to be valid: cache nothing rather than a truncated list.
+  fs_cache_configure(view ? *view : std::string_view(),
+                     ttl_ms > 0 ? static_cast<uint32_t>(ttl_ms) : 0);
+}
+
+static void configure_property_cache(JNIEnv *env, jclass, jstring names) {
+  char buffer[kMaxCachedProperties * (kMaxCachedPropertyName + 1)];
+  auto view = utf_view(env, names, buffer);
+  property_cache_configure(view ? *view : std::string_view());
+}
+
+static void configure_stdio_policy(JNIEnv *env, jclass, jstring rules) {
+  // Room for every rule with the longest tail, " 1024 sequential\n".
+  char buffer[kMaxStdioRules * (kMaxStdioPrefix + 17)];
+  auto view = utf_view(env, rules, buffer);
+  stdio_policy_configure(view ? *view : std::string_view());
+}
+
+static void configure_mmap_streams(JNIEnv *env, jclass, jstring prefixes,
+                                   jint min_kib) {
+  char buffer[kMaxMmapPrefixes * (kMaxMmapPrefix + 1)];
+  auto view = utf_view(env, prefixes, buffer);
+  mmap_stream_configure(view ? *view : std::string_view(),
+                        min_kib > 0 ? static_cast<uint32_t>(min_kib) : 0);
+}
+
+static void configure_fsync_policy(JNIEnv *env, jclass, jstring rules) {
+  // Room for every rule with the longest tail, " passthrough 5000\n".
+  char buffer[kMaxFsyncRules * (kMaxFsyncPrefix + 18)];
+  auto view = utf_view(env, rules, buffer);
+  fsync_policy_configure(view ? *view : std::string_view());
+}
+
+static void register_log_format(JNIEnv *env, jclass, jint id, jstring format) {
+  char buffer[kMaxLogFormat + 1];
+  auto view = utf_view(env, format, buffer);
+  if (!view) return;
+  buffer[view->size()] = '\0';
+  trace_set_format(static_cast<uint32_t>(id), buffer);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Binding tables
+ * -----------------------------------------------------------------------------
+ */
+
+// Adapts a @CriticalNative implementation to the regular JNI calling
+// convention, for runtimes that ignore the annotation.
+template <auto Fn> struct WithEnv;
+
+template <typename R, typename... Args, R (*Fn)(Args...)> struct WithEnv<Fn> {
+  static R call(JNIEnv *, jclass, Args... args) { return Fn(args...); }
+};
+
+#define CRITICAL_METHODS(X)                                                    \
+  X("hookCalls", "(I)J", hook_calls)                                           \
+  X("configRulesVersion", "()I", config_rules_version)                         \
+  X("spanBegin", "(I)J", span_begin)                                           \
+  X("spanEnd", "(J)V", span_end)                                               \
+  X("logRecord", "(IJJ)V", log_record)
+
+#define CRITICAL_ENTRY(name, signature, fn) {name, signature, (void *)fn},
+#define ADAPTED_ENTRY(name, signature, fn)                                     \
+  {name, signature, (void *)WithEnv<fn>::call},
+
+static const JNINativeMethod kCriticalMethods[] = {
+    CRITICAL_METHODS(CRITICAL_ENTRY)};
+
+static const JNINativeMethod kAdaptedCriticalMethods[] = {
+    CRITICAL_METHODS(ADAPTED_ENTRY)};
+
+static const JNINativeMethod kMethods[] = {
+    // @FastNative
+    {"kvGetLong", "(Ljava/lang/String;J)J", (void *)kv_get_long},
+    {"kvGetBoolean", "(Ljava/lang/String;Z)Z", (void *)kv_get_boolean},
+    {"kvGetDouble", "(Ljava/lang/String;D)D", (void *)kv_get_double},
+    // Regular
+    {"kvPutLong", "(Ljava/lang/String;J)Z", (void *)kv_put_long},
+    {"kvPutBoolean", "(Ljava/lang/String;Z)Z", (void *)kv_put_boolean},
+    {"kvPutDouble", "(Ljava/lang/String;D)Z", (void *)kv_put_double},
+    {"kvRemove", "(Ljava/lang/String;)Z", (void *)kv_remove},
+    {"mapTelemetry", "(I)Z", (void *)map_telemetry},
+    {"pushConfig", "(IIIII)V", (void *)push_config},
+    {"kvOpen", "(IZ)Z", (void *)kv_open},
+    {"mapRemoteFile", "(Ljava/lang/String;I)J", (void *)map_remote_file},
+    {"remoteFileText", "(Ljava/lang/String;)Ljava/lang/String;",
+     (void *)remote_file_text},
+    {"registerLogFormat", "(ILjava/lang/String;)V",
+     (void *)register_log_format},
+    {"classProfileStart", "(Ljava/lang/String;Ljava/lang/ClassLoader;)I",
+     (void *)start_class_profile},
+    {"configureFsCache", "(Ljava/lang/String;I)V", (void *)configure_fs_cache},
+    {"configurePropertyCache", "(Ljava/lang/String;)V",
+     (void *)configure_property_cache},
+    {"configureStdioPolicy", "(Ljava/lang/String;)V",
+     (void *)configure_stdio_policy},
+    {"configureMmapStreams", "(Ljava/lang/String;I)V",
+     (void *)configure_mmap_streams},
+    {"configureFsyncPolicy", "(Ljava/lang/String;)V",
+     (void *)configure_fsync_policy},
+};
+
+static int device_api_level() {
+  char value[PROP_VALUE_MAX] = "";
+  __system_property_get("ro.build.version.sdk", value);
+  return atoi(value);
+}
+
+static bool register_table(JNIEnv *env, jclass clazz,
+                           const JNINativeMethod *methods, jint count) {
+  if (env->RegisterNatives(clazz, methods, count) == JNI_OK) return true;
+  env->ExceptionClear();
+  LOGE("RegisterNatives failed for %s", methods[0].name);
+  return false;
+}
+
+bool bridge_register_natives(JNIEnv *env) {
+  jclass bridge = env->FindClass("io/github/libxposed/example/NativeBridge");
+  if (bridge == nullptr) {
+    env->ExceptionClear();
+    LOGE("NativeBridge not found");
+    return false;
+  }
+  bool critical_supported = device_api_level() >= 26;
+  bool ok = register_table(env, bridge, kMethods, std::size(kMethods)) &&
+            (critical_supported
+                 ? register_table(env, bridge, kCriticalMethods,
+                                  std::size(kCriticalMethods))
+                 : register_table(env, bridge, kAdaptedCriticalMethods,
+                                  std::size(kAdaptedCriticalMethods)));
+  env->DeleteLocalRef(bridge);
+  return ok;
+}
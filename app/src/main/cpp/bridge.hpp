@@ -0,0 +1,13 @@
+#pragma once
+
+#include <jni.h>
+
+/**
+ * @brief Binds every `NativeBridge` method from the table in `bridge.cpp`.
+ *
+ * Called from `JNI_OnLoad`, where `FindClass` resolves through the class
+ * loader that loaded this library.
+ *
+ * @return `true` on success. On failure the pending exception is cleared.
+ */
+bool bridge_register_natives(JNIEnv *env);
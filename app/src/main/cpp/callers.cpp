@@ -0,0 +1,77 @@
+#include "callers.hpp"
+#include "freeze.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+#include <mutex>
+
+constexpr size_t kCallSites = 1024;
+constexpr size_t kCallSiteProbes = 16;
+constexpr size_t kLibraryName = 48;
+
+// Each call site entry packs the return address (code addresses fit in 56
+// bits) with the library number in the low byte, so one load yields both.
+// Zero marks a free entry.
+static std::atomic<uint64_t> call_sites[kCallSites];
+
+struct Library {
+  uintptr_t base;
+  char name[kLibraryName];
+};
+
+// Library 0 is the catch-all. Entries are written under `library_mutex` and
+// published through `library_count`; they never change afterwards.
+static Library libraries[kMaxCallerLibraries] = {{0, "<other>"}};
+static std::atomic<uint32_t> library_count{1};
+static ForkMutex library_mutex;
+
+static uint32_t library_for_base(uintptr_t base, const char *path) {
+  std::lock_guard lock(library_mutex);
+  uint32_t count = library_count.load(std::memory_order_relaxed);
+  for (uint32_t id = 1; id < count; ++id) {
+    if (libraries[id].base == base) return id;
+  }
+  if (count == kMaxCallerLibraries) return 0;
+  const char *slash = strrchr(path, '/');
+  libraries[count].base = base;
+  snprintf(libraries[count].name, kLibraryName, "%s",
+           slash != nullptr ? slash + 1 : path);
+  library_count.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+static uint32_t resolve(void *return_address) {
+  Dl_info info{};
+  if (dladdr(return_address, &info) == 0 || info.dli_fname == nullptr) {
+    return 0;
+  }
+  return library_for_base(reinterpret_cast<uintptr_t>(info.dli_fbase),
+                          info.dli_fname);
+}
+
+uint32_t caller_library(void *return_address) {
+  uint64_t address = reinterpret_cast<uintptr_t>(return_address);
+  size_t start = (address * 0x9e3779b97f4a7c15ull) >> 54;
+  for (size_t i = 0; i < kCallSiteProbes; ++i) {
+    std::atomic<uint64_t> &site = call_sites[(start + i) % kCallSites];
+    uint64_t entry = site.load(std::memory_order_relaxed);
+    if (entry == 0) {
+      uint32_t id = resolve(return_address);
+      // Losing the race to another thread resolving the same site is fine:
+      // both computed the same entry.
+      uint64_t expected = 0;
+      site.compare_exchange_strong(expected, (address << 8) | id,
+                                   std::memory_order_relaxed);
+      return id;
+    }
+    if ((entry >> 8) == address) return entry & 0xff;
+  }
+  // Cache neighbourhood full: resolving every time would stall the caller.
+  return 0;
+}
+
+const char *caller_library_name(uint32_t id) {
+  if (id >= library_count.load(std::memory_order_acquire)) return "?";
+  return libraries[id].name;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Calling libraries
+ * =========================================================================================
+ *
+ * Profiles and leak reports are only actionable if they say *which* library
+ * of the target app made the calls. `caller_library` maps a return address
+ * to a small library number that can index per-library counter arrays.
+ *
+ * `dladdr` is far too slow for a hook call path (it takes the linker's
+ * lock), so results are cached per call site. A program has few call sites
+ * into any given function, so after warm-up a lookup is one hash and one
+ * relaxed load:
+ *
+ *   return address --> [ call site cache ] --hit--> library number
+ *                             | miss
+ *                             v
+ *                        dladdr -> load base -> [ library table ]
+ *
+ * Library 0 collects calls from JIT code, anonymous mappings, libraries
+ * beyond `kMaxCallerLibraries` and call sites that did not fit the cache.
+ * A library that is unloaded keeps its number; one loaded later at the same
+ * base inherits it, which is acceptable for reports.
+ */
+
+constexpr uint32_t kMaxCallerLibraries = 64;
+
+/**
+ * @brief Returns the number of the library containing `return_address`, in
+ *        [0, kMaxCallerLibraries).
+ *
+ * Must not be called with the linker lock held, i.e. not from within
+ * `dlopen`/`dlclose` callbacks.
+ */
+uint32_t caller_library(void *return_address);
+
+/**
+ * @brief Returns the file name of library `id`, for reports.
+ */
+const char *caller_library_name(uint32_t id);
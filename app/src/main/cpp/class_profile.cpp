@@ -0,0 +1,271 @@
+#include "class_profile.hpp"
+#include "clock.hpp"
+#include "freeze.hpp"
+#include "hook_thread.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+constexpr size_t kClassSlots = 1024;
+constexpr size_t kClassProbes = 64;
+constexpr size_t kMaxClassName = 127;
+constexpr size_t kMaxProfileBytes = 256 * 1024;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Table
+ * -----------------------------------------------------------------------------
+ */
+
+struct ClassSlot {
+  // FNV-1a of the name, never 0; 0 marks a free slot.
+  std::atomic<uint64_t> hash;
+  // Set once `name` and `first_use` are written by the claiming thread.
+  std::atomic<bool> named;
+  uint32_t first_use;
+  std::atomic<uint32_t> count;
+  char name[kMaxClassName + 1];
+};
+
+static ClassSlot classes[kClassSlots];
+static std::atomic<uint32_t> next_first_use{0};
+static std::atomic<bool> dirty{false};
+
+static uint64_t name_hash(const char *name, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(name[i])) * 0x100000001b3ull;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+// Adds `count` lookups of `name`, claiming a slot for it if it is new.
+// `first_use` is only used for new slots; UINT32_MAX takes the next one.
+static void add(const char *name, uint32_t count, uint32_t first_use) {
+  size_t length = strlen(name);
+  if (length > kMaxClassName) return;
+  uint64_t hash = name_hash(name, length);
+  size_t start = hash % kClassSlots;
+  for (size_t i = 0; i < kClassProbes; ++i) {
+    ClassSlot &slot = classes[(start + i) % kClassSlots];
+    uint64_t seen = slot.hash.load(std::memory_order_acquire);
+    if (seen == 0 && slot.hash.compare_exchange_strong(
+                         seen, hash, std::memory_order_acq_rel)) {
+      memcpy(slot.name, name, length + 1);
+      slot.first_use = first_use != UINT32_MAX
+                           ? first_use
+                           : next_first_use.fetch_add(
+                                 1, std::memory_order_relaxed);
+      slot.count.fetch_add(count, std::memory_order_relaxed);
+      slot.named.store(true, std::memory_order_release);
+      dirty.store(true, std::memory_order_relaxed);
+      return;
+    }
+    if (seen != hash) continue;
+    slot.count.fetch_add(count, std::memory_order_relaxed);
+    // Read-mostly: only the first lookup after a save writes the line.
+    if (!dirty.load(std::memory_order_relaxed)) {
+      dirty.store(true, std::memory_order_relaxed);
+    }
+    return;
+  }
+}
+
+void class_profile_record(const char *name) { add(name, 1, UINT32_MAX); }
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Persistence. One line per class: "<count> <first use> <name>".
+ * -----------------------------------------------------------------------------
+ */
+
+struct ProfileEntry {
+  uint32_t count;
+  uint32_t first_use;
+  std::string name;
+};
+
+// Guards `profile_path` and serializes saves.
+static ForkMutex save_mutex;
+static char profile_path[PATH_MAX];
+
+// `open`/`read` rather than `fopen`: our own `fopen` hook is not for us.
+static std::vector<ProfileEntry> read_profile(const char *path) {
+  std::vector<ProfileEntry> entries;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return entries;
+  std::string text;
+  char chunk[4096];
+  ssize_t n;
+  while (text.size() < kMaxProfileBytes &&
+         (n = read(fd, chunk, sizeof(chunk))) > 0) {
+    text.append(chunk, n);
+  }
+  close(fd);
+
+  if (!text.empty() && text.back() != '\n') text += '\n';
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    text[end] = '\0';
+    unsigned count, first_use;
+    char name[kMaxClassName + 1];
+    // The header and malformed lines do not match.
+    if (sscanf(&text[pos], "%u %u %127s", &count, &first_use, name) == 3) {
+      entries.push_back({count, first_use, name});
+    }
+    pos = end + 1;
+  }
+  return entries;
+}
+
+static bool write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool write_profile(const char *path) {
+  // Per process: a forked child saves the same profile as its parent.
+  char temp[PATH_MAX];
+  if (snprintf(temp, sizeof(temp), "%s.%d.tmp", path, getpid()) >=
+      (int)sizeof(temp)) {
+    return false;
+  }
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) return false;
+
+  std::string text = "# class profile v1\n";
+  char line[kMaxClassName + 32];
+  for (auto &slot : classes) {
+    if (!slot.named.load(std::memory_order_acquire)) continue;
+    snprintf(line, sizeof(line), "%u %u %s\n",
+             slot.count.load(std::memory_order_relaxed), slot.first_use,
+             slot.name);
+    text += line;
+  }
+  bool ok = write_all(fd, text.data(), text.size()) && fsync(fd) == 0;
+  close(fd);
+  // Readers see either the old file or the complete new one.
+  if (ok && rename(temp, path) == 0) return true;
+  unlink(temp);
+  return false;
+}
+
+void class_profile_save() {
+  std::lock_guard lock(save_mutex);
+  if (profile_path[0] == '\0') return;
+  if (!dirty.exchange(false, std::memory_order_relaxed)) return;
+  if (!write_profile(profile_path)) {
+    LOGW("class profile: saving %s failed: %s", profile_path,
+         strerror(errno));
+  }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Preloading
+ * -----------------------------------------------------------------------------
+ */
+
+static void preload(JavaVM *vm, jobject loader,
+                    std::vector<std::string> names) {
+  pthread_setname_np(pthread_self(), "class-preload");
+  JNIEnv *env = nullptr;
+  if (vm->AttachCurrentThreadAsDaemon(&env, nullptr) != JNI_OK) return;
+  // Everything this thread does is ours, not the app's.
+  hook_thread_state().in_hook = kHookBypassAll;
+
+  int64_t start = monotonic_ns();
+  uint32_t loaded = 0;
+  jclass loader_class = env->GetObjectClass(loader);
+  jmethodID load_class = env->GetMethodID(
+      loader_class, "loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
+  for (size_t i = 0; load_class != nullptr && i < names.size(); ++i) {
+    std::replace(names[i].begin(), names[i].end(), '/', '.');
+    jstring name = env->NewStringUTF(names[i].c_str());
+    jvalue arg;
+    arg.l = name;
+    jobject clazz = env->CallObjectMethodA(loader, load_class, &arg);
+    if (env->ExceptionCheck()) {
+      // Classes the app found through another loader; skip them.
+      env->ExceptionClear();
+    } else {
+      ++loaded;
+    }
+    env->DeleteLocalRef(clazz);
+    env->DeleteLocalRef(name);
+  }
+  if (env->ExceptionCheck()) env->ExceptionClear();
+  LOGI("class profile: preloaded %u of %zu classes in %lld us", loaded,
+       names.size(), (long long)((monotonic_ns() - start) / 1000));
+
+  env->DeleteLocalRef(loader_class);
+  env->DeleteGlobalRef(loader);
+  vm->DetachCurrentThread();
+}
+
+uint32_t class_profile_start(JNIEnv *env, const char *path, jobject loader) {
+  {
+    std::lock_guard lock(save_mutex);
+    snprintf(profile_path, sizeof(profile_path), "%s", path);
+  }
+  std::vector<ProfileEntry> entries = read_profile(path);
+  // Older runs count half, so classes that fell out of use fade away.
+  uint32_t last_use = 0;
+  for (auto &entry : entries) {
+    add(entry.name.c_str(), std::max(entry.count / 2, 1u), entry.first_use);
+    last_use = std::max(last_use, std::min(entry.first_use, UINT32_MAX - 2));
+  }
+  // Classes new in this run are first used after every loaded one.
+  uint32_t next = next_first_use.load(std::memory_order_relaxed);
+  while (!entries.empty() && next <= last_use &&
+         !next_first_use.compare_exchange_weak(next, last_use + 1,
+                                               std::memory_order_relaxed)) {
+  }
+
+  // Array classes cannot be loaded by name.
+  std::erase_if(entries, [](const ProfileEntry &entry) {
+    return entry.name.starts_with('[');
+  });
+  if (entries.size() > kPreloadClasses) {
+    std::nth_element(entries.begin(), entries.begin() + kPreloadClasses,
+                     entries.end(), [](const auto &a, const auto &b) {
+                       return a.count > b.count;
+                     });
+    entries.resize(kPreloadClasses);
+  }
+  // Load in the order the app first needed them, which also loads
+  // superclasses before the classes that depend on them.
+  std::sort(entries.begin(), entries.end(),
+            [](const auto &a, const auto &b) {
+              return a.first_use < b.first_use;
+            });
+  std::vector<std::string> names;
+  for (auto &entry : entries) names.push_back(std::move(entry.name));
+  if (names.empty()) return 0;
+
+  JavaVM *vm = nullptr;
+  if (env->GetJavaVM(&vm) != JNI_OK) return 0;
+  jobject global = env->NewGlobalRef(loader);
+  if (global == nullptr) return 0;
+  uint32_t count = names.size();
+  std::thread(preload, vm, global, std::move(names)).detach();
+  return count;
+}
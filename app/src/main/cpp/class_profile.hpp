@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <jni.h>
+
+/*
+ * =========================================================================================
+ *  Hot-class profile and startup preloading
+ * =========================================================================================
+ *
+ * The first `FindClass` of a class is expensive: ART searches the class
+ * loader chain, opens the dex entry, then loads and links the class. Native
+ * libraries tend to do those lookups during startup, on the main thread.
+ *
+ * With `kFeatureClassProfile`, `fake_FindClass` records every successful
+ * lookup: how often each class was looked up and in which order classes were
+ * first seen. The profile is persisted next to the app's cache, and on the
+ * next start the hottest classes are loaded on a background thread through
+ * the app's class loader before the app gets to them:
+ *
+ *   run N:    FindClass --> record(name) --> [ table ] --> save (watchdog)
+ *                                                             |
+ *   run N+1:  classProfileStart --> load <--------------------+
+ *                  |
+ *                  v
+ *             "class-preload" thread: loader.loadClass() for the top
+ *             `kPreloadClasses` by count, in first-use order
+ *
+ * `loadClass` loads and links but does not initialize, so no static
+ * initializer runs earlier than it would have. Counts from earlier runs are
+ * halved on load, so classes that stop being used fade out.
+ *
+ * The file is written with `open`/`write`/`fsync`/`rename`, so a crash
+ * leaves either the old or the new profile, never a torn one.
+ */
+
+constexpr uint32_t kPreloadClasses = 256;
+constexpr uint32_t kClassProfileSaveWindows = 30;
+
+/**
+ * @brief Records one successful lookup of `name` (a JNI class name such as
+ *        `java/lang/String`). Lock-free; called from `find_class_enforce`.
+ */
+void class_profile_record(const char *name);
+
+/**
+ * @brief Loads the profile stored at `path`, remembers `path` for saving, and
+ *        starts preloading its hottest classes through `loader`.
+ *
+ * Returns immediately; the preloading runs on its own thread.
+ *
+ * @return The number of classes scheduled for preloading.
+ */
+uint32_t class_profile_start(JNIEnv *env, const char *path, jobject loader);
+
+/**
+ * @brief Writes the profile if it changed since the last save. Runs on the
+ *        watchdog thread.
+ */
+void class_profile_save();
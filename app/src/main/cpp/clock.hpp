@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+/**
+ * @brief Returns `CLOCK_MONOTONIC` in nanoseconds.
+ *
+ * Served from the vDSO on Android, so it is cheap enough for sampled
+ * measurements on hook call paths.
+ */
+inline int64_t monotonic_ns() {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
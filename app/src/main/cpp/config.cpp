@@ -0,0 +1,42 @@
+#include "config.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "seqlock.hpp"
+#include <algorithm>
+#include <mutex>
+
+static Seqlock<ModuleConfig> snapshot{kDefaultConfig};
+// The value being published, written in full before `snapshot` is.
+static ModuleConfig published = kDefaultConfig;
+
+// Serializes writers and listener calls; readers never take it.
+static ForkMutex publish_mutex;
+static void (*listener)(const ModuleConfig &config) = nullptr;
+
+ModuleConfig config_read() { return snapshot.read(); }
+
+void config_publish(const ModuleConfig &requested) {
+  ModuleConfig config = requested;
+  config.sample_every =
+      std::clamp(config.sample_every, uint32_t{1}, kMaxSampleEvery);
+  std::lock_guard lock(publish_mutex);
+  published = config;
+  snapshot.write(config);
+  LOGI("config: rules v%u, hooks %#x, sample 1/%u, budget %u us, "
+       "features %#x",
+       config.rules_version, config.enabled_hooks, config.sample_every,
+       config.budget_us, config.features);
+  if (listener != nullptr) listener(config);
+}
+
+void config_set_listener(void (*fn)(const ModuleConfig &config)) {
+  std::lock_guard lock(publish_mutex);
+  listener = fn;
+}
+
+void config_after_fork() {
+  // A publish cut short in `snapshot.write` would make `config_read` wait
+  // forever; `published` is complete by then.
+  ModuleConfig config;
+  if (!snapshot.try_read(config)) snapshot.write(published);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Module configuration snapshot
+ * =========================================================================================
+ *
+ * The companion app changes settings through remote preferences.
+ * `ModuleMain` listens for those changes and pushes the new values down via
+ * `NativeBridge.pushConfig`, which publishes them here as one snapshot behind
+ * a seqlock (see `seqlock.hpp`). Hooks read a consistent snapshot with two
+ * loads of the sequence number and no lock, no matter how often the app
+ * writes.
+ */
+
+struct ModuleConfig {
+  // Version of the rule set, as written by the app.
+  uint32_t rules_version;
+  // Bitmask over `HookId`; hooks whose bit is clear are removed.
+  uint32_t enabled_hooks;
+  // The watchdog times one hook call in this many, clamped to
+  // [1, kMaxSampleEvery] on publishing.
+  uint32_t sample_every;
+  // The watchdog's self-time budget per call, in microseconds.
+  uint32_t budget_us;
+  // Bitmask of opt-in features (`kFeature*`), all off by default.
+  uint32_t features;
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Opt-in features
+ * -----------------------------------------------------------------------------
+ *
+ * Each `kFeature*` bit turns on one module. They are off by default because
+ * each one hooks functions that apps call on hot paths, and only pays off in
+ * apps that use those functions heavily. The modules share one shape, so
+ * their headers only describe what is specific to them:
+ *
+ *   <module>_init     from `native_init` (`JNI_OnLoad` for JNI functions):
+ *                     attaches the hooks with no rules, see `hook_manager.hpp`
+ *   <module>_enable   from `apply_config` with the feature bit: installs the
+ *                     hooks while it is set and removes them otherwise
+ *   <module>_report   from the watchdog thread every `k*ReportWindows`
+ *                     windows: logs hit rates or counters
+ *
+ * The JNI modules attach on their first enable instead, so a process that
+ * never enables them leaves those functions to the others. `stdio_policy`
+ * and `mmap_stream` have no hooks of their own; their bits are rules of the
+ * `fopen` hook.
+ */
+
+// Wraps JNI functions in profiling thunks, see `jni_profiler.hpp`.
+constexpr uint32_t kFeatureJniProfiler = 1u << 0;
+// Memoizes `Get*MethodID`/`Get*FieldID` results, see `jni_id_cache.hpp`.
+constexpr uint32_t kFeatureJniIdCache = 1u << 1;
+// Decodes non-ASCII `NewStringUTF` input ourselves, see `jni_strings.hpp`.
+constexpr uint32_t kFeatureJniStrings = 1u << 2;
+// Accounts live global references per library, see `global_refs.hpp`.
+constexpr uint32_t kFeatureGlobalRefs = 1u << 3;
+// Records and preloads hot classes, see `class_profile.hpp`.
+constexpr uint32_t kFeatureClassProfile = 1u << 4;
+// Caches `dlsym` results for explicit handles, see `dlsym_cache.hpp`.
+constexpr uint32_t kFeatureDlsymCache = 1u << 5;
+// Caches `stat`/`access`/`opendir` outcomes, see `fs_cache.hpp`.
+constexpr uint32_t kFeatureFsCache = 1u << 6;
+// Caches whitelisted system property values, see `property_cache.hpp`.
+constexpr uint32_t kFeaturePropertyCache = 1u << 7;
+// Tunes stdio buffering and readahead per path, see `stdio_policy.hpp`.
+constexpr uint32_t kFeatureStdioPolicy = 1u << 8;
+// Serves whitelisted read-only `fopen`s from a mapping, see `mmap_stream.hpp`.
+constexpr uint32_t kFeatureMmapStreams = 1u << 9;
+// Applies per-path `fsync`/`fdatasync` policies, see `fsync_policy.hpp`.
+constexpr uint32_t kFeatureFsyncPolicy = 1u << 10;
+
+// Sampling countdowns are `int32_t`: zero, or a negative `jint` from the app,
+// would time every call instead of one in `sample_every`.
+constexpr uint32_t kMaxSampleEvery = 1u << 20;
+
+constexpr ModuleConfig kDefaultConfig{
+    .rules_version = 0,
+    .enabled_hooks = ~0u,
+    .sample_every = 64,
+    .budget_us = 50,
+    .features = 0,
+};
+
+/**
+ * @brief Returns the current configuration snapshot. Lock-free.
+ */
+ModuleConfig config_read();
+
+/**
+ * @brief Publishes a new snapshot and notifies the listener.
+ *
+ * Out-of-range fields are clamped first, so readers and the listener see the
+ * same values.
+ */
+void config_publish(const ModuleConfig &config);
+
+/**
+ * @brief Sets the function called (on the publishing thread) after every
+ *        `config_publish`, used to apply changes that need more than a read,
+ *        such as installing or removing hooks.
+ */
+void config_set_listener(void (*listener)(const ModuleConfig &config));
+
+/**
+ * @brief Completes a publish that another thread had started when the
+ *        process forked. Called from the `pthread_atfork` child handler.
+ */
+void config_after_fork();
@@ -1,14 +1,48 @@
+#include "bridge.hpp"
+#include "class_profile.hpp"
+#include "config.hpp"
+#include "dlsym_cache.hpp"
+#include "freeze.hpp"
+#include "fs_cache.hpp"
+#include "fsync_policy.hpp"
+#include "global_refs.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "jni_id_cache.hpp"
+#include "jni_profiler.hpp"
+#include "jni_strings.hpp"
+#include "kv_store.hpp"
 #include "logging.hpp"
+#include "mmap_stream.hpp"
 #include "native_api.hpp"
+#include "path_rules.hpp"
+#include "property_cache.hpp"
+#include "quiescence.hpp"
+#include "remote_file.hpp"
+#include "stdio_policy.hpp"
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <jni.h>
 #include <string>
+#include <string_view>
 
-// Global variable to store the hook function pointer provided by LSPosed.
-// We receive this in `native_init` and can then use it anywhere else in our
-// code.
-static HookFunType hook_func = nullptr;
+// Rule bits understood by the replacements below. Each hook is installed only
+// while at least one of its rules is active (see `hook_manager.hpp`).
+constexpr uint32_t kTargetFunIncrement = 1u << 0;
+constexpr uint32_t kFopenBlockBanned = 1u << 0;
+constexpr uint32_t kFopenStdioPolicy = 1u << 1;
+constexpr uint32_t kFopenMmapStream = 1u << 2;
+constexpr uint32_t kFopenNoteWrites = 1u << 3;
+constexpr uint32_t kFindClassBlockBaseDex = 1u << 0;
+constexpr uint32_t kFindClassProfile = 1u << 1;
+
+// Settings read from the store the app writes (`kv_store.hpp`); keys must
+// match `NativeBridge.kt`.
+constexpr std::string_view kSettingBlockBanned = "fopen_block_banned";
+// Remote file with one path fragment per line that `fopen` refuses, mapped
+// by `ModuleMain` (`remote_file.hpp`).
+constexpr std::string_view kBlockListFile = "fopen_blocklist.txt";
 
 /*
  * =========================================================================================
@@ -47,10 +81,40 @@ static HookFunType hook_func = nullptr;
 int (*backup)();
 
 // Our replacement function. It must have the same signature as the target.
-int fake() {
+int fake();
+
+// The hook manager entry for `target_fun`. The target address is only known
+// once `libtarget.so` is loaded, see `on_library_loaded`.
+static Hook target_fun_hook{kHookTargetFun, (void *)fake, (void **)&backup};
+
+// The actual logic of the hook. `fake` never changes once installed; it jumps
+// through `target_fun_slot`, so this logic can be swapped at runtime without
+// touching the hook (see `handler_slot.hpp`).
+static int target_fun_increment() {
   // We call the original function via our `backup` pointer
   // and modify its result.
-  return backup() + 1;
+  // Going through `call_backup` lets the watchdog tell the time spent in the
+  // original apart from our own overhead (see `watchdog.hpp`).
+  int value = call_backup(backup);
+  if (hook_rules(target_fun_hook) & kTargetFunIncrement) return value + 1;
+  return value;
+}
+
+static HandlerSlot<int()> target_fun_slot{target_fun_increment};
+
+// If our handler ever becomes too slow, the watchdog swaps it for a handler
+// that calls `backup` directly.
+static void target_fun_trip() {
+  target_fun_slot.exchange(pass_through<backup>);
+}
+
+static HookBudget target_fun_budget{kHookTargetFun, target_fun_trip};
+
+int fake() {
+  // Every replacement forwards to `hook_dispatch`, which counts the call,
+  // lets the watchdog sample it and guards against reentrancy before running
+  // the current handler (see `hook_dispatch.hpp`).
+  return hook_dispatch(target_fun_budget, target_fun_slot, backup);
 }
 
 /*
@@ -64,17 +128,68 @@ int fake() {
  */
 
 // Backup pointer for the original `fopen`.
+// It is written once by `hook_func` before the hook goes live and only read
+// afterwards, so every thread may load it without synchronization.
 FILE *(*backup_fopen)(const char *filename, const char *mode);
 
 // Our replacement `fopen` function.
-FILE *fake_fopen(const char *filename, const char *mode) {
-  // Check if the filename contains the substring "banned".
-  if (strstr(filename, "banned")) {
+FILE *fake_fopen(const char *filename, const char *mode);
+
+static Hook fopen_hook{kHookFopen, (void *)fake_fopen, (void **)&backup_fopen};
+
+// Whether `filename` contains a line of the block list. The view is only
+// valid inside the read section.
+static bool block_listed(std::string_view filename) {
+  bool listed = false;
+  uint32_t token = quiescence_enter();
+  std::string_view list = remote_file_view(kBlockListFile);
+  while (!list.empty() && !listed) {
+    std::string_view line = next_line(list);
+    listed = !line.empty() && filename.find(line) != std::string_view::npos;
+  }
+  quiescence_exit(token);
+  return listed;
+}
+
+// The policy behind our `fopen` hook.
+static FILE *fopen_enforce(const char *filename, const char *mode) {
+  if (hook_rules(fopen_hook) & kFopenBlockBanned) {
+    // Check if the filename contains the substring "banned" (unless the app
+    // turned that off) or a fragment from the app's block list. Both are
+    // read from memory, no JNI.
+    bool banned = strstr(filename, "banned") &&
+                  module_settings().get_bool(kSettingBlockBanned, true);
     // If it does, we deny the request by returning nullptr.
-    return nullptr;
+    if (banned || block_listed(filename)) return nullptr;
+  }
+  // Whitelisted read-only files may be served from a mapping instead.
+  if (hook_rules(fopen_hook) & kFopenMmapStream) {
+    if (FILE *mapped = mmap_stream_open(filename, mode)) return mapped;
   }
   // Otherwise, we call the original `fopen` and let it proceed as normal.
-  return backup_fopen(filename, mode);
+  FILE *file = call_backup(backup_fopen, filename, mode);
+  if (hook_rules(fopen_hook) & kFopenStdioPolicy) {
+    stdio_policy_apply(file, filename);
+  }
+  // A file opened for writing may change what the metadata cache answers.
+  if ((hook_rules(fopen_hook) & kFopenNoteWrites) && mode != nullptr &&
+      strpbrk(mode, "wa+")) {
+    fs_cache_note_write(filename);
+  }
+  return file;
+}
+
+static HandlerSlot<FILE *(const char *, const char *)> fopen_slot{
+    fopen_enforce};
+
+static void fopen_trip() { fopen_slot.exchange(pass_through<backup_fopen>); }
+
+static HookBudget fopen_budget{kHookFopen, fopen_trip};
+
+FILE *fake_fopen(const char *filename, const char *mode) {
+  // If our own code opens a file while we are inside a hook, this goes
+  // straight to `backup_fopen`.
+  return hook_dispatch(fopen_budget, fopen_slot, backup_fopen, filename, mode);
 }
 
 /*
@@ -92,14 +207,82 @@ FILE *fake_fopen(const char *filename, const char *mode) {
 jclass (*backup_FindClass)(JNIEnv *env, const char *name);
 
 // Our replacement `FindClass` function.
-jclass fake_FindClass(JNIEnv *env, const char *name) {
+jclass fake_FindClass(JNIEnv *env, const char *name);
+
+static Hook find_class_hook{kHookFindClass, (void *)fake_FindClass,
+                            (void **)&backup_FindClass};
+
+static jclass find_class_enforce(JNIEnv *env, const char *name) {
   // We check for a specific class name.
-  if (!strcmp(name, "dalvik/system/BaseDexClassLoader")) {
+  if ((hook_rules(find_class_hook) & kFindClassBlockBaseDex) &&
+      !strcmp(name, "dalvik/system/BaseDexClassLoader")) {
     // And block it from being found.
     return nullptr;
   }
   // For all other classes, we call the original function.
-  return backup_FindClass(env, name);
+  jclass clazz = call_backup(backup_FindClass, env, name);
+  // Only lookups that succeeded are worth preloading next time.
+  if (clazz != nullptr && (hook_rules(find_class_hook) & kFindClassProfile)) {
+    class_profile_record(name);
+  }
+  return clazz;
+}
+
+static HandlerSlot<jclass(JNIEnv *, const char *)> find_class_slot{
+    find_class_enforce};
+
+static void find_class_trip() {
+  find_class_slot.exchange(pass_through<backup_FindClass>);
+}
+
+static HookBudget find_class_budget{kHookFindClass, find_class_trip};
+
+jclass fake_FindClass(JNIEnv *env, const char *name) {
+  return hook_dispatch(find_class_budget, find_class_slot, backup_FindClass,
+                       env, name);
+}
+
+// Set at the end of `native_init`.
+static std::atomic<bool> module_ready{false};
+
+/**
+ * @brief Applies a configuration snapshot pushed from `ModuleMain`.
+ *
+ * Hooks whose bit in `enabled_hooks` is clear lose all their rules, which
+ * makes the hook manager remove them; setting the bit again reinstalls them.
+ */
+static void apply_config(const ModuleConfig &config) {
+  auto enabled = [&](HookId id) { return (config.enabled_hooks >> id) & 1; };
+  hook_set_rules(target_fun_hook,
+                 enabled(kHookTargetFun) ? kTargetFunIncrement : 0);
+  uint32_t fopen_rules = kFopenBlockBanned;
+  if (config.features & kFeatureStdioPolicy) fopen_rules |= kFopenStdioPolicy;
+  if (config.features & kFeatureMmapStreams) fopen_rules |= kFopenMmapStream;
+  if (config.features & kFeatureFsCache) fopen_rules |= kFopenNoteWrites;
+  hook_set_rules(fopen_hook, enabled(kHookFopen) ? fopen_rules : 0);
+  uint32_t find_class_rules = kFindClassBlockBaseDex;
+  if (config.features & kFeatureClassProfile) {
+    find_class_rules |= kFindClassProfile;
+  }
+  hook_set_rules(find_class_hook,
+                 enabled(kHookFindClass) ? find_class_rules : 0);
+  watchdog_configure(config.budget_us * 1000ull, kWatchdogWindowMs,
+                     kWatchdogMinSamples);
+  // The ID cache goes first: when both claim a JNI function, the cache wins.
+  jni_id_cache_enable(config.features & kFeatureJniIdCache);
+  jni_strings_enable(config.features & kFeatureJniStrings);
+  global_refs_enable(config.features & kFeatureGlobalRefs);
+  dlsym_cache_enable(config.features & kFeatureDlsymCache);
+  fs_cache_enable(config.features & kFeatureFsCache);
+  fsync_policy_enable(config.features & kFeatureFsyncPolicy);
+  property_cache_enable(config.features & kFeaturePropertyCache);
+  bool profile_jni = config.features & kFeatureJniProfiler;
+  jni_profiler_select(profile_jni ? kJniProfileAll : 0);
+  // A forked child's watchdog thread stayed behind in the parent (see
+  // `freeze.hpp`), so the child's first configuration push starts a new one.
+  // The first start overall is in `native_init`, once every budget and task
+  // is registered.
+  if (module_ready.load(std::memory_order_acquire)) watchdog_start();
 }
 
 /**
@@ -118,8 +301,9 @@ void on_library_loaded(const char *name, void *handle) {
   if (std::string(name).ends_with("libtarget.so")) {
     // If it does, we can now safely look for symbols within it.
     void *target = dlsym(handle, "target_fun");
-    // And apply our hook.
-    hook_func(target, (void *)fake, (void **)&backup);
+    // And apply our hook. The hook manager installs it right away because
+    // `native_init` already enabled its rule.
+    hook_attach(target_fun_hook, target);
   }
 }
 
@@ -130,7 +314,7 @@ void on_library_loaded(const char *name, void *handle) {
  * when the Java side executes `System.loadLibrary()`.
  *
  * It is called *after* `native_init`.
- * By this time, `hook_func` has already been initialized,
+ * By this time, the hook manager has already been initialized,
  * so we can use it to set up JNI-related hooks.
  */
 extern "C" [[gnu::visibility("default")]] [[gnu::used]]
@@ -139,10 +323,21 @@ jint JNI_OnLoad(JavaVM *jvm, void *) {
   JNIEnv *env = nullptr;
   jvm->GetEnv((void **)&env, JNI_VERSION_1_6);
 
+  // Bind the hot `NativeBridge` methods up front (see `bridge.cpp`).
+  bridge_register_natives(env);
+
   // Here, we hook the `FindClass` function from the JNI function table.
-  // `env->functions` points to a table of JNI function pointers.
-  hook_func((void *)env->functions->FindClass, (void *)fake_FindClass,
-            (void **)&backup_FindClass);
+  // `env->functions` points to a table of JNI function pointers. Its rule was
+  // already enabled by `apply_config` in `native_init`.
+  hook_attach(find_class_hook, (void *)env->functions->FindClass);
+
+  // Hand the same table to the opt-in JNI features. The profiler wraps
+  // whatever the current configuration selects, except functions that are
+  // ours already, such as `FindClass`.
+  jni_id_cache_init(jvm, env->functions);
+  jni_strings_init(env->functions);
+  global_refs_init(env->functions);
+  jni_profiler_init(env->functions);
 
   return JNI_VERSION_1_6;
 }
@@ -177,15 +372,51 @@ jint JNI_OnLoad(JavaVM *jvm, void *) {
 extern "C" [[gnu::visibility("default")]] [[gnu::used]]
 NativeOnModuleLoaded native_init(const NativeAPIEntries *entries) {
   LOGD("NativeOnModuleLoaded called");
-  // 1. Save the hook function pointer from the `entries` struct
-  //    into our global variable.
-  hook_func = entries->hookFunc;
+  // 1. Hand the hook/unhook function pointers from the `entries` struct
+  //    to the hook manager.
+  hook_manager_init(entries);
+
+  // 2. Enable the rules of every hook from the current configuration, and
+  //    re-apply them whenever `ModuleMain` pushes a new one. Enabling a rule
+  //    is what installs a hook; clearing all of its rules later removes it
+  //    again, so the process pays nothing while there is nothing to enforce.
+  config_set_listener(apply_config);
+  apply_config(config_read());
+
+  //    Perform any "global" or "early" hooks that should be active
+  //    immediately. Here, we hook `fopen` from the C standard library, and
+  //    the functions behind the optional symbol, metadata and property
+  //    caches and the `fsync` policy.
+  //    `target_fun` is attached once its library loads.
+  hook_attach(fopen_hook, (void *)fopen);
+  dlsym_cache_init();
+  fs_cache_init();
+  fs_cache_watch(fopen_hook, kFopenNoteWrites, fopen_budget);
+  property_cache_init();
+  fsync_policy_init();
+
+  // 3. Put every hook under the watchdog, which switches a hook to
+  //    pass-through if its own overhead exceeds the budget.
+  watchdog_register(target_fun_budget);
+  watchdog_register(fopen_budget);
+  watchdog_register(find_class_budget);
+  watchdog_add_task(quiescence_reclaim, 1);
+  watchdog_add_task(jni_id_cache_report, kJniIdCacheReportWindows);
+  watchdog_add_task(global_refs_report, kGlobalRefReportWindows);
+  watchdog_add_task(dlsym_cache_report, kDlsymReportWindows);
+  watchdog_add_task(fs_cache_report, kFsCacheReportWindows);
+  watchdog_add_task(property_cache_report, kPropertyCacheReportWindows);
+  watchdog_add_task(fsync_policy_report, kFsyncReportWindows);
+  watchdog_add_task(jni_profiler_report, kJniReportWindows);
+  watchdog_add_task(class_profile_save, kClassProfileSaveWindows);
+  watchdog_start();
+  module_ready.store(true, std::memory_order_release);
 
-  // 2. Perform any "global" or "early" hooks that should be active immediately.
-  //    Here, we hook `fopen` from the C standard library.
-  hook_func((void *)fopen, (void *)fake_fopen, (void **)&backup_fopen);
+  // 4. Everything built so far that never changes again is sealed, so that
+  //    children of a forking process keep sharing it (see `freeze.hpp`).
+  freeze_seal();
 
-  // 3. Return the function pointer to our callback.
+  // 5. Return the function pointer to our callback.
   // LSPosed will now call `on_library_loaded` whenever a new library is loaded.
   return on_library_loaded;
 }
@@ -0,0 +1,223 @@
+#include "dlsym_cache.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "seqlock.hpp"
+#include "thread_shard.hpp"
+#include "watchdog.hpp"
+#include <atomic>
+#include <cstring>
+#include <dlfcn.h>
+#include <mutex>
+
+// The only rule of both hooks.
+constexpr uint32_t kDlsymCache = 1u << 0;
+
+constexpr size_t kSymbolSlotBits = 11;
+constexpr size_t kSymbolSlots = size_t{1} << kSymbolSlotBits;
+// Longer names are looked up every time.
+constexpr size_t kMaxCachedSymbol = 55;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Table
+ * -----------------------------------------------------------------------------
+ */
+
+struct SymbolEntry {
+  uint64_t hash;
+  uint64_t generation;
+  void *handle;
+  void *address;
+  char name[kMaxCachedSymbol + 1];
+};
+
+static Seqlock<SymbolEntry> symbols[kSymbolSlots];
+
+// Starts at 1, so that the zeroed slots never match.
+static std::atomic<uint64_t> generation{1};
+
+// Serializes slot writes. Only ever taken with `try_lock`: a thread that
+// finds it busy skips caching rather than wait on an app thread.
+static ForkMutex insert_mutex;
+
+struct alignas(kCacheLine) DlsymShard {
+  std::atomic<uint64_t> lookups;
+  std::atomic<uint64_t> hits;
+};
+
+static DlsymShard shards[kThreadShards];
+
+// FNV-1a over the name, seeded with the handle.
+static uint64_t symbol_hash(void *handle, const char *name, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull ^ reinterpret_cast<uintptr_t>(handle);
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(name[i])) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static Seqlock<SymbolEntry> &slot_for(uint64_t hash) {
+  return symbols[(hash * 0x9e3779b97f4a7c15ull) >> (64 - kSymbolSlotBits)];
+}
+
+static void *find(uint64_t hash, uint64_t current, void *handle,
+                  const char *name) {
+  // A consistent copy, so the name compared is the one stored with `address`.
+  SymbolEntry entry;
+  if (!slot_for(hash).try_read(entry)) return nullptr;
+  if (entry.hash != hash || entry.generation != current ||
+      entry.handle != handle || strcmp(entry.name, name) != 0) {
+    return nullptr;
+  }
+  return entry.address;
+}
+
+static void insert(uint64_t hash, uint64_t seen, void *handle,
+                   const char *name, size_t length, void *address) {
+  std::unique_lock lock(insert_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+  SymbolEntry entry{hash, seen, handle, address, {}};
+  memcpy(entry.name, name, length + 1);
+  slot_for(hash).write(entry);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hooks
+ * -----------------------------------------------------------------------------
+ */
+
+// The linker's entry points behind `dlsym` and `dlclose`, see
+// `dlsym_cache.hpp`.
+void *(*backup_dlsym)(void *handle, const char *symbol, const void *caller);
+int (*backup_dlclose)(void *handle);
+
+static void *fake_dlsym(void *handle, const char *symbol, const void *caller);
+static int fake_dlclose(void *handle);
+
+static Hook dlsym_hook{kHookDlsym, (void *)fake_dlsym, (void **)&backup_dlsym};
+static Hook dlclose_hook{kHookDlclose, (void *)fake_dlclose,
+                         (void **)&backup_dlclose};
+
+static void *dlsym_cached(void *handle, const char *symbol,
+                          const void *caller) {
+  size_t length = symbol != nullptr ? strlen(symbol) : SIZE_MAX;
+  if (!(hook_rules(dlsym_hook) & kDlsymCache) || length > kMaxCachedSymbol) {
+    return call_backup(backup_dlsym, handle, symbol, caller);
+  }
+  DlsymShard &shard = shards[thread_shard()];
+  shard.lookups.fetch_add(1, std::memory_order_relaxed);
+  uint64_t hash = symbol_hash(handle, symbol, length);
+  // Noted before asking the linker; see `dlsym_cache.hpp`.
+  uint64_t current = generation.load(std::memory_order_acquire);
+  if (void *address = find(hash, current, handle, symbol)) {
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    return address;
+  }
+  void *address = call_backup(backup_dlsym, handle, symbol, caller);
+  if (address != nullptr) {
+    insert(hash, current, handle, symbol, length, address);
+  }
+  return address;
+}
+
+static HandlerSlot<void *(void *, const char *, const void *)> dlsym_slot{
+    dlsym_cached};
+
+static void dlsym_trip() { dlsym_slot.exchange(pass_through<backup_dlsym>); }
+
+static HookBudget dlsym_budget{kHookDlsym, dlsym_trip};
+
+static void *fake_dlsym(void *handle, const char *symbol, const void *caller) {
+  // Resolved relative to `caller`, which is the app's and is handed on.
+  if (handle == RTLD_DEFAULT || handle == RTLD_NEXT) {
+    return backup_dlsym(handle, symbol, caller);
+  }
+  return hook_dispatch(dlsym_budget, dlsym_slot, backup_dlsym, handle, symbol,
+                       caller);
+}
+
+// Invalidates regardless of the rules: a missed `dlclose` would leave
+// entries for a handle that a later `dlopen` may hand out again. The first
+// bump makes lookups during the unload miss; they wait for the linker,
+// which this call holds, and the second bump drops what they store.
+static int dlclose_invalidate(void *handle) {
+  generation.fetch_add(1, std::memory_order_release);
+  int result = call_backup(backup_dlclose, handle);
+  generation.fetch_add(1, std::memory_order_release);
+  return result;
+}
+
+static HandlerSlot<int(void *)> dlclose_slot{dlclose_invalidate};
+
+// Without invalidation the cache must not answer either, so `dlsym` goes
+// first.
+static void dlclose_trip() {
+  dlsym_slot.exchange(pass_through<backup_dlsym>);
+  dlclose_slot.exchange(pass_through<backup_dlclose>);
+}
+
+static HookBudget dlclose_budget{kHookDlclose, dlclose_trip};
+
+static int fake_dlclose(void *handle) {
+  return hook_dispatch(dlclose_budget, dlclose_slot, backup_dlclose, handle);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+static bool enabled = false;
+
+static void sync_locked() {
+  if (enabled) {
+    generation.fetch_add(1, std::memory_order_release);
+    // Invalidation before caching, and no caching without it.
+    hook_set_rules(dlclose_hook, kDlsymCache);
+    bool invalidating = dlclose_hook.installed.load(std::memory_order_acquire);
+    hook_set_rules(dlsym_hook, invalidating ? kDlsymCache : 0);
+  } else {
+    hook_set_rules(dlsym_hook, 0);
+    hook_set_rules(dlclose_hook, 0);
+  }
+}
+
+void dlsym_cache_init() {
+  std::lock_guard lock(control_mutex);
+  watchdog_register(dlsym_budget);
+  watchdog_register(dlclose_budget);
+  void *loader_dlsym = dlsym(RTLD_DEFAULT, "__loader_dlsym");
+  void *loader_dlclose = dlsym(RTLD_DEFAULT, "__loader_dlclose");
+  if (loader_dlsym == nullptr || loader_dlclose == nullptr) {
+    LOGW("dlsym cache: no __loader_dlsym/__loader_dlclose, not attached");
+    return;
+  }
+  hook_attach(dlclose_hook, loader_dlclose);
+  hook_attach(dlsym_hook, loader_dlsym);
+}
+
+void dlsym_cache_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  if (enabled == enable) return;
+  enabled = enable;
+  sync_locked();
+}
+
+void dlsym_cache_report() {
+  uint64_t lookups = 0, hits = 0;
+  for (auto &shard : shards) {
+    lookups += shard.lookups.load(std::memory_order_relaxed);
+    hits += shard.hits.load(std::memory_order_relaxed);
+  }
+  if (lookups == 0) return;
+  LOGI("dlsym cache: %llu of %llu lookups hit (%llu%%), self time ~%llu ns",
+       (unsigned long long)hits, (unsigned long long)lookups,
+       (unsigned long long)(hits * 100 / lookups),
+       (unsigned long long)budget_mean_self_ns(dlsym_budget));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  dlsym result cache
+ * =========================================================================================
+ *
+ * Apps and their plugins tend to `dlsym` the same symbols over and over, and
+ * every call takes the linker's global lock and walks the library's symbol
+ * tables. With `kFeatureDlsymCache`, hooks on `dlsym` and `dlclose` answer
+ * repeated lookups from a table instead.
+ *
+ * The hooks sit on the linker's `__loader_dlsym` and `__loader_dlclose`
+ * rather than on libdl's `dlsym` and `dlclose`. Those are stubs that add
+ * the caller's return address and jump on, two instructions on arm64: too
+ * short for an inline hook to patch without overwriting the next function.
+ * The linker's entry points are full functions, and they take the caller
+ * as an argument. Without them (before Android 8) nothing is hooked.
+ *
+ *   __loader_dlsym(handle, name, caller)
+ *        |
+ *        +-- RTLD_DEFAULT / RTLD_NEXT --> backup(handle, name, caller)
+ *        v
+ *   slot = hash(handle, name)
+ *   seqlock read: handle, name and generation match? --yes--> address
+ *        | no
+ *        v
+ *   backup(handle, name, caller) --> store (if found and not busy)
+ *
+ *   __loader_dlclose(handle)
+ *        --> ++generation, backup, ++generation (every entry is stale)
+ *
+ * Slots are seqlocks (see `seqlock.hpp`), so lookups never write shared
+ * memory; an insert that finds another one in progress skips caching. A
+ * lookup notes the generation before asking the linker, so a result that
+ * races with a `dlclose` is stored as stale already. Failed lookups are not
+ * cached: the linker has to set `dlerror` for them.
+ *
+ * Caveat: on Android the linker picks the namespace to search from the
+ * *calling* library. Only explicit handles are cached, as their lookup is
+ * scoped by the handle itself. Every call reaches the linker with the app's
+ * own caller, so misses resolve exactly as without the cache. A hit may
+ * answer a caller from another namespace with what the first caller was
+ * given.
+ */
+
+constexpr uint32_t kDlsymReportWindows = 10;
+
+/**
+ * @brief Attaches the `__loader_dlsym` and `__loader_dlclose` hooks, see
+ *        `config.hpp`.
+ */
+void dlsym_cache_init();
+
+/**
+ * @brief Enables or disables the cache. Enabling drops every entry, since
+ *        `dlclose` calls in between went unseen.
+ */
+void dlsym_cache_enable(bool enabled);
+
+/**
+ * @brief Logs hits and lookups. Runs on the watchdog thread.
+ */
+void dlsym_cache_report();
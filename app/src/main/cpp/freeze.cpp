@@ -0,0 +1,95 @@
+#include "freeze.hpp"
+#include "config.hpp"
+#include "fsync_policy.hpp"
+#include "logging.hpp"
+#include "quiescence.hpp"
+#include "telemetry.hpp"
+#include "trace.hpp"
+#include "watchdog.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Only touched during initialization, so a mutex is fine here.
+static std::mutex arena_mutex;
+static char *arena = nullptr;
+static size_t used = 0;
+static bool sealed = false;
+
+void *freeze_alloc(size_t size, size_t align) {
+  std::lock_guard lock(arena_mutex);
+  if (sealed) {
+    LOGE("freeze: allocation of %zu bytes after sealing", size);
+    return nullptr;
+  }
+  if (arena == nullptr) {
+    // Anonymous and page-aligned, so no mutable global shares its pages.
+    void *addr = mmap(nullptr, kFreezeArenaBytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      PLOGE("freeze: mmap");
+      return nullptr;
+    }
+    arena = static_cast<char *>(addr);
+  }
+  size_t offset = (used + align - 1) & ~(align - 1);
+  if (offset + size > kFreezeArenaBytes) {
+    LOGE("freeze: arena full (%zu + %zu bytes)", offset, size);
+    return nullptr;
+  }
+  used = offset + size;
+  return arena + offset;
+}
+
+const void *freeze_copy(const void *data, size_t size) {
+  void *copy = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (copy == MAP_FAILED) {
+    PLOGE("freeze: mmap");
+    return nullptr;
+  }
+  memcpy(copy, data, size);
+  if (mprotect(copy, size, PROT_READ) != 0) PLOGE("freeze: mprotect");
+  return copy;
+}
+
+void freeze_release(const void *copy, size_t size) {
+  munmap(const_cast<void *>(copy), size);
+}
+
+void ForkMutex::after_fork() {
+  for (ForkMutex *mutex = head_; mutex != nullptr; mutex = mutex->next_) {
+    new (&mutex->mutex_) std::mutex;
+  }
+}
+
+// Runs in the child, on the only thread it has.
+static void after_fork_child() {
+  ForkMutex::after_fork();
+  config_after_fork();
+  quiescence_after_fork();
+  watchdog_after_fork();
+  trace_after_fork();
+  fsync_policy_after_fork();
+  telemetry_after_fork();
+}
+
+void freeze_seal() {
+  std::lock_guard lock(arena_mutex);
+  if (sealed) return;
+  sealed = true;
+  pthread_atfork(nullptr, nullptr, after_fork_child);
+  if (arena == nullptr) return;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t length = (used + page - 1) & ~(page - 1);
+  if (mprotect(arena, length, PROT_READ) != 0) {
+    PLOGE("freeze: mprotect");
+    return;
+  }
+  // Pages past `length` were never touched and cost nothing.
+  LOGI("freeze: sealed %zu bytes in %zu pages", used, length / page);
+}
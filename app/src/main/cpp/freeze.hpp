@@ -0,0 +1,132 @@
+#pragma once
+
+#include "quiescence.hpp"
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Freezing: sharing precomputed state across fork
+ * =========================================================================================
+ *
+ * When the module is loaded into a process that forks afterwards (zygote
+ * style), every page the parent set up is shared copy-on-write with every
+ * child, until either side writes to it. State built once in `native_init`
+ * should therefore live apart from state that changes at runtime, or each
+ * counter update in a child privatizes the tables next to it.
+ *
+ *   freeze_alloc()   bump allocation in a page-aligned arena, for state that
+ *                    is written during initialization and only read later
+ *   freeze_seal()    maps the used pages read-only (end of `native_init`);
+ *                    a stray write now faults instead of silently copying
+ *                    the page in one child
+ *
+ *   +-------- arena (kFreezeArenaBytes reserved) --------+
+ *   | hook API | ... precomputed tables ... |  untouched |
+ *   +---------------- PROT_READ ------------+------------+
+ *
+ * Tables that are replaced at run time rather than built once, such as the
+ * path policies of `fs_cache.hpp` or `fsync_policy.hpp`, cannot go into the
+ * arena. `freeze_copy` gives each of them pages of its own, mapped
+ * read-only, so a table configured before a fork is shared by every child
+ * just the same. Caches filled on the call path (`dlsym_cache.hpp`,
+ * `jni_id_cache.hpp`) are written by design; their tables are static and
+ * zero until used, so a child only pays for the slots it fills itself.
+ *
+ * Sealing also installs `pthread_atfork` handlers. A child inherits only the
+ * forking thread, so the state the other threads owned is reset there: every
+ * `ForkMutex` is reinitialized, the watchdog thread is gone and restarts on
+ * the next configuration push, reader counts of threads that no longer exist
+ * are cleared, unflushed trace records stay with the parent, and telemetry
+ * moves to a slot of the child's own in the shared file, and a configuration
+ * publish cut short is completed. Everything else is left alone, so the
+ * reset touches a handful of pages. Cache slots that another thread was
+ * writing stay odd (see `seqlock.hpp`): they read as misses until the
+ * child's next write to them.
+ */
+
+constexpr size_t kFreezeArenaBytes = 64 * 1024;
+
+/**
+ * @brief Allocates `size` bytes in the frozen arena.
+ *
+ * Only valid before `freeze_seal`; the memory is zeroed and never freed.
+ *
+ * @return The memory, or `nullptr` once sealed or when the arena is full.
+ */
+void *freeze_alloc(size_t size, size_t align);
+
+/**
+ * @brief Copies `value` into the frozen arena, see `freeze_alloc`.
+ */
+template <typename T> const T *freeze_new(const T &value) {
+  void *memory = freeze_alloc(sizeof(T), alignof(T));
+  return memory != nullptr ? new (memory) T(value) : nullptr;
+}
+
+/**
+ * @brief Maps the used part of the arena read-only and registers the fork
+ *        handlers. Called once at the end of `native_init`.
+ */
+void freeze_seal();
+
+/**
+ * @brief Copies `size` bytes to pages of their own and maps them read-only.
+ *
+ * Valid at any time, unlike `freeze_alloc`. The copy is released with
+ * `freeze_release`, or `freeze_retire` while readers may still hold it.
+ *
+ * @return The copy, or `nullptr` if mapping failed.
+ */
+const void *freeze_copy(const void *data, size_t size);
+
+/**
+ * @brief Unmaps a copy made by `freeze_copy`.
+ */
+void freeze_release(const void *copy, size_t size);
+
+template <typename T> const T *freeze_copy(const T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  return static_cast<const T *>(freeze_copy(&value, sizeof(T)));
+}
+
+/**
+ * @brief Releases `copy` once no read-side critical section can still see
+ *        it, see `quiescence_retire`.
+ */
+template <typename T> void freeze_retire(const T *copy) {
+  quiescence_retire([](void *object) { freeze_release(object, sizeof(T)); },
+                    const_cast<T *>(copy));
+}
+
+/**
+ * @brief A `std::mutex` that is reinitialized in a forked child.
+ *
+ * Whoever held it at fork time is gone in the child, which would otherwise
+ * wait for it forever. Only for locks with static storage duration: each
+ * links itself into a list when constructed and stays there.
+ */
+class ForkMutex {
+public:
+  ForkMutex() : next_(head_) { head_ = this; }
+
+  ForkMutex(const ForkMutex &) = delete;
+  ForkMutex &operator=(const ForkMutex &) = delete;
+
+  void lock() { mutex_.lock(); }
+  bool try_lock() { return mutex_.try_lock(); }
+  void unlock() { mutex_.unlock(); }
+
+  /**
+   * @brief Reinitializes every `ForkMutex`. Runs in the child.
+   */
+  static void after_fork();
+
+private:
+  static inline ForkMutex *head_ = nullptr;
+
+  std::mutex mutex_;
+  ForkMutex *next_;
+};
@@ -0,0 +1,480 @@
+#include "fs_cache.hpp"
+#include "clock.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "path_rules.hpp"
+#include "quiescence.hpp"
+#include "seqlock.hpp"
+#include "thread_shard.hpp"
+#include "watchdog.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Rules: lookups are answered from the table, writes invalidate it.
+constexpr uint32_t kFsCacheLookup = 1u << 0;
+constexpr uint32_t kFsCacheInvalidate = 1u << 0;
+
+constexpr size_t kFsSlotBits = 10;
+constexpr size_t kFsSlots = size_t{1} << kFsSlotBits;
+// Longer paths are never cached.
+constexpr size_t kMaxCachedPath = 95;
+
+enum FsOp : uint32_t {
+  kFsStat,
+  kFsAccess,
+  kFsOpendir,
+  kFsOpCount,
+};
+
+static const char *const kFsOpNames[kFsOpCount] = {"stat", "access",
+                                                   "opendir"};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Policy
+ * -----------------------------------------------------------------------------
+ */
+
+struct FsPolicy {
+  int64_t ttl_ns;
+  uint32_t count;
+  uint32_t lengths[kMaxFsPrefixes];
+  char prefixes[kMaxFsPrefixes][kMaxFsPrefix + 1];
+};
+
+// Replaced as a whole by `fs_cache_configure` with a read-only copy (see
+// `freeze.hpp`); readers hold a quiescence read section.
+static std::atomic<const FsPolicy *> policy{nullptr};
+
+// The TTL of the prefixes if `path` starts with one of them or, with
+// `parents`, is a directory above one of them. 0 if neither.
+static int64_t prefix_ttl(const char *path, size_t length, bool parents) {
+  uint32_t token = quiescence_enter();
+  const FsPolicy *current = policy.load(std::memory_order_acquire);
+  int64_t ttl = 0;
+  for (uint32_t i = 0; current != nullptr && i < current->count; ++i) {
+    size_t compared = current->lengths[i];
+    if (parents && length < compared) compared = length;
+    if (strncmp(path, current->prefixes[i], compared) == 0) {
+      ttl = current->ttl_ns;
+      break;
+    }
+  }
+  quiescence_exit(token);
+  return ttl;
+}
+
+// The TTL of `path`, or 0 if it is not cached. Sets `length` when it is.
+static int64_t path_ttl(const char *path, size_t &length) {
+  if (path == nullptr) return 0;
+  length = strnlen(path, kMaxCachedPath + 1);
+  if (length > kMaxCachedPath || !plain_path(path)) return 0;
+  return prefix_ttl(path, length, false);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Table
+ * -----------------------------------------------------------------------------
+ */
+
+struct FsEntry {
+  uint64_t hash;
+  uint64_t generation;
+  int64_t expires_ns;
+  uint32_t op;
+  int32_t mode;
+  int32_t result;
+  int32_t error;
+  // Only for successful `stat` calls.
+  struct stat st;
+  char path[kMaxCachedPath + 1];
+};
+
+static Seqlock<FsEntry> entries[kFsSlots];
+
+// Starts at 1, so that the zeroed slots never match.
+static std::atomic<uint64_t> generation{1};
+
+// Serializes slot writes. Only ever taken with `try_lock`, see
+// `dlsym_cache.cpp`.
+static ForkMutex insert_mutex;
+
+struct alignas(kCacheLine) FsShard {
+  std::atomic<uint64_t> lookups[kFsOpCount];
+  std::atomic<uint64_t> hits[kFsOpCount];
+};
+
+static FsShard shards[kThreadShards];
+
+struct FsKey {
+  uint64_t hash;
+  FsOp op;
+  int32_t mode;
+  const char *path;
+  size_t length;
+};
+
+static FsKey make_key(FsOp op, int32_t mode, const char *path,
+                      size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t{op} << 32 | mode);
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(path[i])) * 0x100000001b3ull;
+  }
+  return {hash, op, mode, path, length};
+}
+
+static Seqlock<FsEntry> &slot_for(uint64_t hash) {
+  return entries[(hash * 0x9e3779b97f4a7c15ull) >> (64 - kFsSlotBits)];
+}
+
+static bool find(const FsKey &key, uint64_t current, FsEntry &entry) {
+  if (!slot_for(key.hash).try_read(entry)) return false;
+  return entry.hash == key.hash && entry.generation == current &&
+         entry.op == key.op && entry.mode == key.mode &&
+         monotonic_ns() < entry.expires_ns &&
+         strcmp(entry.path, key.path) == 0;
+}
+
+static void insert(const FsKey &key, uint64_t seen, int64_t ttl, int result,
+                   int error, const struct stat *st) {
+  std::unique_lock lock(insert_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+  FsEntry entry{};
+  entry.hash = key.hash;
+  entry.generation = seen;
+  entry.expires_ns = monotonic_ns() + ttl;
+  entry.op = key.op;
+  entry.mode = key.mode;
+  entry.result = result;
+  entry.error = error;
+  if (st != nullptr && result == 0) entry.st = *st;
+  memcpy(entry.path, key.path, key.length + 1);
+  slot_for(key.hash).write(entry);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Invalidation
+ * -----------------------------------------------------------------------------
+ */
+
+// Hooks that report writes, ours and those of `fs_cache_watch`.
+struct WriteWatch {
+  const Hook *hook;
+  uint32_t rule;
+  const HookBudget *budget;
+};
+
+constexpr size_t kMaxWriteWatches = 4;
+
+static WriteWatch watches[kMaxWriteWatches];
+static std::atomic<uint32_t> watch_count{0};
+// Set if a hook could not be watched; its writes would go unseen.
+static std::atomic<bool> watch_overflow{false};
+
+// Whether every write that a hook reports still reaches `invalidate`.
+static bool invalidation_live() {
+  if (watch_overflow.load(std::memory_order_relaxed)) return false;
+  uint32_t count = watch_count.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; ++i) {
+    const WriteWatch &watch = watches[i];
+    if (!watch.hook->installed.load(std::memory_order_relaxed) ||
+        !(hook_rules(*watch.hook) & watch.rule) ||
+        watch.budget->tripped.load(std::memory_order_relaxed)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Set while the cache answers lookups, so that writes matter.
+static std::atomic<bool> caching{false};
+
+static bool stable_error(int error) {
+  return error == ENOENT || error == ENOTDIR || error == EACCES;
+}
+
+static void invalidate() { generation.fetch_add(1, std::memory_order_release); }
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hooks
+ * -----------------------------------------------------------------------------
+ */
+
+// One hook in the same shape as the examples in `demo.cpp`, with `Handler`
+// in its slot.
+template <HookId Hid, auto Handler> struct FsHook;
+
+template <HookId Hid, typename R, typename... Args, R (*Handler)(Args...)>
+struct FsHook<Hid, Handler> {
+  static inline R (*backup)(Args...) = nullptr;
+
+  static R fake(Args... args) {
+    return hook_dispatch(budget, slot, backup, args...);
+  }
+
+  static inline Hook hook{Hid, (void *)fake, (void **)&backup};
+
+  static inline HandlerSlot<R(Args...)> slot{Handler};
+
+  static void trip() { slot.exchange(pass_through<backup>); }
+
+  static inline HookBudget budget{Hid, trip};
+};
+
+static int stat_cached(const char *path, struct stat *st);
+static int access_cached(const char *path, int mode);
+static int faccessat_cached(int dirfd, const char *path, int mode, int flags);
+static DIR *opendir_cached(const char *path);
+static int rename_invalidate(const char *from, const char *to);
+static int unlink_invalidate(const char *path);
+
+using StatHook = FsHook<kHookStat, stat_cached>;
+using AccessHook = FsHook<kHookAccess, access_cached>;
+using FaccessatHook = FsHook<kHookFaccessat, faccessat_cached>;
+using OpendirHook = FsHook<kHookOpendir, opendir_cached>;
+using RenameHook = FsHook<kHookRename, rename_invalidate>;
+using UnlinkHook = FsHook<kHookUnlink, unlink_invalidate>;
+
+// Answers `op` from the table, or runs `call` and stores a stable outcome.
+// `st` receives or provides the `struct stat` of `kFsStat`.
+template <typename Call>
+static int cached(const Hook &hook, FsOp op, const char *path, int mode,
+                  struct stat *st, Call call) {
+  size_t length = 0;
+  int64_t ttl = 0;
+  // Without invalidation, the table must not answer either.
+  if ((hook_rules(hook) & kFsCacheLookup) && invalidation_live()) {
+    ttl = path_ttl(path, length);
+  }
+  if (ttl == 0) return call();
+
+  FsShard &shard = shards[thread_shard()];
+  shard.lookups[op].fetch_add(1, std::memory_order_relaxed);
+  FsKey key = make_key(op, mode, path, length);
+  // Noted before asking the kernel, as in `dlsym_cache.cpp`.
+  uint64_t current = generation.load(std::memory_order_acquire);
+  FsEntry entry;
+  if (find(key, current, entry)) {
+    shard.hits[op].fetch_add(1, std::memory_order_relaxed);
+    if (entry.result != 0) {
+      errno = entry.error;
+    } else if (st != nullptr) {
+      *st = entry.st;
+    }
+    return entry.result;
+  }
+
+  int result = call();
+  int error = errno;
+  // A `DIR *` cannot be replayed, so `opendir` only caches failures.
+  if (result == 0 ? op != kFsOpendir : stable_error(error)) {
+    insert(key, current, ttl, result, error, st);
+  }
+  errno = error;
+  return result;
+}
+
+static int stat_cached(const char *path, struct stat *st) {
+  return cached(StatHook::hook, kFsStat, path, 0, st,
+                [&] { return call_backup(StatHook::backup, path, st); });
+}
+
+// bionic's `access` is `faccessat(AT_FDCWD, path, mode, 0)`. That nested
+// call asks what was just looked up here, so it goes straight to the kernel
+// instead of being looked up, counted and stored a second time.
+static int access_backup(const char *path, int mode) {
+  HookThreadState &state = hook_thread_state();
+  uint32_t saved = state.in_hook;
+  state.in_hook |= 1u << kHookFaccessat;
+  int result = AccessHook::backup(path, mode);
+  state.in_hook = saved;
+  return result;
+}
+
+static int access_cached(const char *path, int mode) {
+  return cached(AccessHook::hook, kFsAccess, path, mode, nullptr,
+                [&] { return call_backup(access_backup, path, mode); });
+}
+
+// Only the plain form is the same question as `access`; everything else
+// goes to the kernel.
+static int faccessat_cached(int dirfd, const char *path, int mode, int flags) {
+  auto call = [&] {
+    return call_backup(FaccessatHook::backup, dirfd, path, mode, flags);
+  };
+  if (dirfd != AT_FDCWD || flags != 0) return call();
+  return cached(FaccessatHook::hook, kFsAccess, path, mode, nullptr, call);
+}
+
+static DIR *opendir_cached(const char *path) {
+  DIR *dir = nullptr;
+  cached(OpendirHook::hook, kFsOpendir, path, 0, nullptr, [&] {
+    dir = call_backup(OpendirHook::backup, path);
+    return dir != nullptr ? 0 : -1;
+  });
+  return dir;
+}
+
+// Invalidates after the change, regardless of the rules: a lookup that
+// started before it carries the old generation.
+static int rename_invalidate(const char *from, const char *to) {
+  int result = call_backup(RenameHook::backup, from, to);
+  int error = errno;
+  fs_cache_note_write(from);
+  fs_cache_note_write(to);
+  errno = error;
+  return result;
+}
+
+static int unlink_invalidate(const char *path) {
+  int result = call_backup(UnlinkHook::backup, path);
+  int error = errno;
+  fs_cache_note_write(path);
+  errno = error;
+  return result;
+}
+
+void fs_cache_note_write(const char *path) {
+  if (path == nullptr || !caching.load(std::memory_order_acquire)) return;
+  // Relative paths and "." / ".." components may name anything; renaming a
+  // directory above a prefix moves everything below it.
+  size_t length = strlen(path);
+  if (!plain_path(path) || prefix_ttl(path, length, true) != 0) {
+    invalidate();
+  }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+static bool enabled = false;
+
+static void sync_locked() {
+  uint32_t lookup = enabled ? kFsCacheLookup : 0;
+  uint32_t invalidate_rules = enabled ? kFsCacheInvalidate : 0;
+  if (enabled) {
+    caching.store(true, std::memory_order_release);
+    invalidate();
+    // Invalidation before caching.
+    hook_set_rules(RenameHook::hook, invalidate_rules);
+    hook_set_rules(UnlinkHook::hook, invalidate_rules);
+  }
+  hook_set_rules(StatHook::hook, lookup);
+  hook_set_rules(AccessHook::hook, lookup);
+  hook_set_rules(FaccessatHook::hook, lookup);
+  hook_set_rules(OpendirHook::hook, lookup);
+  if (!enabled) {
+    hook_set_rules(RenameHook::hook, invalidate_rules);
+    hook_set_rules(UnlinkHook::hook, invalidate_rules);
+    caching.store(false, std::memory_order_release);
+  }
+}
+
+static void watch_locked(const Hook &hook, uint32_t rule,
+                         const HookBudget &budget) {
+  uint32_t count = watch_count.load(std::memory_order_relaxed);
+  if (count == kMaxWriteWatches) {
+    LOGE("fs cache: too many write hooks, not caching");
+    watch_overflow.store(true, std::memory_order_relaxed);
+    return;
+  }
+  watches[count] = {&hook, rule, &budget};
+  watch_count.store(count + 1, std::memory_order_release);
+}
+
+void fs_cache_init() {
+  std::lock_guard lock(control_mutex);
+  watchdog_register(StatHook::budget);
+  watchdog_register(AccessHook::budget);
+  watchdog_register(FaccessatHook::budget);
+  watchdog_register(OpendirHook::budget);
+  watchdog_register(RenameHook::budget);
+  watchdog_register(UnlinkHook::budget);
+  watch_locked(RenameHook::hook, kFsCacheInvalidate, RenameHook::budget);
+  watch_locked(UnlinkHook::hook, kFsCacheInvalidate, UnlinkHook::budget);
+  hook_attach(RenameHook::hook, (void *)rename);
+  hook_attach(UnlinkHook::hook, (void *)unlink);
+  int (*stat_function)(const char *, struct stat *) = stat;
+  hook_attach(StatHook::hook, (void *)stat_function);
+  hook_attach(AccessHook::hook, (void *)access);
+  hook_attach(FaccessatHook::hook, (void *)faccessat);
+  hook_attach(OpendirHook::hook, (void *)opendir);
+}
+
+void fs_cache_watch(const Hook &hook, uint32_t rule,
+                    const HookBudget &budget) {
+  std::lock_guard lock(control_mutex);
+  watch_locked(hook, rule, budget);
+}
+
+void fs_cache_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  if (enabled == enable) {
+    // A watched hook may have been off since the last call, with its writes
+    // unseen.
+    if (enabled) invalidate();
+    return;
+  }
+  enabled = enable;
+  sync_locked();
+}
+
+void fs_cache_configure(std::string_view prefixes, uint32_t ttl_ms) {
+  FsPolicy next{};
+  next.ttl_ns = int64_t{ttl_ms} * 1000000;
+  while (!prefixes.empty() && next.count < kMaxFsPrefixes) {
+    std::string_view prefix = next_line(prefixes);
+    if (!valid_prefix(prefix, kMaxFsPrefix)) continue;
+    memcpy(next.prefixes[next.count], prefix.data(), prefix.size());
+    next.lengths[next.count++] = prefix.size();
+  }
+  const FsPolicy *frozen = nullptr;
+  if (next.count > 0 && next.ttl_ns > 0) frozen = freeze_copy(next);
+
+  std::lock_guard lock(control_mutex);
+  const FsPolicy *previous = policy.exchange(frozen, std::memory_order_acq_rel);
+  // Entries under prefixes that are gone must not be answered again.
+  invalidate();
+  if (previous != nullptr) freeze_retire(previous);
+}
+
+uint64_t fs_cache_hits() {
+  uint64_t hits = 0;
+  for (auto &shard : shards) {
+    for (auto &op_hits : shard.hits) {
+      hits += op_hits.load(std::memory_order_relaxed);
+    }
+  }
+  return hits;
+}
+
+void fs_cache_report() {
+  for (uint32_t op = 0; op < kFsOpCount; ++op) {
+    uint64_t lookups = 0, hits = 0;
+    for (auto &shard : shards) {
+      lookups += shard.lookups[op].load(std::memory_order_relaxed);
+      hits += shard.hits[op].load(std::memory_order_relaxed);
+    }
+    if (lookups == 0) continue;
+    LOGI("fs cache: %-8s %llu of %llu lookups hit (%llu%%)", kFsOpNames[op],
+         (unsigned long long)hits, (unsigned long long)lookups,
+         (unsigned long long)(hits * 100 / lookups));
+  }
+}
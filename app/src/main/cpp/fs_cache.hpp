@@ -0,0 +1,90 @@
+#pragma once
+
+#include "hook_manager.hpp"
+#include "watchdog.hpp"
+#include <cstdint>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Filesystem metadata cache
+ * =========================================================================================
+ *
+ * Apps, and root-detection SDKs in particular, probe the same paths with
+ * `stat`, `access`, `faccessat` and `opendir` again and again, and each
+ * probe is a syscall with a path walk in the kernel. With
+ * `kFeatureFsCache`, hooks in the style of `fake_fopen` answer repeated
+ * probes under the configured path prefixes from a table:
+ *
+ *   stat("/system/xbin/su", &st)
+ *        |
+ *        +-- relative, "." / ".." components, or no prefix matches --> backup
+ *        v
+ *   slot = hash(op, mode, path)
+ *   seqlock read: key and generation match, not expired? --yes--> replay
+ *        | no                                              (result, errno,
+ *        v                                                  struct stat)
+ *   backup(...) --> store if the outcome is stable
+ *
+ *   rename / unlink / fopen for writing under a prefix
+ *        --> backup, then ++generation (every entry is stale)
+ *
+ * The table only answers while every hook that reports writes is live:
+ * installed, with its reporting rule set and not tripped by the watchdog
+ * (see `fs_cache_watch`). Otherwise a write could go unseen.
+ *
+ * Stable outcomes are success and `ENOENT`, `ENOTDIR` or `EACCES`; anything
+ * else (`EINTR`, `ENOMEM`, ...) goes to the kernel again. `opendir` only
+ * caches failures, since a `DIR *` cannot be replayed.
+ *
+ * Only the module's own hooks invalidate. Other writers (`open` with
+ * `O_CREAT`, `mkdir`, another process) are bounded by the TTL alone, as are
+ * paths reached through symlinks; choose prefixes whose contents do not
+ * change while the app runs, such as `/system/` or `/vendor/`.
+ *
+ * Slots are seqlocks written with `try_lock`, as in `dlsym_cache.hpp`.
+ */
+
+constexpr uint32_t kFsCacheReportWindows = 10;
+constexpr size_t kMaxFsPrefixes = 8;
+constexpr size_t kMaxFsPrefix = 63;
+
+/**
+ * @brief Attaches the hooks, see `config.hpp`.
+ */
+void fs_cache_init();
+
+/**
+ * @brief Enables or disables the cache. Enabling, even again, drops every
+ *        entry, since writes in between may have gone unseen.
+ */
+void fs_cache_enable(bool enabled);
+
+/**
+ * @brief Sets the cached path prefixes (separated by newlines, at most
+ *        `kMaxFsPrefixes`) and the lifetime of an entry. Drops every entry.
+ */
+void fs_cache_configure(std::string_view prefixes, uint32_t ttl_ms);
+
+/**
+ * @brief Registers `hook` as reporting writes through `fs_cache_note_write`
+ *        while `rule` is set. Called once, before the hook is installed.
+ */
+void fs_cache_watch(const Hook &hook, uint32_t rule, const HookBudget &budget);
+
+/**
+ * @brief Invalidates the cache if `path` may be cached. For writes the
+ *        module sees through other hooks, such as `fopen` for writing. Does
+ *        nothing while the cache is disabled.
+ */
+void fs_cache_note_write(const char *path);
+
+/**
+ * @brief Lookups answered from the table so far, over all operations.
+ */
+uint64_t fs_cache_hits();
+
+/**
+ * @brief Logs hits and lookups per operation. Runs on the watchdog thread.
+ */
+void fs_cache_report();
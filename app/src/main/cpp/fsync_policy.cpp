@@ -0,0 +1,540 @@
+#include "fsync_policy.hpp"
+#include "clock.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "path_rules.hpp"
+#include "quiescence.hpp"
+#include "thread_shard.hpp"
+#include "watchdog.hpp"
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// The only rule of both hooks.
+constexpr uint32_t kFsyncApplyRules = 1u << 0;
+
+constexpr size_t kMaxPendingSyncs = 64;
+constexpr size_t kMaxSyncGroups = 32;
+// Files behind longer paths pass through.
+constexpr size_t kMaxSyncPath = 255;
+
+enum SyncMode : uint32_t {
+  kSyncPassthrough,
+  kSyncCoalesce,
+  kSyncGroup,
+  kSyncModeCount,
+};
+
+static const char *const kSyncModeNames[kSyncModeCount] = {
+    "passthrough", "coalesce", "group"};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Policy
+ * -----------------------------------------------------------------------------
+ */
+
+struct SyncRule {
+  uint32_t length;
+  SyncMode mode;
+  int64_t window_ns;
+  char prefix[kMaxFsyncPrefix + 1];
+};
+
+struct SyncPolicy {
+  uint32_t count;
+  SyncRule rules[kMaxFsyncRules];
+};
+
+// Replaced as a whole by `fsync_policy_configure` with a read-only copy
+// (see `freeze.hpp`); readers hold a quiescence read section.
+static std::atomic<const SyncPolicy *> policy{nullptr};
+
+static bool parse_rule(std::string_view line, SyncRule &rule) {
+  std::string_view prefix = next_field(line);
+  std::string_view mode = next_field(line);
+  std::string_view window = next_field(line);
+  std::string_view consent = next_field(line);
+  if (!valid_prefix(prefix, kMaxFsyncPrefix)) return false;
+  uint32_t mode_index = 0;
+  while (mode_index < kSyncModeCount && mode != kSyncModeNames[mode_index]) {
+    mode_index++;
+  }
+  uint32_t window_ms = 0;
+  auto [end, error] =
+      std::from_chars(window.data(), window.data() + window.size(), window_ms);
+  if (mode_index == kSyncModeCount || error != std::errc() ||
+      end != window.data() + window.size() || window_ms > kMaxFsyncWindowMs) {
+    return false;
+  }
+  // Giving up durability takes saying so, and nothing else may follow.
+  std::string_view expected = mode_index == kSyncCoalesce ? "unsafe" : "";
+  if (consent != expected || !next_field(line).empty()) return false;
+  memcpy(rule.prefix, prefix.data(), prefix.size());
+  rule.prefix[prefix.size()] = '\0';
+  rule.length = prefix.size();
+  rule.mode = static_cast<SyncMode>(mode_index);
+  rule.window_ns = int64_t{window_ms} * 1000000;
+  return true;
+}
+
+struct SyncChoice {
+  bool matched;
+  SyncMode mode;
+  int64_t window_ns;
+};
+
+// The rule for the file behind `fd`, copied out of the read section so that
+// no wait or sync happens inside it. Leaves `errno` alone.
+static SyncChoice choice_for(int fd) {
+  SyncChoice choice{false, kSyncPassthrough, 0};
+  int saved_errno = errno;
+  uint32_t token = quiescence_enter();
+  const SyncPolicy *current = policy.load(std::memory_order_acquire);
+  char link[32];
+  char path[kMaxSyncPath + 1];
+  ssize_t length = -1;
+  if (current != nullptr) {
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    length = readlink(link, path, kMaxSyncPath);
+  }
+  if (length > 0 && static_cast<size_t>(length) < kMaxSyncPath) {
+    path[length] = '\0';
+    for (uint32_t i = 0; i < current->count; ++i) {
+      const SyncRule &rule = current->rules[i];
+      if (strncmp(path, rule.prefix, rule.length) == 0) {
+        choice = {true, rule.mode, rule.window_ns};
+        break;
+      }
+    }
+  }
+  quiescence_exit(token);
+  errno = saved_errno;
+  return choice;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Counters
+ * -----------------------------------------------------------------------------
+ */
+
+struct alignas(kCacheLine) SyncShard {
+  // Calls that matched a rule, by mode.
+  std::atomic<uint64_t> calls[kSyncModeCount];
+};
+
+static SyncShard shards[kThreadShards];
+
+// Syncs actually issued for coalesced and grouped calls.
+static std::atomic<uint64_t> flushes{0};
+static std::atomic<uint64_t> flush_failures{0};
+static std::atomic<uint64_t> group_syncs{0};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Coalescing
+ * -----------------------------------------------------------------------------
+ */
+
+struct PendingSync {
+  bool used;
+  // `fsync` rather than `fdatasync`.
+  bool full;
+  int fd;
+  dev_t dev;
+  ino_t ino;
+  int64_t due_ns;
+};
+
+static PendingSync pending[kMaxPendingSyncs];
+
+// Deferred syncs that failed, until the next coalesced call for the file
+// returns the error. The duplicate shares the caller's open file
+// description, so the failed sync consumed the error that the caller's own
+// `fsync` would otherwise have seen.
+struct FailedSync {
+  bool used;
+  dev_t dev;
+  ino_t ino;
+  int error;
+};
+
+static FailedSync failed[kMaxPendingSyncs];
+static std::mutex flush_mutex;
+// Never destroyed: destroying a condition variable with waiters blocks, and
+// the flusher still waits on it while the process exits.
+static std::condition_variable &flush_cv = *new std::condition_variable;
+static bool flusher_started = false;
+
+static void flusher() {
+  pthread_setname_np(pthread_self(), "fsync-flusher");
+  // The syncs below go straight to the originals.
+  hook_thread_state().in_hook = kHookBypassAll;
+  PendingSync due[kMaxPendingSyncs];
+  std::unique_lock lock(flush_mutex);
+  for (;;) {
+    int64_t now = monotonic_ns();
+    int64_t next_due = INT64_MAX;
+    size_t count = 0;
+    for (auto &entry : pending) {
+      if (!entry.used) continue;
+      if (entry.due_ns <= now) {
+        due[count++] = entry;
+        entry.used = false;
+      } else if (entry.due_ns < next_due) {
+        next_due = entry.due_ns;
+      }
+    }
+    if (count == 0) {
+      if (next_due == INT64_MAX) {
+        flush_cv.wait(lock);
+      } else {
+        flush_cv.wait_for(lock, std::chrono::nanoseconds(next_due - now));
+      }
+      continue;
+    }
+
+    lock.unlock();
+    int errors[kMaxPendingSyncs];
+    for (size_t i = 0; i < count; ++i) {
+      int result = due[i].full ? fsync(due[i].fd) : fdatasync(due[i].fd);
+      errors[i] = result != 0 ? errno : 0;
+      if (result != 0) {
+        LOGW("fsync policy: deferred sync of inode %llu failed: %s",
+             (unsigned long long)due[i].ino, strerror(errno));
+        flush_failures.fetch_add(1, std::memory_order_relaxed);
+      }
+      close(due[i].fd);
+    }
+    flushes.fetch_add(count, std::memory_order_relaxed);
+    lock.lock();
+    for (size_t i = 0; i < count; ++i) {
+      if (errors[i] == 0) continue;
+      // With the table full, the error is only logged.
+      for (auto &entry : failed) {
+        if (entry.used) continue;
+        entry = {true, due[i].dev, due[i].ino, errors[i]};
+        break;
+      }
+    }
+  }
+}
+
+// Queues a sync of `fd`'s file for the flusher. False if the caller must
+// sync itself. Otherwise sets `result` to 0, or to -1 with `errno` set if an
+// earlier deferred sync of the file failed.
+static bool coalesce(int fd, bool full, int64_t window_ns, int &result) {
+  int saved_errno = errno;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    errno = saved_errno;
+    return false;
+  }
+  std::lock_guard lock(flush_mutex);
+  // Reported once the data written since is queued too.
+  auto queued = [&] {
+    result = 0;
+    for (auto &entry : failed) {
+      if (entry.used && entry.dev == st.st_dev && entry.ino == st.st_ino) {
+        entry.used = false;
+        result = -1;
+        saved_errno = entry.error;
+        break;
+      }
+    }
+    errno = saved_errno;
+    return true;
+  };
+  PendingSync *free_slot = nullptr;
+  for (auto &entry : pending) {
+    if (!entry.used) {
+      if (free_slot == nullptr) free_slot = &entry;
+    } else if (entry.dev == st.st_dev && entry.ino == st.st_ino) {
+      entry.full |= full;
+      return queued();
+    }
+  }
+  if (free_slot == nullptr) return false;
+  // The caller may close `fd` before the flusher gets to it.
+  int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (copy < 0) {
+    errno = saved_errno;
+    return false;
+  }
+  *free_slot = {true, full, copy, st.st_dev, st.st_ino,
+                monotonic_ns() + window_ns};
+  if (!flusher_started) {
+    std::thread(flusher).detach();
+    flusher_started = true;
+  }
+  flush_cv.notify_one();
+  return queued();
+}
+
+// Makes every pending sync due now.
+static void flush_pending() {
+  std::lock_guard lock(flush_mutex);
+  for (auto &entry : pending) entry.due_ns = 0;
+  flush_cv.notify_one();
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Group commit
+ * -----------------------------------------------------------------------------
+ */
+
+struct SyncGroup {
+  dev_t dev;
+  ino_t ino;
+  // Threads between `join_group` and the end of `group_sync`.
+  uint32_t members;
+  bool running;
+  // A member since the last sync asked for `fsync`.
+  bool want_full;
+  // Tickets handed out, and the highest ticket covered by a finished sync.
+  uint64_t requested;
+  uint64_t done;
+  int result;
+  int error;
+};
+
+static SyncGroup groups[kMaxSyncGroups];
+static std::mutex group_mutex;
+// Never destroyed either, see `flush_cv`.
+static std::condition_variable &group_cv = *new std::condition_variable;
+
+// The group of `fd`'s file, or nullptr if the caller must sync itself.
+static SyncGroup *join_group(int fd) {
+  int saved_errno = errno;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    errno = saved_errno;
+    return nullptr;
+  }
+  std::lock_guard lock(group_mutex);
+  SyncGroup *idle = nullptr;
+  for (auto &group : groups) {
+    bool busy = group.members > 0 || group.running;
+    if (busy && group.dev == st.st_dev && group.ino == st.st_ino) {
+      group.members++;
+      return &group;
+    }
+    if (!busy && idle == nullptr) idle = &group;
+  }
+  if (idle == nullptr) return nullptr;
+  *idle = {st.st_dev, st.st_ino, 1, false, false, 0, 0, 0, 0};
+  return idle;
+}
+
+// Leads or waits for a sync that started after this call. Runs through
+// `call_backup`, so the watchdog books the wait as backup time. Called
+// outside any read section (see `handler_slot.hpp`).
+static int group_sync(SyncGroup *group, int fd, bool full, int64_t window_ns) {
+  std::unique_lock lock(group_mutex);
+  uint64_t ticket = ++group->requested;
+  group->want_full |= full;
+  while (group->done < ticket) {
+    if (group->running) {
+      group_cv.wait(lock);
+      continue;
+    }
+    group->running = true;
+    if (window_ns > 0) {
+      // Let the rest of the group arrive.
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::nanoseconds(window_ns));
+      lock.lock();
+    }
+    uint64_t target = group->requested;
+    bool use_full = group->want_full;
+    group->want_full = false;
+    lock.unlock();
+    int result, error;
+    {
+      // The leader may be in either hook; both calls go to the originals.
+      HookBypass bypass;
+      result = use_full ? fsync(fd) : fdatasync(fd);
+      error = errno;
+    }
+    group_syncs.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+    group->done = target;
+    group->result = result;
+    group->error = error;
+    group->running = false;
+    group_cv.notify_all();
+  }
+  int result = group->result;
+  int error = group->error;
+  group->members--;
+  lock.unlock();
+  if (result != 0) errno = error;
+  return result;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hooks
+ * -----------------------------------------------------------------------------
+ */
+
+// One hook in the same shape as the examples in `demo.cpp`, with `Handler`
+// in its slot, as in `fs_cache.cpp`.
+template <HookId Hid, auto Handler> struct SyncHook;
+
+template <HookId Hid, typename R, typename... Args, R (*Handler)(Args...)>
+struct SyncHook<Hid, Handler> {
+  static inline R (*backup)(Args...) = nullptr;
+
+  static R fake(Args... args) {
+    return hook_dispatch(budget, slot, backup, args...);
+  }
+
+  static inline Hook hook{Hid, (void *)fake, (void **)&backup};
+
+  static inline HandlerSlot<R(Args...)> slot{Handler};
+
+  static void trip() { slot.exchange(pass_through<backup>); }
+
+  static inline HookBudget budget{Hid, trip};
+};
+
+static int fsync_handled(int fd);
+static int fdatasync_handled(int fd);
+
+using FsyncHook = SyncHook<kHookFsync, fsync_handled>;
+using FdatasyncHook = SyncHook<kHookFdatasync, fdatasync_handled>;
+
+template <typename Call>
+static int apply(const Hook &hook, int fd, bool full, Call call) {
+  if (!(hook_rules(hook) & kFsyncApplyRules)) return call();
+  SyncChoice choice = choice_for(fd);
+  if (!choice.matched) return call();
+  shards[thread_shard()].calls[choice.mode].fetch_add(
+      1, std::memory_order_relaxed);
+  switch (choice.mode) {
+  case kSyncCoalesce: {
+    int result = 0;
+    if (coalesce(fd, full, choice.window_ns, result)) return result;
+    break;
+  }
+  case kSyncGroup:
+    if (SyncGroup *group = join_group(fd)) {
+      return call_backup(group_sync, group, fd, full, choice.window_ns);
+    }
+    break;
+  case kSyncPassthrough:
+  case kSyncModeCount:
+    break;
+  }
+  return call();
+}
+
+static int fsync_handled(int fd) {
+  return apply(FsyncHook::hook, fd, true,
+               [&] { return call_backup(FsyncHook::backup, fd); });
+}
+
+static int fdatasync_handled(int fd) {
+  return apply(FdatasyncHook::hook, fd, false,
+               [&] { return call_backup(FdatasyncHook::backup, fd); });
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+
+void fsync_policy_init() {
+  std::lock_guard lock(control_mutex);
+  watchdog_register(FsyncHook::budget);
+  watchdog_register(FdatasyncHook::budget);
+  hook_attach(FsyncHook::hook, (void *)fsync);
+  hook_attach(FdatasyncHook::hook, (void *)fdatasync);
+}
+
+void fsync_policy_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  uint32_t rules = enable ? kFsyncApplyRules : 0;
+  hook_set_rules(FsyncHook::hook, rules);
+  hook_set_rules(FdatasyncHook::hook, rules);
+  if (!enable) flush_pending();
+}
+
+void fsync_policy_configure(std::string_view rules) {
+  SyncPolicy next{};
+  while (!rules.empty() && next.count < kMaxFsyncRules) {
+    std::string_view line = next_line(rules);
+    if (line.empty()) continue;
+    if (parse_rule(line, next.rules[next.count])) {
+      next.count++;
+    } else {
+      LOGW("fsync policy: skipping rule \"%.*s\"", (int)line.size(),
+           line.data());
+    }
+  }
+  const SyncPolicy *frozen = next.count > 0 ? freeze_copy(next) : nullptr;
+
+  std::lock_guard lock(control_mutex);
+  const SyncPolicy *previous =
+      policy.exchange(frozen, std::memory_order_acq_rel);
+  if (previous != nullptr) freeze_retire(previous);
+  // Windows may have shrunk; syncs queued under the old ones go now.
+  flush_pending();
+}
+
+void fsync_policy_report() {
+  uint64_t calls[kSyncModeCount] = {};
+  for (auto &shard : shards) {
+    for (uint32_t mode = 0; mode < kSyncModeCount; ++mode) {
+      calls[mode] += shard.calls[mode].load(std::memory_order_relaxed);
+    }
+  }
+  if (calls[kSyncPassthrough] + calls[kSyncCoalesce] + calls[kSyncGroup] ==
+      0) {
+    return;
+  }
+  LOGI("fsync policy: %llu passed through, %llu coalesced into %llu "
+       "flushes (%llu failed), %llu grouped into %llu syncs",
+       (unsigned long long)calls[kSyncPassthrough],
+       (unsigned long long)calls[kSyncCoalesce],
+       (unsigned long long)flushes.load(std::memory_order_relaxed),
+       (unsigned long long)flush_failures.load(std::memory_order_relaxed),
+       (unsigned long long)calls[kSyncGroup],
+       (unsigned long long)group_syncs.load(std::memory_order_relaxed));
+}
+
+void fsync_policy_after_fork() {
+  // Only the forking thread survives: no flusher, no leaders, no waiters.
+  new (&flush_mutex) std::mutex;
+  new (&flush_cv) std::condition_variable;
+  new (&group_mutex) std::mutex;
+  new (&group_cv) std::condition_variable;
+  flusher_started = false;
+  for (auto &entry : pending) {
+    if (entry.used) close(entry.fd);
+    entry.used = false;
+  }
+  for (auto &entry : failed) entry.used = false;
+  for (auto &group : groups) group = {};
+}
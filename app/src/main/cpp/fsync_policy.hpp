@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  `fsync` / `fdatasync` policies
+ * =========================================================================================
+ *
+ * Some apps `fsync` after every small write to their databases and
+ * preference files, and each call waits for the storage device. With
+ * `kFeatureFsyncPolicy`, hooks on `fsync` and `fdatasync` look up the path
+ * behind the descriptor and apply the first matching rule:
+ *
+ *   fsync(fd)
+ *        |
+ *        +-- readlink("/proc/self/fd/<fd>") matches no rule --> backup
+ *        v
+ *   passthrough: backup(fd)
+ *
+ *   coalesce:    dup(fd) into the pending table (once per inode), return 0
+ *                ... the "fsync-flusher" thread syncs and closes the
+ *                duplicate once the window has passed; if that fails, the
+ *                next coalesced call for the inode returns the error
+ *
+ *   group:       join the inode's commit group and wait:
+ *                  nobody syncing --> lead: wait out the window, then one
+ *                                     backup(fd) for every member so far
+ *                  a sync running --> the next leader covers us
+ *                every member returns the result of the sync covering it
+ *
+ * Group commit keeps the durability contract: no call returns before a
+ * sync that started after it completed. Coalescing does not. A caller is
+ * told its data is durable while it is still only in the page cache, and
+ * learns of a failed deferred sync one call late, if at all. Only give it
+ * paths whose loss in a crash is acceptable, such as caches; its rules must
+ * end in `unsafe` to say so. A full pending table or group table passes
+ * calls through.
+ *
+ * Rules are lines of `<prefix> <passthrough|group> <window ms>` or
+ * `<prefix> coalesce <window ms> unsafe`, and are replaced as a whole by
+ * `fsync_policy_configure`, read under quiescence like the prefixes in
+ * `fs_cache.hpp`. The matching rule is copied out of its read section
+ * before anything waits, so a group leader sleeping out its window never
+ * holds up the watchdog's reclaim. Waiting for a sync counts as backup time
+ * for the watchdog.
+ */
+
+constexpr uint32_t kFsyncReportWindows = 10;
+constexpr size_t kMaxFsyncRules = 8;
+constexpr size_t kMaxFsyncPrefix = 63;
+constexpr uint32_t kMaxFsyncWindowMs = 5000;
+
+/**
+ * @brief Attaches the hooks, see `config.hpp`.
+ */
+void fsync_policy_init();
+
+/**
+ * @brief Enables or disables the policy. Disabling flushes every pending
+ *        coalesced sync right away.
+ */
+void fsync_policy_enable(bool enabled);
+
+/**
+ * @brief Replaces the rules, one per line (see above). Malformed lines are
+ *        skipped; at most `kMaxFsyncRules` rules are used.
+ */
+void fsync_policy_configure(std::string_view rules);
+
+/**
+ * @brief Logs the counters. Runs on the watchdog thread.
+ */
+void fsync_policy_report();
+
+/**
+ * @brief Resets the flusher in a forked child, whose pending syncs belong to
+ *        the parent. Called from the `pthread_atfork` child handler.
+ */
+void fsync_policy_after_fork();
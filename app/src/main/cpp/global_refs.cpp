@@ -0,0 +1,253 @@
+#include "global_refs.hpp"
+#include "callers.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "watchdog.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+
+// The only rule of the four reference hooks.
+constexpr uint32_t kRefTrack = 1u << 0;
+
+constexpr size_t kRefSlotBits = 15;
+constexpr size_t kRefSlots = size_t{1} << kRefSlotBits;
+constexpr size_t kRefProbes = 32;
+constexpr size_t kRefReportTop = 8;
+
+// The key of a free slot. References are never null.
+constexpr uint64_t kRefFree = 0;
+
+enum RefKind : uint32_t {
+  kRefGlobal,
+  kRefWeak,
+  kRefKindCount,
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Table
+ * -----------------------------------------------------------------------------
+ */
+
+struct RefSlot {
+  std::atomic<uint64_t> key;
+  // `(kind + 1) << 16 | library`, or 0 while the slot is being claimed or
+  // erased. The report only counts slots with an owner.
+  std::atomic<uint32_t> owner;
+};
+
+static RefSlot slots[kRefSlots];
+static std::atomic<uint64_t> untracked{0};
+
+static size_t slot_index(uint64_t key) {
+  return (key * 0x9e3779b97f4a7c15ull) >> (64 - kRefSlotBits);
+}
+
+static void ref_insert(jobject ref, RefKind kind, uint32_t library) {
+  uint64_t key = reinterpret_cast<uintptr_t>(ref);
+  size_t start = slot_index(key);
+  for (size_t i = 0; i < kRefProbes; ++i) {
+    RefSlot &slot = slots[(start + i) % kRefSlots];
+    uint64_t seen = slot.key.load(std::memory_order_relaxed);
+    if (seen != kRefFree) continue;
+    if (slot.key.compare_exchange_strong(seen, key,
+                                         std::memory_order_relaxed)) {
+      slot.owner.store((kind + 1) << 16 | library, std::memory_order_release);
+      return;
+    }
+  }
+  untracked.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Frees the slot holding `ref` outright. There are no tombstones, so a free
+// slot does not end the probe: `ref` may sit behind one that was erased
+// after it was inserted.
+static void ref_erase(jobject ref) {
+  uint64_t key = reinterpret_cast<uintptr_t>(ref);
+  size_t start = slot_index(key);
+  for (size_t i = 0; i < kRefProbes; ++i) {
+    RefSlot &slot = slots[(start + i) % kRefSlots];
+    if (slot.key.load(std::memory_order_relaxed) != key) continue;
+    slot.owner.store(0, std::memory_order_relaxed);
+    slot.key.store(kRefFree, std::memory_order_release);
+    return;
+  }
+}
+
+using RefCounts = uint32_t[kMaxCallerLibraries][kRefKindCount];
+
+static uint32_t ref_count(RefCounts &live) {
+  uint32_t total = 0;
+  for (auto &slot : slots) {
+    uint32_t owner = slot.owner.load(std::memory_order_acquire);
+    if (owner == 0) continue;
+    live[owner & 0xffff][(owner >> 16) - 1]++;
+    total++;
+  }
+  return total;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hooks
+ * -----------------------------------------------------------------------------
+ */
+
+// `NewGlobalRef` and `NewWeakGlobalRef`. The return address is only known
+// in `fake`, so it travels to the handler as an extra argument, which
+// `forward` drops again.
+template <HookId Hid, RefKind Kind> struct NewRefHook {
+  static inline jobject (*backup)(JNIEnv *, jobject) = nullptr;
+
+  static jobject forward(JNIEnv *env, jobject object, void *) {
+    return backup(env, object);
+  }
+
+  static jobject fake(JNIEnv *env, jobject object) {
+    return hook_dispatch(budget, slot, forward, env, object,
+                         __builtin_return_address(0));
+  }
+
+  static inline Hook hook{Hid, (void *)fake, (void **)&backup};
+
+  static jobject track(JNIEnv *env, jobject object, void *caller) {
+    jobject ref = call_backup(backup, env, object);
+    if (ref != nullptr && (hook_rules(hook) & kRefTrack)) {
+      ref_insert(ref, Kind, caller_library(caller));
+    }
+    return ref;
+  }
+
+  static inline HandlerSlot<jobject(JNIEnv *, jobject, void *)> slot{track};
+
+  static void trip() { slot.exchange(forward); }
+
+  static inline HookBudget budget{Hid, trip};
+};
+
+// `DeleteGlobalRef` and `DeleteWeakGlobalRef`. Erases regardless of the
+// rules: a stale entry would be reported as a leak.
+template <HookId Hid> struct DeleteRefHook {
+  static inline void (*backup)(JNIEnv *, jobject) = nullptr;
+
+  static void fake(JNIEnv *env, jobject ref) {
+    hook_dispatch(budget, slot, backup, env, ref);
+  }
+
+  static inline Hook hook{Hid, (void *)fake, (void **)&backup};
+
+  static void untrack(JNIEnv *env, jobject ref) {
+    if (ref != nullptr) ref_erase(ref);
+    call_backup(backup, env, ref);
+  }
+
+  static inline HandlerSlot<void(JNIEnv *, jobject)> slot{untrack};
+
+  static void trip() { slot.exchange(pass_through<backup>); }
+
+  static inline HookBudget budget{Hid, trip};
+};
+
+using NewGlobalHook = NewRefHook<kHookNewGlobalRef, kRefGlobal>;
+using DeleteGlobalHook = DeleteRefHook<kHookDeleteGlobalRef>;
+using NewWeakHook = NewRefHook<kHookNewWeakGlobalRef, kRefWeak>;
+using DeleteWeakHook = DeleteRefHook<kHookDeleteWeakGlobalRef>;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+static const JNINativeInterface *table = nullptr;
+static bool enabled = false;
+static bool attached = false;
+// Whether attaching was ever tried, so the table may hold entries.
+static bool tried = false;
+static bool stale = false;
+
+static void sync_locked() {
+  uint32_t rules = enabled ? kRefTrack : 0;
+  if (enabled && stale) {
+    for (auto &slot : slots) {
+      slot.owner.store(0, std::memory_order_relaxed);
+      slot.key.store(kRefFree, std::memory_order_relaxed);
+    }
+    stale = false;
+  }
+  // Deletes first, so that no reference is inserted that cannot be erased.
+  hook_set_rules(DeleteGlobalHook::hook, rules);
+  hook_set_rules(DeleteWeakHook::hook, rules);
+  hook_set_rules(NewGlobalHook::hook, rules);
+  hook_set_rules(NewWeakHook::hook, rules);
+  if (!enabled) stale = tried;
+  if (!enabled || table == nullptr || attached) return;
+  tried = true;
+  // Not short-circuiting: attaching is idempotent, and whatever did attach
+  // is kept while the rest is retried on the next enable.
+  attached =
+      hook_attach(DeleteGlobalHook::hook, (void *)table->DeleteGlobalRef) &
+      hook_attach(DeleteWeakHook::hook, (void *)table->DeleteWeakGlobalRef) &
+      hook_attach(NewGlobalHook::hook, (void *)table->NewGlobalRef) &
+      hook_attach(NewWeakHook::hook, (void *)table->NewWeakGlobalRef);
+}
+
+void global_refs_init(const JNINativeInterface *functions) {
+  std::lock_guard lock(control_mutex);
+  table = functions;
+  watchdog_register(NewGlobalHook::budget);
+  watchdog_register(DeleteGlobalHook::budget);
+  watchdog_register(NewWeakHook::budget);
+  watchdog_register(DeleteWeakHook::budget);
+  sync_locked();
+}
+
+void global_refs_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  enabled = enable;
+  sync_locked();
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Report
+ * -----------------------------------------------------------------------------
+ */
+
+uint32_t global_refs_live() {
+  RefCounts live{};
+  return ref_count(live);
+}
+
+void global_refs_report() {
+  RefCounts live{};
+  uint32_t total = ref_count(live);
+  if (total == 0) return;
+
+  uint32_t order[kMaxCallerLibraries];
+  for (uint32_t i = 0; i < kMaxCallerLibraries; ++i) order[i] = i;
+  auto held = [&](uint32_t id) {
+    return live[id][kRefGlobal] + live[id][kRefWeak];
+  };
+  std::sort(std::begin(order), std::end(order),
+            [&](uint32_t a, uint32_t b) { return held(a) > held(b); });
+
+  LOGI("global refs: %u live, %llu untracked; self time ~%llu/%llu ns "
+       "(new/delete)",
+       total,
+       (unsigned long long)untracked.load(std::memory_order_relaxed),
+       (unsigned long long)budget_mean_self_ns(NewGlobalHook::budget),
+       (unsigned long long)budget_mean_self_ns(DeleteGlobalHook::budget));
+  for (size_t rank = 0; rank < kRefReportTop; ++rank) {
+    uint32_t id = order[rank];
+    if (held(id) == 0) break;
+    LOGI("global refs: %-32s %6u global, %6u weak", caller_library_name(id),
+         live[id][kRefGlobal], live[id][kRefWeak]);
+  }
+}
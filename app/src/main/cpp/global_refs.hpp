@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <jni.h>
+
+/*
+ * =========================================================================================
+ *  Global reference accounting
+ * =========================================================================================
+ *
+ * A library that leaks global references eventually overflows ART's global
+ * reference table (which aborts the process), and long before that every GC
+ * has to visit each leaked root. With `kFeatureGlobalRefs`, hooks on
+ * `NewGlobalRef`, `DeleteGlobalRef`, `NewWeakGlobalRef` and
+ * `DeleteWeakGlobalRef` keep a table of live references and the library
+ * that created each one:
+ *
+ *   NewGlobalRef      backup, then insert ref -> (kind, calling library)
+ *   DeleteGlobalRef   erase ref, then backup
+ *
+ * Erasing before the backup matters: once ART has freed a reference, another
+ * thread may receive the same value from `NewGlobalRef` and insert it.
+ *
+ * The table is open addressing on the reference value, lock-free: inserts
+ * claim the first free slot with a CAS and give up after `kRefProbes` slots
+ * (counted as untracked). Erases free the slot again rather than leaving a
+ * tombstone, so churn never fills the table; in exchange a free slot does
+ * not end a lookup, which always scans the `kRefProbes` slots for a
+ * reference it does not find, such as one created before the hooks were
+ * installed. (Compacting tombstones instead would race with inserts that
+ * already probed past the slot.)
+ *
+ * The report lists the libraries holding the most live references, together
+ * with the measured self time of the hooks (see `watchdog.hpp`).
+ */
+
+constexpr uint32_t kGlobalRefReportWindows = 10;
+
+/**
+ * @brief Remembers the JNI function table. Called from `JNI_OnLoad`;
+ *        attaches the hooks if accounting is already enabled.
+ */
+void global_refs_init(const JNINativeInterface *functions);
+
+/**
+ * @brief Enables or disables accounting, see `config.hpp`.
+ *
+ * Disabling removes the hooks. Deletes in between go unseen, so enabling
+ * again starts from an empty table.
+ */
+void global_refs_enable(bool enabled);
+
+/**
+ * @brief Number of references in the table.
+ */
+uint32_t global_refs_live();
+
+/**
+ * @brief Logs the top libraries by live references. Runs on the watchdog
+ *        thread.
+ */
+void global_refs_report();
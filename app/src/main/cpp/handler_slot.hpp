@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Handler slots: swapping hook logic without re-hooking
+ * =========================================================================================
+ *
+ * Reinstalling a hook to change what it does means rewriting code in the
+ * target process. Instead, every replacement installed through `hook_func`
+ * is a thin forwarder that jumps through a `HandlerSlot`, an atomically
+ * swappable function pointer with the target's signature.
+ *
+ * ASCII Art: Indirection through a slot
+ *
+ *   fopen() --hook--> fake_fopen() --> fopen_slot --> [ fopen_enforce  ]
+ *                                          ^          [ fopen_pass     ]
+ *                                          |          [ ...            ]
+ *                                  exchange() swaps the pointer
+ *
+ * The call path takes no lock: it loads the pointer and calls it.
+ * `exchange()` publishes the new handler and returns at once; calls that
+ * already loaded the old one finish in it. Handlers are therefore static
+ * functions of this library, which is never unloaded, and nothing they use
+ * may be released just because the slot was switched away from them.
+ *
+ * The slot deliberately holds no quiescence read section across the call:
+ * handlers run the backup, which can block for as long as the target likes
+ * (a `fopen` on a FIFO, the group-commit wait of `fsync_policy.hpp`), and
+ * a section held that long would stall every `quiescence_synchronize()`,
+ * including the watchdog's reclaim. A handler that reads replaceable data
+ * (a policy, a remote file) enters its own section around that read and
+ * copies what it needs before calling the backup.
+ */
+
+template <typename Fn> class HandlerSlot;
+
+template <typename R, typename... Args> class HandlerSlot<R(Args...)> {
+public:
+  using Handler = R (*)(Args...);
+
+  constexpr explicit HandlerSlot(Handler initial) : handler_(initial) {}
+
+  HandlerSlot(const HandlerSlot &) = delete;
+  HandlerSlot &operator=(const HandlerSlot &) = delete;
+
+  /**
+   * @brief Calls the current handler.
+   */
+  R operator()(Args... args) {
+    return handler_.load(std::memory_order_acquire)(args...);
+  }
+
+  /**
+   * @brief Installs `next` for every call that starts from now on. Never
+   *        waits: calls already inside the previous handler may still be
+   *        running it.
+   * @return The previous handler.
+   */
+  Handler exchange(Handler next) {
+    return handler_.exchange(next, std::memory_order_acq_rel);
+  }
+
+  Handler current() const { return handler_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<Handler> handler_;
+};
+
+template <typename Fn> struct PassThrough;
+
+template <typename R, typename... Args> struct PassThrough<R (*)(Args...)> {
+  template <R (*&Backup)(Args...)> static R call(Args... args) {
+    return Backup(args...);
+  }
+};
+
+/**
+ * @brief A handler that forwards straight to the backup stored in `Backup`.
+ *
+ * Usage: `fopen_slot.exchange(pass_through<backup_fopen>)`.
+ */
+template <auto &Backup>
+constexpr auto pass_through =
+    &PassThrough<std::remove_cvref_t<decltype(Backup)>>::template call<Backup>;
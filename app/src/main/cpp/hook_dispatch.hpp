@@ -0,0 +1,61 @@
+#pragma once
+
+#include "handler_slot.hpp"
+#include "hook_stats.hpp"
+#include "hook_thread.hpp"
+#include "watchdog.hpp"
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Hook dispatch and the reentrancy guard
+ * =========================================================================================
+ *
+ * A replacement can end up calling its own hooked function: the backup of
+ * `fopen` may allocate, a handler may log, and either can come back into
+ * `fopen`. Without a guard, `fake_fopen` would then re-enter itself and
+ * apply its policy, count stats and take timings for calls that are really
+ * ours.
+ *
+ * `hook_dispatch` is the single entry every replacement forwards to:
+ *
+ *   fake_xxx(args)
+ *        |
+ *        v
+ *   own bit already set? --yes--> backup(args)   (one TLS load, nothing else)
+ *        | no
+ *        v
+ *   set own bit -> count -> watchdog sampling -> handler slot
+ *        |
+ *        v
+ *   clear own bit
+ *
+ * The guard is a bitmask by `HookId`, so it only stops a hook from
+ * re-entering itself. A call that reaches another hook from inside a
+ * handler, such as an `fopen` in a class initializer that a hooked
+ * `FindClass` runs, or an `fsync` while a grouped `fdatasync` waits, gets
+ * that hook's policy like any other call. Handlers that call hooked
+ * functions for purposes of their own wrap them in a `HookBypass`, which
+ * sets every bit.
+ */
+
+static_assert(kHookCount <= 32, "`HookThreadState::in_hook` has 32 bits");
+
+template <typename Slot, typename R, typename... Params, typename... Args>
+R hook_dispatch(HookBudget &budget, Slot &slot, R (*backup)(Params...),
+                Args... args) {
+  HookThreadState &state = hook_thread_state();
+  uint32_t bit = 1u << budget.id;
+  if (state.in_hook & bit) return backup(args...);
+
+  state.in_hook |= bit;
+  stat_count(budget.id);
+  if constexpr (std::is_void_v<R>) {
+    budget_track(state, budget, slot, args...);
+    state.in_hook &= ~bit;
+  } else {
+    R result = budget_track(state, budget, slot, args...);
+    state.in_hook &= ~bit;
+    return result;
+  }
+}
@@ -0,0 +1,159 @@
+#include "hook_manager.hpp"
+#include "clock.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "telemetry.hpp"
+#include <mutex>
+
+// The hook/unhook function pointers provided by LSPosed. We receive them in
+// `native_init` and can then use them anywhere else in our code. They never
+// change afterwards, so they live in the frozen arena (see `freeze.hpp`).
+struct HookApi {
+  HookFunType hook;
+  UnhookFunType unhook;
+};
+
+static const HookApi kNoHookApi{nullptr, nullptr};
+static const HookApi *api = &kNoHookApi;
+
+// Serializes install/uninstall transitions. Never taken on the call path.
+static ForkMutex transition_mutex;
+
+// Patches `target`. `id` is `kHookCount` for unmanaged hooks, which have no
+// telemetry slot.
+static bool install(const char *name, HookId id, void *target, void *replace,
+                    void **backup) {
+  int64_t start = monotonic_ns();
+  int ret = api->hook(target, replace, backup);
+  int64_t elapsed = monotonic_ns() - start;
+  LOGI("hook %s: ret=%d", name, ret);
+  if (ret == 0 && id != kHookCount) {
+    telemetry_event(kEventHookInstalled, id, elapsed);
+  }
+  return ret == 0;
+}
+
+static bool uninstall(const char *name, HookId id, void *target) {
+  int ret = api->unhook(target);
+  LOGI("unhook %s: ret=%d", name, ret);
+  if (ret == 0 && id != kHookCount) telemetry_event(kEventHookRemoved, id, 0);
+  return ret == 0;
+}
+
+/*
+ * Two hooks on the same target would chain their trampolines, and unhooking
+ * the first would silently drop the second. Every target is therefore claimed
+ * by exactly one owner: a managed `Hook` from `hook_attach` on, whether or
+ * not it is currently installed, or an unmanaged hook while it is installed.
+ */
+
+constexpr size_t kMaxHookTargets = 64;
+
+// Guarded by `transition_mutex`.
+static void *claimed_targets[kMaxHookTargets];
+
+static bool is_claimed_locked(void *target) {
+  for (void *claimed : claimed_targets) {
+    if (claimed == target) return true;
+  }
+  return false;
+}
+
+static bool claim_locked(void *target) {
+  if (is_claimed_locked(target)) return false;
+  for (void *&claimed : claimed_targets) {
+    if (claimed == nullptr) {
+      claimed = target;
+      return true;
+    }
+  }
+  LOGE("hook manager: more than %zu targets", kMaxHookTargets);
+  return false;
+}
+
+static void release_locked(void *target) {
+  for (void *&claimed : claimed_targets) {
+    if (claimed == target) claimed = nullptr;
+  }
+}
+
+// Brings `hook` in line with its rule set. Caller holds `transition_mutex`.
+static bool sync_locked(Hook &hook) {
+  bool installed = hook.installed.load(std::memory_order_relaxed);
+  bool wanted = hook.target != nullptr &&
+                hook.rules.load(std::memory_order_relaxed) != 0;
+  if (installed == wanted) return true;
+
+  if (wanted) {
+    if (api->hook == nullptr ||
+        !install(hook_name(hook.id), hook.id, hook.target, hook.replace,
+                 hook.backup)) {
+      return false;
+    }
+    hook.installed.store(true, std::memory_order_release);
+    return true;
+  }
+
+  // Older frameworks may not provide `unhookFunc`. The hook then stays in
+  // place and its replacement passes every call through.
+  if (api->unhook == nullptr) return false;
+  if (!uninstall(hook_name(hook.id), hook.id, hook.target)) return false;
+  hook.installed.store(false, std::memory_order_release);
+  return true;
+}
+
+void hook_manager_init(const NativeAPIEntries *entries) {
+  HookApi entry_points{entries->hookFunc, entries->unhookFunc};
+  const HookApi *frozen = freeze_new(entry_points);
+  // Without the arena the hooks still work; only the sharing is lost.
+  api = frozen != nullptr ? frozen : new HookApi(entry_points);
+}
+
+bool hook_attach(Hook &hook, void *target) {
+  std::lock_guard lock(transition_mutex);
+  if (hook.target != nullptr && hook.target != target) {
+    LOGW("hook %s: already attached to %p", hook_name(hook.id), hook.target);
+    return false;
+  }
+  if (hook.target == nullptr) {
+    if (target == nullptr || !claim_locked(target)) {
+      LOGW("hook %s: target %p unavailable", hook_name(hook.id), target);
+      return false;
+    }
+    hook.target = target;
+  }
+  return sync_locked(hook);
+}
+
+bool hook_set_rules(Hook &hook, uint32_t rules) {
+  std::lock_guard lock(transition_mutex);
+  // Publish the rules before installing so the first call already sees them;
+  // when clearing, replacements pass through until the unhook lands.
+  hook.rules.store(rules, std::memory_order_release);
+  return sync_locked(hook);
+}
+
+bool hook_install_unmanaged(const char *name, void *target, void *replace,
+                            void **backup) {
+  std::lock_guard lock(transition_mutex);
+  if (api->hook == nullptr || target == nullptr || !claim_locked(target)) {
+    return false;
+  }
+  if (install(name, kHookCount, target, replace, backup)) return true;
+  release_locked(target);
+  return false;
+}
+
+bool hook_uninstall_unmanaged(const char *name, void *target) {
+  std::lock_guard lock(transition_mutex);
+  if (api->unhook == nullptr || !uninstall(name, kHookCount, target)) {
+    return false;
+  }
+  release_locked(target);
+  return true;
+}
+
+bool hook_target_claimed(void *target) {
+  std::lock_guard lock(transition_mutex);
+  return is_claimed_locked(target);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "hook_stats.hpp"
+#include "native_api.hpp"
+#include <atomic>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Hook manager: install hooks only while they have something to do
+ * =========================================================================================
+ *
+ * A replacement that has no rules to enforce still costs a trampoline jump,
+ * a call and a return on every invocation. The hook manager ties the presence
+ * of a hook to its rule set: each `Hook` carries a bitmask of active rules,
+ * and the manager installs the hook when the mask becomes non-zero and removes
+ * it through `unhookFunc` when it drops back to zero. A process with nothing
+ * to enforce therefore runs the original, unpatched code.
+ *
+ * ASCII Art: Hook lifecycle
+ *
+ *                 hook_set_rules(h, mask != 0)
+ *    [ removed ] ------------------------------> [ installed ]
+ *         ^                                           |
+ *         +-------------------------------------------+
+ *                 hook_set_rules(h, 0)
+ *
+ * Replacements read the mask with `hook_rules()` (one acquire load) and must
+ * treat an empty mask as "pass through to the backup": between clearing the
+ * mask and the unhook taking effect, calls can still arrive.
+ *
+ * Requirement on the framework: `unhookFunc` restores the original code but
+ * cannot know whether a thread is still executing inside the replacement,
+ * or has just passed the patched entry on its way there. Such a thread calls
+ * the backup after the unhook, so the manager relies on `unhookFunc` leaving
+ * the backup (the trampoline with the relocated prologue) callable for the
+ * life of the process. A framework that frees trampolines on unhook must not
+ * hand out an `unhookFunc`: without one, hooks stay installed and an empty
+ * mask makes them pass every call through instead.
+ */
+
+struct Hook {
+  HookId id;
+  void *replace;
+  void **backup;
+  // Target address, known at `native_init` for libc functions and only when
+  // the owning library is loaded for targets like `target_fun`.
+  void *target = nullptr;
+  // Bitmask of active rules. The hook is installed iff this is non-zero and
+  // the target is known.
+  std::atomic<uint32_t> rules{0};
+  std::atomic<bool> installed{false};
+};
+
+/**
+ * @brief Stores the hook/unhook functions provided by LSPosed.
+ *
+ * Must be called from `native_init` before any other hook manager function.
+ * `entries->unhookFunc` may be null, and must be unless backups stay
+ * callable after unhooking (see above).
+ */
+void hook_manager_init(const NativeAPIEntries *entries);
+
+/**
+ * @brief Sets the address that `hook` patches, installing it if rules are
+ *        already active.
+ * @return `true` if the hook ends up in the desired state.
+ */
+bool hook_attach(Hook &hook, void *target);
+
+/**
+ * @brief Replaces the active rule set of `hook`.
+ *
+ * Installs the hook when `rules` becomes non-zero and removes it when `rules`
+ * becomes zero. Without an `unhookFunc` the hook stays installed and simply
+ * passes calls through.
+ *
+ * @return `true` if the hook ends up in the desired state.
+ */
+bool hook_set_rules(Hook &hook, uint32_t rules);
+
+/**
+ * @brief Returns the active rule set of `hook`, for use on the call path.
+ */
+inline uint32_t hook_rules(const Hook &hook) {
+  return hook.rules.load(std::memory_order_acquire);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Unmanaged hooks
+ * -----------------------------------------------------------------------------
+ *
+ * Some hooks are not part of the rule catalogue, for example the profiler
+ * thunks in `jni_profiler.hpp`, which are generated per target and switched
+ * as a group. They share the manager's bookkeeping of which targets are
+ * taken, but their owner decides when they come and go.
+ */
+
+/**
+ * @brief Installs a hook outside the rule catalogue.
+ *
+ * Fails without touching `target` if it is already claimed by a managed
+ * `Hook` (attached, installed or not) or by another unmanaged hook.
+ *
+ * @param name Used for logging only.
+ * @return `true` if the hook was installed.
+ */
+bool hook_install_unmanaged(const char *name, void *target, void *replace,
+                            void **backup);
+
+/**
+ * @brief Removes a hook installed by `hook_install_unmanaged`.
+ *
+ * As with managed hooks, the backup pointer must stay callable afterwards.
+ *
+ * @return `true` if the hook was removed; `false` if there is no
+ *         `unhookFunc` or unhooking failed, in which case it stays installed.
+ */
+bool hook_uninstall_unmanaged(const char *name, void *target);
+
+/**
+ * @brief Returns whether some hook of this module owns `target`.
+ */
+bool hook_target_claimed(void *target);
@@ -0,0 +1,65 @@
+#include "hook_stats.hpp"
+
+StatShard hook_stat_shards[kThreadShards];
+
+uint64_t stat_total(HookId id) {
+  uint64_t total = 0;
+  for (auto &shard : hook_stat_shards) {
+    total += shard.calls[id].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+const char *hook_name(HookId id) {
+  switch (id) {
+  case kHookTargetFun:
+    return "target_fun";
+  case kHookFopen:
+    return "fopen";
+  case kHookFindClass:
+    return "FindClass";
+  case kHookGetMethodID:
+    return "GetMethodID";
+  case kHookGetStaticMethodID:
+    return "GetStaticMethodID";
+  case kHookGetFieldID:
+    return "GetFieldID";
+  case kHookGetStaticFieldID:
+    return "GetStaticFieldID";
+  case kHookNewStringUTF:
+    return "NewStringUTF";
+  case kHookNewGlobalRef:
+    return "NewGlobalRef";
+  case kHookDeleteGlobalRef:
+    return "DeleteGlobalRef";
+  case kHookNewWeakGlobalRef:
+    return "NewWeakGlobalRef";
+  case kHookDeleteWeakGlobalRef:
+    return "DeleteWeakGlobalRef";
+  case kHookDlsym:
+    return "dlsym";
+  case kHookDlclose:
+    return "dlclose";
+  case kHookStat:
+    return "stat";
+  case kHookAccess:
+    return "access";
+  case kHookFaccessat:
+    return "faccessat";
+  case kHookOpendir:
+    return "opendir";
+  case kHookRename:
+    return "rename";
+  case kHookUnlink:
+    return "unlink";
+  case kHookSystemPropertyGet:
+    return "__system_property_get";
+  case kHookFsync:
+    return "fsync";
+  case kHookFdatasync:
+    return "fdatasync";
+  case kHookCount:
+    break;
+  }
+  return "unknown";
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "thread_shard.hpp"
+#include <atomic>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Per-hook call statistics
+ * =========================================================================================
+ *
+ * A hooked libc function such as `fopen` is called from every thread of the
+ * target process at once. A single shared counter per hook would make all of
+ * those threads fight over one cache line, turning a cheap increment into a
+ * cross-core round trip. Instead, every thread counts on its own shard (see
+ * `thread_shard.hpp`), and readers sum the shards when they want a total.
+ *
+ * ASCII Art: Sharded counters
+ *
+ *   thread A --+--> [ shard 0 | calls[kHookCount] ]  (own cache line)
+ *   thread B --|--> [ shard 1 | calls[kHookCount] ]  (own cache line)
+ *   thread C --+    ...
+ *              +--> [ shard 15 ...               ]
+ *
+ *   stat_total(id) = sum over all shards of calls[id]
+ *
+ * The totals are what the telemetry region and `NativeBridge.hookCalls`
+ * report, so the count has to happen on the call path; sharding keeps it at
+ * one uncontended relaxed add. `bench_hook_stress` in the host tests
+ * measures it against per-thread counters packed into shared cache lines
+ * and against a single shared counter.
+ */
+
+/**
+ * @brief Identifies every hook installed by this module.
+ *
+ * Used as an index into the statistics tables; keep `kHookCount` last.
+ */
+enum HookId : uint32_t {
+  kHookTargetFun,
+  kHookFopen,
+  kHookFindClass,
+  kHookGetMethodID,
+  kHookGetStaticMethodID,
+  kHookGetFieldID,
+  kHookGetStaticFieldID,
+  kHookNewStringUTF,
+  kHookNewGlobalRef,
+  kHookDeleteGlobalRef,
+  kHookNewWeakGlobalRef,
+  kHookDeleteWeakGlobalRef,
+  kHookDlsym,
+  kHookDlclose,
+  kHookStat,
+  kHookAccess,
+  kHookFaccessat,
+  kHookOpendir,
+  kHookRename,
+  kHookUnlink,
+  kHookSystemPropertyGet,
+  kHookFsync,
+  kHookFdatasync,
+  kHookCount,
+};
+
+struct alignas(kCacheLine) StatShard {
+  std::atomic<uint64_t> calls[kHookCount];
+};
+
+extern StatShard hook_stat_shards[kThreadShards];
+
+/**
+ * @brief Counts one call of the hook `id` on the calling thread's shard.
+ */
+inline void stat_count(HookId id) {
+  hook_stat_shards[thread_shard()].calls[id].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sums the calls of hook `id` across all shards.
+ */
+uint64_t stat_total(HookId id);
+
+/**
+ * @brief Returns a human-readable name for `id`, for logging.
+ */
+const char *hook_name(HookId id);
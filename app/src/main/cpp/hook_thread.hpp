@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Per-thread hook state
+ * =========================================================================================
+ *
+ * Everything a replacement needs to know about the calling thread lives in one
+ * thread-local block, so a hook call pays for a single TLS lookup no matter
+ * how many features (reentrancy guard, watchdog sampling, ...) consult it.
+ *
+ * We use the default TLS model rather than `initial-exec`: this library is
+ * `dlopen`ed, and bionic refuses static-TLS relocations in `dlopen`ed
+ * libraries (and below API 29 the NDK emulates TLS anyway).
+ */
+
+struct HookThreadState {
+  // Bit `1 << HookId` is set while this thread executes that hook's
+  // replacement, every bit while it does work of our own (`HookBypass`).
+  uint32_t in_hook;
+  // Set while the current call is timed by the watchdog.
+  bool sampling;
+  // Calls left until this thread times the next one.
+  int32_t countdown;
+  // Time spent in backups during the current timed call.
+  int64_t backup_ns;
+  // The JNI profiler's own `sampling` and `countdown` (`jni_profiler.hpp`),
+  // kept apart so it does not shift which calls the watchdog times.
+  bool profiling;
+  int32_t profile_countdown;
+};
+
+inline HookThreadState &hook_thread_state() {
+  thread_local HookThreadState state{};
+  return state;
+}
+
+constexpr uint32_t kHookBypassAll = ~0u;
+
+/**
+ * @brief Sends every hooked call the current thread makes in its scope
+ *        straight to the backup, for work that is ours rather than the
+ *        app's. Nests; the previous mask is restored on exit.
+ */
+class HookBypass {
+public:
+  HookBypass() : state_(hook_thread_state()), saved_(state_.in_hook) {
+    state_.in_hook = kHookBypassAll;
+  }
+  ~HookBypass() { state_.in_hook = saved_; }
+
+  HookBypass(const HookBypass &) = delete;
+  HookBypass &operator=(const HookBypass &) = delete;
+
+private:
+  HookThreadState &state_;
+  uint32_t saved_;
+};
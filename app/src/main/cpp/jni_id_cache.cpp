@@ -0,0 +1,318 @@
+#include "jni_id_cache.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "quiescence.hpp"
+#include "thread_shard.hpp"
+#include "watchdog.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+// The only rule of the four lookup hooks.
+constexpr uint32_t kIdCacheLookup = 1u << 0;
+
+constexpr size_t kIdCacheBuckets = 1024;
+constexpr size_t kIdCacheWays = 8;
+
+enum IdKind : uint32_t {
+  kIdMethod,
+  kIdStaticMethod,
+  kIdField,
+  kIdStaticField,
+  kIdKindCount,
+};
+
+constexpr HookId kKindHooks[kIdKindCount] = {
+    kHookGetMethodID,
+    kHookGetStaticMethodID,
+    kHookGetFieldID,
+    kHookGetStaticFieldID,
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Table
+ * -----------------------------------------------------------------------------
+ */
+
+// Immutable once published. `name` and `signature` point into the same
+// allocation, right behind the entry.
+struct IdEntry {
+  uint64_t hash;
+  jweak clazz;
+  void *id;
+  const char *name;
+  const char *signature;
+};
+
+// Immutable once published, newest entry first.
+struct IdBucket {
+  uint32_t count;
+  IdEntry *entries[kIdCacheWays];
+};
+
+static std::atomic<const IdBucket *> buckets[kIdCacheBuckets];
+
+// Serializes bucket rewrites. Only ever taken with `try_lock`, see `insert`.
+static ForkMutex insert_mutex;
+
+struct alignas(kCacheLine) IdCacheShard {
+  std::atomic<uint64_t> lookups[kIdKindCount];
+  std::atomic<uint64_t> hits[kIdKindCount];
+};
+
+static IdCacheShard shards[kThreadShards];
+
+static JavaVM *java_vm = nullptr;
+
+// FNV-1a over the kind, the name and the signature. The class cannot be part
+// of the hash: a `jclass` is a reference, not an identity.
+static uint64_t key_hash(IdKind kind, const char *name, const char *sig) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  auto mix = [&](unsigned char c) { hash = (hash ^ c) * 0x100000001b3ull; };
+  mix(static_cast<unsigned char>(kind));
+  for (const char *p = name; *p != '\0'; ++p) mix(*p);
+  mix('\0');
+  for (const char *p = sig; *p != '\0'; ++p) mix(*p);
+  return hash;
+}
+
+static bool matches(const IdEntry &entry, uint64_t hash, const char *name,
+                    const char *sig) {
+  return entry.hash == hash && strcmp(entry.name, name) == 0 &&
+         strcmp(entry.signature, sig) == 0;
+}
+
+static IdEntry *make_entry(uint64_t hash, jweak clazz, void *id,
+                           const char *name, const char *sig) {
+  size_t name_size = strlen(name) + 1;
+  size_t sig_size = strlen(sig) + 1;
+  auto *entry =
+      static_cast<IdEntry *>(malloc(sizeof(IdEntry) + name_size + sig_size));
+  if (entry == nullptr) return nullptr;
+  char *strings = reinterpret_cast<char *>(entry + 1);
+  memcpy(strings, name, name_size);
+  memcpy(strings + name_size, sig, sig_size);
+  *entry = {hash, clazz, id, strings, strings + name_size};
+  return entry;
+}
+
+// Dropped entries hold a weak global reference, which can only be deleted
+// with a `JNIEnv`. Reclaim functions run on the watchdog thread; it attaches
+// once, as a daemon, and otherwise sleeps in native code, where it never
+// holds up a GC.
+static JNIEnv *reclaim_env() {
+  JNIEnv *env = nullptr;
+  if (java_vm->GetEnv((void **)&env, JNI_VERSION_1_6) == JNI_OK) return env;
+  if (java_vm->AttachCurrentThreadAsDaemon(&env, nullptr) != JNI_OK) {
+    return nullptr;
+  }
+  return env;
+}
+
+static void free_entry(void *object) {
+  auto *entry = static_cast<IdEntry *>(object);
+  {
+    HookBypass bypass;
+    if (JNIEnv *env = reclaim_env()) env->DeleteWeakGlobalRef(entry->clazz);
+  }
+  free(entry);
+}
+
+static void free_bucket(void *object) {
+  delete static_cast<const IdBucket *>(object);
+}
+
+static void *find(JNIEnv *env, uint64_t hash, jclass clazz, const char *name,
+                  const char *sig) {
+  void *id = nullptr;
+  uint32_t token = quiescence_enter();
+  const IdBucket *bucket =
+      buckets[hash % kIdCacheBuckets].load(std::memory_order_acquire);
+  for (uint32_t i = 0; bucket != nullptr && i < bucket->count; ++i) {
+    const IdEntry &entry = *bucket->entries[i];
+    if (matches(entry, hash, name, sig) &&
+        env->IsSameObject(entry.clazz, clazz)) {
+      id = entry.id;
+      break;
+    }
+  }
+  quiescence_exit(token);
+  return id;
+}
+
+static void insert(JNIEnv *env, uint64_t hash, jclass clazz, const char *name,
+                   const char *sig, void *id) {
+  // Never wait for another inserter. Hooks are entered in native state, so
+  // waiting would not hold up the GC, but the holder may be parked inside
+  // `NewWeakGlobalRef` or `IsSameObject` until a GC pause ends, and an app
+  // thread should not wait for that. Losing the race just means one more
+  // miss later.
+  std::unique_lock lock(insert_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+
+  // The cache's own reference, not one the app should be charged for (see
+  // `global_refs.hpp`).
+  HookBypass bypass;
+  jweak weak = env->NewWeakGlobalRef(clazz);
+  if (weak == nullptr) return;
+  IdEntry *entry = make_entry(hash, weak, id, name, sig);
+  if (entry == nullptr) {
+    env->DeleteWeakGlobalRef(weak);
+    return;
+  }
+
+  std::atomic<const IdBucket *> &slot = buckets[hash % kIdCacheBuckets];
+  const IdBucket *old = slot.load(std::memory_order_relaxed);
+  auto *fresh = new IdBucket{};
+  fresh->entries[fresh->count++] = entry;
+  IdEntry *dropped[kIdCacheWays];
+  uint32_t dropped_count = 0;
+  for (uint32_t i = 0; old != nullptr && i < old->count; ++i) {
+    IdEntry *kept = old->entries[i];
+    // Entries of unloaded classes, the one we replace and the oldest entry
+    // of a full bucket go.
+    bool drop = fresh->count == kIdCacheWays ||
+                env->IsSameObject(kept->clazz, nullptr) ||
+                (matches(*kept, hash, name, sig) &&
+                 env->IsSameObject(kept->clazz, clazz));
+    if (drop) {
+      dropped[dropped_count++] = kept;
+    } else {
+      fresh->entries[fresh->count++] = kept;
+    }
+  }
+  slot.store(fresh, std::memory_order_release);
+
+  // Only now are the old bucket and the dropped entries unreachable for new
+  // readers.
+  if (old != nullptr) quiescence_retire(free_bucket, (void *)old);
+  for (uint32_t i = 0; i < dropped_count; ++i) {
+    quiescence_retire(free_entry, dropped[i]);
+  }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hooks
+ * -----------------------------------------------------------------------------
+ */
+
+template <IdKind Kind, typename Id>
+static Id resolve(Id (*backup)(JNIEnv *, jclass, const char *, const char *),
+                  JNIEnv *env, jclass clazz, const char *name,
+                  const char *sig) {
+  // Let ART report invalid arguments the way it always does.
+  if (clazz == nullptr || name == nullptr || sig == nullptr) {
+    return call_backup(backup, env, clazz, name, sig);
+  }
+  IdCacheShard &shard = shards[thread_shard()];
+  shard.lookups[Kind].fetch_add(1, std::memory_order_relaxed);
+  uint64_t hash = key_hash(Kind, name, sig);
+  if (void *id = find(env, hash, clazz, name, sig)) {
+    shard.hits[Kind].fetch_add(1, std::memory_order_relaxed);
+    return static_cast<Id>(id);
+  }
+  // A failed lookup returns null with a pending exception; not cached.
+  Id id = call_backup(backup, env, clazz, name, sig);
+  if (id != nullptr) insert(env, hash, clazz, name, sig, id);
+  return id;
+}
+
+// One lookup hook, in the same shape as the examples in `demo.cpp`.
+template <HookId Hid, IdKind Kind, typename Id> struct IdHook {
+  static inline Id (*backup)(JNIEnv *, jclass, const char *,
+                             const char *) = nullptr;
+
+  static Id fake(JNIEnv *env, jclass clazz, const char *name,
+                 const char *sig) {
+    return hook_dispatch(budget, slot, backup, env, clazz, name, sig);
+  }
+
+  static inline Hook hook{Hid, (void *)fake, (void **)&backup};
+
+  static Id cached(JNIEnv *env, jclass clazz, const char *name,
+                   const char *sig) {
+    if (!(hook_rules(hook) & kIdCacheLookup)) {
+      return call_backup(backup, env, clazz, name, sig);
+    }
+    return resolve<Kind>(backup, env, clazz, name, sig);
+  }
+
+  static inline HandlerSlot<Id(JNIEnv *, jclass, const char *, const char *)>
+      slot{cached};
+
+  static void trip() { slot.exchange(pass_through<backup>); }
+
+  static inline HookBudget budget{Hid, trip};
+};
+
+using MethodHook = IdHook<kHookGetMethodID, kIdMethod, jmethodID>;
+using StaticMethodHook =
+    IdHook<kHookGetStaticMethodID, kIdStaticMethod, jmethodID>;
+using FieldHook = IdHook<kHookGetFieldID, kIdField, jfieldID>;
+using StaticFieldHook = IdHook<kHookGetStaticFieldID, kIdStaticField, jfieldID>;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+static const JNINativeInterface *table = nullptr;
+static bool enabled = false;
+static bool attached = false;
+
+static void sync_locked() {
+  uint32_t rules = enabled ? kIdCacheLookup : 0;
+  hook_set_rules(MethodHook::hook, rules);
+  hook_set_rules(StaticMethodHook::hook, rules);
+  hook_set_rules(FieldHook::hook, rules);
+  hook_set_rules(StaticFieldHook::hook, rules);
+  if (!enabled || table == nullptr || attached) return;
+  // A target taken by another hook, or a failed install, is retried on the
+  // next enable; attaching again is a no-op for the hooks that made it.
+  attached = hook_attach(MethodHook::hook, (void *)table->GetMethodID) &
+             hook_attach(StaticMethodHook::hook,
+                         (void *)table->GetStaticMethodID) &
+             hook_attach(FieldHook::hook, (void *)table->GetFieldID) &
+             hook_attach(StaticFieldHook::hook,
+                         (void *)table->GetStaticFieldID);
+}
+
+void jni_id_cache_init(JavaVM *vm, const JNINativeInterface *functions) {
+  std::lock_guard lock(control_mutex);
+  java_vm = vm;
+  table = functions;
+  watchdog_register(MethodHook::budget);
+  watchdog_register(StaticMethodHook::budget);
+  watchdog_register(FieldHook::budget);
+  watchdog_register(StaticFieldHook::budget);
+  sync_locked();
+}
+
+void jni_id_cache_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  enabled = enable;
+  sync_locked();
+}
+
+void jni_id_cache_report() {
+  for (uint32_t kind = 0; kind < kIdKindCount; ++kind) {
+    uint64_t lookups = 0, hits = 0;
+    for (auto &shard : shards) {
+      lookups += shard.lookups[kind].load(std::memory_order_relaxed);
+      hits += shard.hits[kind].load(std::memory_order_relaxed);
+    }
+    if (lookups == 0) continue;
+    LOGI("jni id cache: %-18s %llu of %llu lookups hit (%llu%%)",
+         hook_name(kKindHooks[kind]), (unsigned long long)hits,
+         (unsigned long long)lookups,
+         (unsigned long long)(hits * 100 / lookups));
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <jni.h>
+
+/*
+ * =========================================================================================
+ *  JNI member ID cache
+ * =========================================================================================
+ *
+ * Many native libraries call `GetMethodID` and friends on every use instead
+ * of caching the result. Each such call makes ART resolve the name and
+ * signature against the class hierarchy again. This cache sits behind hooks
+ * on `GetMethodID`, `GetStaticMethodID`, `GetFieldID` and `GetStaticFieldID`
+ * and answers repeated lookups without entering ART's resolution code.
+ *
+ * ASCII Art: Lookup
+ *
+ *   GetMethodID(env, clazz, "run", "()V")
+ *        |
+ *        v
+ *   bucket = hash(kind, name, sig)          (no class in the hash: jclass
+ *        |                                   is a local ref, not identity)
+ *        v
+ *   for each entry in bucket:
+ *     name/sig match && IsSameObject(entry.clazz, clazz)? --yes--> entry.id
+ *        | no
+ *        v
+ *   backup(...) --> new entry with a *weak* global ref to clazz
+ *
+ * Class identity comes from a weak global reference, so the cache never
+ * keeps a class (or its class loader) alive. Once a class is unloaded its
+ * weak reference clears, its entries can no longer match, and they are
+ * dropped the next time their bucket is rewritten. An ID is only valid
+ * while its class is loaded, and a caller that passes a class has it loaded,
+ * so a matching entry is always current.
+ *
+ * Buckets are immutable and replaced as a whole (copy on write). Readers
+ * hold a quiescence read section (see `quiescence.hpp`); replaced buckets,
+ * dropped entries and their weak references are reclaimed by the watchdog
+ * thread, which attaches to the VM for that. App threads never wait here:
+ * an insert that finds another one in progress simply skips caching.
+ */
+
+constexpr uint32_t kJniIdCacheReportWindows = 10;
+
+/**
+ * @brief Remembers the VM and its JNI function table. Called from
+ *        `JNI_OnLoad`; attaches the hooks if the cache is already enabled.
+ */
+void jni_id_cache_init(JavaVM *vm, const JNINativeInterface *functions);
+
+/**
+ * @brief Enables or disables the cache, see `config.hpp`. Disabling
+ *        removes the hooks; cached entries are kept.
+ */
+void jni_id_cache_enable(bool enabled);
+
+/**
+ * @brief Logs hits and lookups per function. Runs on the watchdog thread.
+ */
+void jni_id_cache_report();
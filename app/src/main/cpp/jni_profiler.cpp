@@ -0,0 +1,237 @@
+#include "jni_profiler.hpp"
+#include "callers.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+#include "freeze.hpp"
+#include "hook_manager.hpp"
+#include "hook_thread.hpp"
+#include "logging.hpp"
+#include "thread_shard.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+
+constexpr size_t kJniReportTop = 8;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Counters
+ * -----------------------------------------------------------------------------
+ */
+
+struct alignas(kCacheLine) JniShard {
+  std::atomic<uint64_t> calls[kJniProfiledCount];
+  std::atomic<uint64_t> samples[kJniProfiledCount];
+  std::atomic<uint64_t> sampled_ns[kJniProfiledCount];
+};
+
+static JniShard shards[kThreadShards];
+
+// Sampled calls per (function, calling library). Only sampled calls touch
+// these, so they are not sharded.
+struct CallerCounters {
+  std::atomic<uint64_t> samples;
+  std::atomic<uint64_t> sampled_ns;
+};
+
+static CallerCounters callers[kJniProfiledCount][kMaxCallerLibraries];
+
+// Times the wrapped call it is scoped around and records the result on
+// destruction, after the backup has returned.
+class SampledCall {
+public:
+  SampledCall(HookThreadState &state, uint32_t fn, void *return_address)
+      : state_(state), fn_(fn), return_address_(return_address) {
+    state_.profile_countdown = static_cast<int32_t>(config_read().sample_every);
+    state_.profiling = true;
+    start_ = monotonic_ns();
+  }
+
+  ~SampledCall() {
+    int64_t ns = monotonic_ns() - start_;
+    JniShard &shard = shards[thread_shard()];
+    shard.samples[fn_].fetch_add(1, std::memory_order_relaxed);
+    shard.sampled_ns[fn_].fetch_add(ns, std::memory_order_relaxed);
+    // Resolving a new call site is ours, not the app's: keep other hooks out.
+    uint32_t library;
+    {
+      HookBypass bypass;
+      library = caller_library(return_address_);
+    }
+    CallerCounters &caller = callers[fn_][library];
+    caller.samples.fetch_add(1, std::memory_order_relaxed);
+    caller.sampled_ns.fetch_add(ns, std::memory_order_relaxed);
+    state_.profiling = false;
+  }
+
+private:
+  HookThreadState &state_;
+  uint32_t fn_;
+  void *return_address_;
+  int64_t start_;
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Thunks
+ * -----------------------------------------------------------------------------
+ */
+
+template <uint32_t Index, auto Member> struct JniThunk;
+
+template <uint32_t Index, typename R, typename... Args,
+          R (*JNINativeInterface::*Member)(JNIEnv *, Args...)>
+struct JniThunk<Index, Member> {
+  static inline R (*backup)(JNIEnv *, Args...) = nullptr;
+
+  static void *target(const JNINativeInterface *functions) {
+    return reinterpret_cast<void *>(functions->*Member);
+  }
+
+  static R call(JNIEnv *env, Args... args) {
+    HookThreadState &state = hook_thread_state();
+    // JNI calls made inside any of our hooks are not counted as the app's.
+    if (state.in_hook != 0) return backup(env, args...);
+    JniShard &shard = shards[thread_shard()];
+    shard.calls[Index].fetch_add(1, std::memory_order_relaxed);
+    if (--state.profile_countdown > 0 || state.profiling) {
+      return backup(env, args...);
+    }
+    // The thunk is entered by a jump from the patched entry, so our return
+    // address is the call site in the app.
+    SampledCall sample(state, Index, __builtin_return_address(0));
+    return backup(env, args...);
+  }
+};
+
+struct JniEntry {
+  const char *name;
+  void *(*target)(const JNINativeInterface *functions);
+  void *replace;
+  void **backup;
+};
+
+#define JNI_THUNK(name) JniThunk<kJni##name, &JNINativeInterface::name>
+#define JNI_PROFILED_ENTRY(name)                                               \
+  {#name, JNI_THUNK(name)::target, (void *)JNI_THUNK(name)::call,              \
+   (void **)&JNI_THUNK(name)::backup},
+
+static const JniEntry kEntries[] = {
+    JNI_PROFILED_FUNCTIONS(JNI_PROFILED_ENTRY)};
+
+#undef JNI_PROFILED_ENTRY
+#undef JNI_THUNK
+
+static_assert(std::size(kEntries) == kJniProfiledCount);
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Selection
+ * -----------------------------------------------------------------------------
+ */
+
+// Guards the fields below, except that the report reads `wrapped` without it.
+static ForkMutex select_mutex;
+static const JNINativeInterface *table = nullptr;
+static uint64_t selected = 0;
+static std::atomic<uint64_t> wrapped{0};
+
+static void sync_locked() {
+  if (table == nullptr) return;
+  uint64_t current = wrapped.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < kJniProfiledCount; ++i) {
+    uint64_t bit = 1ull << i;
+    bool want = selected & bit;
+    if (want == static_cast<bool>(current & bit)) continue;
+    const JniEntry &entry = kEntries[i];
+    void *target = entry.target(table);
+    if (!want) {
+      if (hook_uninstall_unmanaged(entry.name, target)) current &= ~bit;
+    } else if (target == nullptr || hook_target_claimed(target)) {
+      LOGD("jni profiler: %s is taken, skipped", entry.name);
+    } else if (hook_install_unmanaged(entry.name, target, entry.replace,
+                                      entry.backup)) {
+      current |= bit;
+    }
+  }
+  wrapped.store(current, std::memory_order_relaxed);
+}
+
+void jni_profiler_init(const JNINativeInterface *functions) {
+  std::lock_guard lock(select_mutex);
+  table = functions;
+  sync_locked();
+}
+
+void jni_profiler_select(uint64_t mask) {
+  std::lock_guard lock(select_mutex);
+  selected = mask & kJniProfileAll;
+  sync_locked();
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Report
+ * -----------------------------------------------------------------------------
+ */
+
+static uint64_t mean(uint64_t total, uint64_t count) {
+  return count > 0 ? total / count : 0;
+}
+
+void jni_profiler_report() {
+  if (wrapped.load(std::memory_order_relaxed) == 0) return;
+
+  uint64_t calls[kJniProfiledCount]{};
+  uint64_t samples[kJniProfiledCount]{};
+  uint64_t sampled_ns[kJniProfiledCount]{};
+  for (auto &shard : shards) {
+    for (uint32_t i = 0; i < kJniProfiledCount; ++i) {
+      calls[i] += shard.calls[i].load(std::memory_order_relaxed);
+      samples[i] += shard.samples[i].load(std::memory_order_relaxed);
+      sampled_ns[i] += shard.sampled_ns[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  uint32_t order[kJniProfiledCount];
+  for (uint32_t i = 0; i < kJniProfiledCount; ++i) order[i] = i;
+  std::sort(std::begin(order), std::end(order),
+            [&](uint32_t a, uint32_t b) { return calls[a] > calls[b]; });
+  for (size_t rank = 0; rank < kJniReportTop; ++rank) {
+    uint32_t i = order[rank];
+    if (calls[i] == 0) break;
+    LOGI("jni profiler: %-24s %10llu calls, ~%llu ns over %llu samples",
+         kEntries[i].name, (unsigned long long)calls[i],
+         (unsigned long long)mean(sampled_ns[i], samples[i]),
+         (unsigned long long)samples[i]);
+  }
+
+  struct Row {
+    uint32_t fn;
+    uint32_t library;
+    uint64_t samples;
+  };
+  Row rows[kJniProfiledCount * kMaxCallerLibraries];
+  size_t count = 0;
+  for (uint32_t fn = 0; fn < kJniProfiledCount; ++fn) {
+    for (uint32_t library = 0; library < kMaxCallerLibraries; ++library) {
+      uint64_t n = callers[fn][library].samples.load(std::memory_order_relaxed);
+      if (n > 0) rows[count++] = {fn, library, n};
+    }
+  }
+  size_t top = std::min(count, kJniReportTop);
+  std::partial_sort(rows, rows + top, rows + count,
+                    [](const Row &a, const Row &b) {
+                      return a.samples > b.samples;
+                    });
+  for (size_t rank = 0; rank < top; ++rank) {
+    const Row &row = rows[rank];
+    uint64_t ns = callers[row.fn][row.library].sampled_ns.load(
+        std::memory_order_relaxed);
+    LOGI("jni profiler: %-24s <- %s, %llu samples, ~%llu ns",
+         kEntries[row.fn].name, caller_library_name(row.library),
+         (unsigned long long)row.samples,
+         (unsigned long long)mean(ns, row.samples));
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <jni.h>
+
+/*
+ * =========================================================================================
+ *  JNI profiler: generated thunks for the JNI function table
+ * =========================================================================================
+ *
+ * `JNI_OnLoad` hooks one entry of `env->functions` by hand. The profiler does
+ * the same for a whole catalogue of entries, with one thunk per entry
+ * generated from a template that deduces the entry's signature from its
+ * member pointer:
+ *
+ *   JniThunk<kJniGetMethodID, &JNINativeInterface::GetMethodID>::call
+ *        |
+ *        +-- count the call in the calling thread's shard
+ *        +-- one call in `ModuleConfig::sample_every`: time it and attribute
+ *        |   it to the calling library (see `callers.hpp`)
+ *        v
+ *   backup(env, args...)
+ *
+ * The counters show which JNI functions a target app hammers, the caller
+ * table shows which of its libraries does it.
+ *
+ * Only entries with a fixed parameter list can be wrapped; the C-variadic
+ * `Call*Method` family has no portable way to forward its arguments, so the
+ * catalogue lists the `...A` variants instead. Entries owned by one of our
+ * other hooks, such as `FindClass`, are skipped (see `hook_manager.hpp`).
+ *
+ * Every thunk costs a trampoline jump and a TLS load on some of the hottest
+ * functions in ART. Sampling keeps its own countdown, so profiling does not
+ * shift which calls the watchdog times.
+ */
+
+#define JNI_PROFILED_FUNCTIONS(X)                                              \
+  X(FindClass)                                                                 \
+  X(GetObjectClass)                                                            \
+  X(IsInstanceOf)                                                              \
+  X(GetMethodID)                                                               \
+  X(GetStaticMethodID)                                                         \
+  X(GetFieldID)                                                                \
+  X(GetStaticFieldID)                                                          \
+  X(CallObjectMethodA)                                                         \
+  X(CallVoidMethodA)                                                           \
+  X(CallStaticObjectMethodA)                                                   \
+  X(NewGlobalRef)                                                              \
+  X(DeleteGlobalRef)                                                           \
+  X(DeleteLocalRef)                                                            \
+  X(NewWeakGlobalRef)                                                          \
+  X(DeleteWeakGlobalRef)                                                       \
+  X(ExceptionCheck)                                                            \
+  X(NewStringUTF)                                                              \
+  X(GetStringLength)                                                           \
+  X(GetStringUTFLength)                                                        \
+  X(GetStringUTFChars)                                                         \
+  X(ReleaseStringUTFChars)                                                     \
+  X(GetStringUTFRegion)                                                        \
+  X(GetArrayLength)                                                            \
+  X(NewByteArray)                                                              \
+  X(GetByteArrayRegion)                                                        \
+  X(SetByteArrayRegion)                                                        \
+  X(GetPrimitiveArrayCritical)                                                 \
+  X(ReleasePrimitiveArrayCritical)                                             \
+  X(GetDirectBufferAddress)
+
+enum JniProfiled : uint32_t {
+#define JNI_PROFILED_ENUM(name) kJni##name,
+  JNI_PROFILED_FUNCTIONS(JNI_PROFILED_ENUM)
+#undef JNI_PROFILED_ENUM
+      kJniProfiledCount
+};
+
+static_assert(kJniProfiledCount <= 64, "selection masks are 64 bits wide");
+
+constexpr uint64_t kJniProfileAll = (1ull << kJniProfiledCount) - 1;
+constexpr uint32_t kJniReportWindows = 10;
+
+/**
+ * @brief Remembers the process's JNI function table and wraps the entries
+ *        selected so far. Called from `JNI_OnLoad`.
+ */
+void jni_profiler_init(const JNINativeInterface *functions);
+
+/**
+ * @brief Wraps the entries whose bit (`1 << JniProfiled`) is set in `mask`
+ *        and unwraps the others.
+ *
+ * May be called before `jni_profiler_init`; the selection then takes effect
+ * once the table is known. Counters survive unwrapping.
+ */
+void jni_profiler_select(uint64_t mask);
+
+/**
+ * @brief Logs the busiest functions and calling libraries. Runs on the
+ *        watchdog thread.
+ */
+void jni_profiler_report();
@@ -0,0 +1,91 @@
+#include "jni_strings.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "mutf8.hpp"
+#include "watchdog.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+// The only rule of the `NewStringUTF` hook.
+constexpr uint32_t kNewStringTranscode = 1u << 0;
+
+// Strings up to this many bytes are decoded into a stack buffer.
+constexpr size_t kStackUnits = 256;
+
+jstring (*backup_NewStringUTF)(JNIEnv *env, const char *bytes);
+
+static jstring fake_NewStringUTF(JNIEnv *env, const char *bytes);
+
+static Hook new_string_utf_hook{kHookNewStringUTF, (void *)fake_NewStringUTF,
+                                (void **)&backup_NewStringUTF};
+
+static jstring new_string_transcode(JNIEnv *env, const char *bytes) {
+  if (!(hook_rules(new_string_utf_hook) & kNewStringTranscode) ||
+      bytes == nullptr) {
+    return call_backup(backup_NewStringUTF, env, bytes);
+  }
+  size_t length = strlen(bytes);
+  // Pure ASCII is ART's fast path already: one count, one copy.
+  if (mutf8_ascii_prefix(bytes, length) == length ||
+      length > static_cast<size_t>(INT32_MAX)) {
+    return call_backup(backup_NewStringUTF, env, bytes);
+  }
+
+  uint16_t stack[kStackUnits];
+  uint16_t *units = stack;
+  if (length > kStackUnits) {
+    units = static_cast<uint16_t *>(malloc(length * sizeof(uint16_t)));
+  }
+  if (units == nullptr) return call_backup(backup_NewStringUTF, env, bytes);
+  ptrdiff_t count = mutf8_to_utf16(bytes, length, units);
+  jstring string =
+      count < 0 ? call_backup(backup_NewStringUTF, env, bytes)
+                : call_backup(env->functions->NewString, env,
+                              static_cast<const jchar *>(units),
+                              static_cast<jsize>(count));
+  if (units != stack) free(units);
+  return string;
+}
+
+static HandlerSlot<jstring(JNIEnv *, const char *)> new_string_utf_slot{
+    new_string_transcode};
+
+static void new_string_utf_trip() {
+  new_string_utf_slot.exchange(pass_through<backup_NewStringUTF>);
+}
+
+static HookBudget new_string_utf_budget{kHookNewStringUTF,
+                                        new_string_utf_trip};
+
+static jstring fake_NewStringUTF(JNIEnv *env, const char *bytes) {
+  return hook_dispatch(new_string_utf_budget, new_string_utf_slot,
+                       backup_NewStringUTF, env, bytes);
+}
+
+static ForkMutex control_mutex;
+static const JNINativeInterface *table = nullptr;
+static bool enabled = false;
+
+static void sync_locked() {
+  hook_set_rules(new_string_utf_hook, enabled ? kNewStringTranscode : 0);
+  if (enabled && table != nullptr && new_string_utf_hook.target == nullptr) {
+    hook_attach(new_string_utf_hook, (void *)table->NewStringUTF);
+  }
+}
+
+void jni_strings_init(const JNINativeInterface *functions) {
+  std::lock_guard lock(control_mutex);
+  table = functions;
+  watchdog_register(new_string_utf_budget);
+  sync_locked();
+}
+
+void jni_strings_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  enabled = enable;
+  sync_locked();
+}
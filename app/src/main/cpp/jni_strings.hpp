@@ -0,0 +1,41 @@
+#pragma once
+
+#include <jni.h>
+
+/*
+ * =========================================================================================
+ *  NewStringUTF through our own transcoder
+ * =========================================================================================
+ *
+ * `NewStringUTF` makes ART count and then decode the modified UTF-8 input,
+ * both byte by byte. With `kFeatureJniStrings`, a hook on `NewStringUTF`
+ * decodes non-ASCII input with the vector transcoder from `mutf8.hpp` and
+ * creates the string with `NewString` instead:
+ *
+ *   NewStringUTF(env, bytes)
+ *        |
+ *        +-- all ASCII? -------------> backup (ART copies it into a
+ *        |                                     compressed string as is)
+ *        +-- malformed? -------------> backup (ART's lenient decoding)
+ *        v
+ *   mutf8_to_utf16 -> NewString(env, units, count)
+ *
+ * Both paths produce the same `String`: the transcoder decodes exactly like
+ * ART for well-formed input, and ART picks the compressed representation
+ * from the contents either way.
+ *
+ * `GetStringUTFChars` is deliberately left alone: its buffer is freed by
+ * `ReleaseStringUTFChars` with ART's allocator, and a buffer of ours could
+ * reach ART's release whenever our hook is bypassed or removed in between.
+ */
+
+/**
+ * @brief Remembers the JNI function table. Called from `JNI_OnLoad`;
+ *        attaches the hook if the feature is already enabled.
+ */
+void jni_strings_init(const JNINativeInterface *functions);
+
+/**
+ * @brief Enables or disables the `NewStringUTF` hook, see `config.hpp`.
+ */
+void jni_strings_enable(bool enabled);
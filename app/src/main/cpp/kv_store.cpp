@@ -0,0 +1,196 @@
+#include "kv_store.hpp"
+#include "logging.hpp"
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr size_t kKeyWords = (kKvMaxKey + 1) / 8;
+
+static uint64_t fnv1a(std::string_view key) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  // Zero marks a never-written slot.
+  return hash != 0 ? hash : 1;
+}
+
+static void pack_key(std::string_view key, uint64_t (&words)[kKeyWords]) {
+  memset(words, 0, sizeof(words));
+  memcpy(words, key.data(), key.size());
+}
+
+struct SlotCopy {
+  uint32_t type;
+  uint64_t hash;
+  uint64_t value;
+  uint64_t key[kKeyWords];
+};
+
+// A writer that died mid-write leaves the sequence odd for good, so readers
+// give up after this many attempts and treat the slot as unreadable.
+constexpr int kReadAttempts = 64;
+
+static std::optional<SlotCopy> read_slot(const KvSlot &slot) {
+  SlotCopy copy;
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    uint32_t before = slot.seq.load(std::memory_order_acquire);
+    if (before & 1) continue;
+    copy.type = slot.type.load(std::memory_order_relaxed);
+    copy.hash = slot.hash.load(std::memory_order_relaxed);
+    copy.value = slot.value.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kKeyWords; ++i) {
+      copy.key[i] = slot.key[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == before) return copy;
+  }
+  return std::nullopt;
+}
+
+static void write_slot(KvSlot &slot, uint32_t type, uint64_t hash,
+                       uint64_t value, const uint64_t (&key)[kKeyWords]) {
+  // `| 1` also recovers a slot left odd by a writer that died.
+  uint32_t seq = slot.seq.load(std::memory_order_relaxed) | 1;
+  slot.seq.store(seq, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.hash.store(hash, std::memory_order_relaxed);
+  slot.value.store(value, std::memory_order_relaxed);
+  for (size_t i = 0; i < kKeyWords; ++i) {
+    slot.key[i].store(key[i], std::memory_order_relaxed);
+  }
+  slot.type.store(type, std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_release);
+}
+
+bool KvStore::map(int fd, bool writable) {
+  std::lock_guard lock(write_mutex_);
+  if (is_mapped()) return true;
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0) {
+    PLOGE("kv: fstat");
+    return false;
+  }
+  if (st.st_size < static_cast<off_t>(kKvFileSize)) {
+    if (!writable || ftruncate(fd, kKvFileSize) != 0) {
+      LOGW("kv: store is smaller than %zu bytes", kKvFileSize);
+      return false;
+    }
+  }
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *addr = mmap(nullptr, kKvFileSize, prot, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    PLOGE("kv: mmap");
+    return false;
+  }
+
+  auto *header = static_cast<KvHeader *>(addr);
+  bool valid = header->magic.load(std::memory_order_acquire) == kKvMagic &&
+               header->version == kKvVersion &&
+               header->capacity == kKvCapacity;
+  if (!valid) {
+    if (!writable) {
+      LOGW("kv: store is not initialized");
+      munmap(addr, kKvFileSize);
+      return false;
+    }
+    memset(addr, 0, kKvFileSize);
+    header->version = kKvVersion;
+    header->capacity = kKvCapacity;
+    header->magic.store(kKvMagic, std::memory_order_release);
+  }
+  writable_ = writable;
+  header_.store(header, std::memory_order_release);
+  return true;
+}
+
+KvSlot *KvStore::slots() const {
+  auto *base = reinterpret_cast<uint8_t *>(
+      header_.load(std::memory_order_acquire));
+  return reinterpret_cast<KvSlot *>(base + sizeof(KvHeader));
+}
+
+std::optional<KvValue> KvStore::get(std::string_view key) const {
+  if (!is_mapped() || key.size() > kKvMaxKey) return std::nullopt;
+  uint64_t hash = fnv1a(key);
+  uint64_t packed[kKeyWords];
+  pack_key(key, packed);
+
+  KvSlot *table = slots();
+  for (uint32_t i = 0; i < kKvCapacity; ++i) {
+    auto copy = read_slot(table[(hash + i) & (kKvCapacity - 1)]);
+    // An unreadable slot may hold the key; answering "not found" is safe.
+    if (!copy) continue;
+    const SlotCopy &slot = *copy;
+    if (slot.type == kKvEmpty) return std::nullopt;
+    if (slot.hash != hash || memcmp(slot.key, packed, sizeof(packed)) != 0) {
+      continue;
+    }
+    if (slot.type == kKvRemoved) return std::nullopt;
+    return KvValue{static_cast<KvType>(slot.type), slot.value};
+  }
+  return std::nullopt;
+}
+
+int64_t KvStore::get_long(std::string_view key, int64_t fallback) const {
+  auto value = get(key);
+  if (!value || value->type != kKvLong) return fallback;
+  return static_cast<int64_t>(value->bits);
+}
+
+bool KvStore::get_bool(std::string_view key, bool fallback) const {
+  auto value = get(key);
+  if (!value || value->type != kKvBool) return fallback;
+  return value->bits != 0;
+}
+
+double KvStore::get_double(std::string_view key, double fallback) const {
+  auto value = get(key);
+  if (!value || value->type != kKvDouble) return fallback;
+  return std::bit_cast<double>(value->bits);
+}
+
+bool KvStore::put(std::string_view key, KvValue value) {
+  std::lock_guard lock(write_mutex_);
+  if (!is_mapped() || !writable_ || key.size() > kKvMaxKey) return false;
+  uint64_t hash = fnv1a(key);
+  uint64_t packed[kKeyWords];
+  pack_key(key, packed);
+
+  // Reuse the key's own slot (live or removed); otherwise claim the first
+  // empty slot. Tombstones of other keys are skipped to keep chains intact.
+  KvSlot *table = slots();
+  for (uint32_t i = 0; i < kKvCapacity; ++i) {
+    KvSlot &slot = table[(hash + i) & (kKvCapacity - 1)];
+    uint32_t type = slot.type.load(std::memory_order_relaxed);
+    // We are the only writer, so read without the seqlock: a slot left odd
+    // by a writer that died must still be recognized and rewritten.
+    bool same_key = type != kKvEmpty &&
+                    slot.hash.load(std::memory_order_relaxed) == hash;
+    for (size_t w = 0; same_key && w < kKeyWords; ++w) {
+      same_key = slot.key[w].load(std::memory_order_relaxed) == packed[w];
+    }
+    if (type == kKvEmpty || same_key) {
+      write_slot(slot, value.type, hash, value.bits, packed);
+      return true;
+    }
+  }
+  LOGW("kv: store is full");
+  return false;
+}
+
+bool KvStore::remove(std::string_view key) {
+  auto value = get(key);
+  if (!value) return false;
+  return put(key, {kKvRemoved, 0});
+}
+
+KvStore &module_settings() {
+  static KvStore store;
+  return store;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "freeze.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Memory-mapped key-value store for module settings
+ * =========================================================================================
+ *
+ * Reading a setting through Java `SharedPreferences` from native hook code
+ * means a JNI round trip and a hash map lookup on the Java heap. `KvStore`
+ * keeps typed settings in a file shared through `openRemoteFile`: the
+ * companion app writes it (through `NativeBridge.kvPut*`), the module maps it
+ * read-only, and hook code reads a value with a hash probe and a per-slot
+ * seqlock, all in shared memory.
+ *
+ * ASCII Art: File layout (`kKvFileSize` bytes)
+ *
+ *   0    header     magic "KVS1" | version | capacity
+ *   64   slots[256] one 64-byte slot per key, open addressing with linear
+ *                   probing on the FNV-1a hash of the key
+ *
+ *   slot: seq | type | hash | value | key[40]
+ *
+ * There is a single writer (the app), so slots are claimed without CAS; the
+ * slot's sequence number is odd while it is being written and readers retry,
+ * a bounded number of times: if the app dies mid-write, lookups of that slot
+ * miss (and fall back) until the next write to it. Removed keys leave a
+ * tombstone so probe chains stay intact.
+ */
+
+constexpr uint32_t kKvMagic = 0x3153564b; // "KVS1"
+constexpr uint32_t kKvVersion = 1;
+constexpr uint32_t kKvCapacity = 256;
+constexpr size_t kKvMaxKey = 39;
+
+enum KvType : uint32_t {
+  kKvEmpty = 0,
+  kKvLong = 1,
+  kKvBool = 2,
+  kKvDouble = 3,
+  kKvRemoved = 4,
+};
+
+struct KvValue {
+  KvType type;
+  uint64_t bits;
+};
+
+struct alignas(64) KvSlot {
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> type;
+  std::atomic<uint64_t> hash;
+  std::atomic<uint64_t> value;
+  std::atomic<uint64_t> key[(kKvMaxKey + 1) / 8];
+};
+
+struct alignas(64) KvHeader {
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t capacity;
+};
+
+static_assert(sizeof(KvSlot) == 64);
+static_assert(sizeof(KvHeader) == 64);
+
+constexpr size_t kKvFileSize = sizeof(KvHeader) + kKvCapacity * sizeof(KvSlot);
+
+class KvStore {
+public:
+  /**
+   * @brief Maps the store behind `fd`. Only the first successful call has an
+   *        effect, so readers never see the mapping go away.
+   *
+   * @param writable Map for writing, growing and initializing the file as
+   *                 needed. Read-only stores must already be initialized.
+   */
+  bool map(int fd, bool writable);
+
+  bool is_mapped() const {
+    return header_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  /**
+   * @brief Looks up `key`. Lock-free and bounded; safe from hook code.
+   */
+  std::optional<KvValue> get(std::string_view key) const;
+
+  int64_t get_long(std::string_view key, int64_t fallback) const;
+  bool get_bool(std::string_view key, bool fallback) const;
+  double get_double(std::string_view key, double fallback) const;
+
+  /**
+   * @brief Stores `value` under `key`. Requires a writable mapping.
+   * @return `false` if the key is too long or the store is full.
+   */
+  bool put(std::string_view key, KvValue value);
+
+  bool remove(std::string_view key);
+
+private:
+  KvSlot *slots() const;
+
+  std::atomic<KvHeader *> header_{nullptr};
+  bool writable_ = false;
+  // Stores are static (`module_settings`), as `ForkMutex` requires.
+  ForkMutex write_mutex_;
+};
+
+/**
+ * @brief The store holding this module's settings (`settings.kv`).
+ */
+KvStore &module_settings();
@@ -0,0 +1,193 @@
+#include "mmap_stream.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "path_rules.hpp"
+#include "quiescence.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Policy
+ * -----------------------------------------------------------------------------
+ */
+
+struct MmapPolicy {
+  size_t min_size;
+  uint32_t count;
+  uint32_t lengths[kMaxMmapPrefixes];
+  char prefixes[kMaxMmapPrefixes][kMaxMmapPrefix + 1];
+};
+
+// Replaced as a whole by `mmap_stream_configure` with a read-only copy
+// (see `freeze.hpp`); readers hold a quiescence read section.
+static std::atomic<const MmapPolicy *> policy{nullptr};
+static ForkMutex configure_mutex;
+
+using FopencookieFn = FILE *(*)(void *cookie, const char *mode,
+                                cookie_io_functions_t functions);
+
+// Resolved on first configuration, since it only exists from API 28 on.
+static std::atomic<FopencookieFn> fopencookie_fn{nullptr};
+
+// "r" followed by any of 'b' (ignored) and 'e' (moot without a descriptor).
+static bool read_only_mode(const char *mode) {
+  if (mode[0] != 'r') return false;
+  for (const char *c = mode + 1; *c != '\0'; ++c) {
+    if (*c != 'b' && *c != 'e') return false;
+  }
+  return true;
+}
+
+// The minimum size for `path`, or 0 if it is not whitelisted.
+static size_t mapped_min_size(const char *path) {
+  uint32_t token = quiescence_enter();
+  const MmapPolicy *current = policy.load(std::memory_order_acquire);
+  size_t min_size = 0;
+  for (uint32_t i = 0; current != nullptr && i < current->count; ++i) {
+    if (strncmp(path, current->prefixes[i], current->lengths[i]) == 0) {
+      // A zero-sized file is never mapped, so 1 stands for "any size".
+      min_size = current->min_size > 0 ? current->min_size : 1;
+      break;
+    }
+  }
+  quiescence_exit(token);
+  return min_size;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Stream
+ * -----------------------------------------------------------------------------
+ */
+
+struct MappedFile {
+  const char *base;
+  size_t size;
+  size_t offset;
+};
+
+static ssize_t mapped_read(void *cookie, char *buffer, size_t size) {
+  auto *file = static_cast<MappedFile *>(cookie);
+  if (file->offset >= file->size) return 0;
+  size_t count = file->size - file->offset;
+  if (count > size) count = size;
+  memcpy(buffer, file->base + file->offset, count);
+  file->offset += count;
+  return static_cast<ssize_t>(count);
+}
+
+static int mapped_seek(void *cookie, off64_t *offset, int whence) {
+  auto *file = static_cast<MappedFile *>(cookie);
+  off64_t base;
+  switch (whence) {
+  case SEEK_SET:
+    base = 0;
+    break;
+  case SEEK_CUR:
+    base = static_cast<off64_t>(file->offset);
+    break;
+  case SEEK_END:
+    base = static_cast<off64_t>(file->size);
+    break;
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+  off64_t target;
+  if (__builtin_add_overflow(base, *offset, &target) || target < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  // Seeking past the end is allowed; reads there return end of file.
+  file->offset = static_cast<size_t>(target);
+  *offset = target;
+  return 0;
+}
+
+static int mapped_close(void *cookie) {
+  auto *file = static_cast<MappedFile *>(cookie);
+  munmap(const_cast<char *>(file->base), file->size);
+  delete file;
+  return 0;
+}
+
+FILE *mmap_stream_open(const char *path, const char *mode) {
+  FopencookieFn open_cookie = fopencookie_fn.load(std::memory_order_acquire);
+  if (open_cookie == nullptr || path == nullptr || mode == nullptr ||
+      !read_only_mode(mode) || !plain_path(path)) {
+    return nullptr;
+  }
+  size_t min_size = mapped_min_size(path);
+  if (min_size == 0) return nullptr;
+
+  // Whatever goes wrong below, `backup_fopen` reports it the usual way.
+  int saved_errno = errno;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    errno = saved_errno;
+    return nullptr;
+  }
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      static_cast<uint64_t>(st.st_size) >= min_size &&
+      static_cast<uint64_t>(st.st_size) <= SIZE_MAX) {
+    base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    errno = saved_errno;
+    return nullptr;
+  }
+
+  auto *file = new MappedFile{static_cast<const char *>(base),
+                              static_cast<size_t>(st.st_size), 0};
+  cookie_io_functions_t functions{};
+  functions.read = mapped_read;
+  functions.seek = mapped_seek;
+  functions.close = mapped_close;
+  FILE *stream = open_cookie(file, "r", functions);
+  if (stream == nullptr) {
+    mapped_close(file);
+    errno = saved_errno;
+  }
+  return stream;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+void mmap_stream_configure(std::string_view prefixes, uint32_t min_kib) {
+  MmapPolicy next{};
+  next.min_size = size_t{min_kib} * 1024;
+  while (!prefixes.empty() && next.count < kMaxMmapPrefixes) {
+    std::string_view prefix = next_line(prefixes);
+    if (!valid_prefix(prefix, kMaxMmapPrefix)) continue;
+    memcpy(next.prefixes[next.count], prefix.data(), prefix.size());
+    next.lengths[next.count++] = prefix.size();
+  }
+  const MmapPolicy *frozen = next.count > 0 ? freeze_copy(next) : nullptr;
+
+  std::lock_guard lock(configure_mutex);
+  if (frozen != nullptr &&
+      fopencookie_fn.load(std::memory_order_relaxed) == nullptr) {
+    auto fn = reinterpret_cast<FopencookieFn>(
+        dlsym(RTLD_DEFAULT, "fopencookie"));
+    if (fn == nullptr) LOGW("mmap streams: fopencookie unavailable");
+    fopencookie_fn.store(fn, std::memory_order_release);
+  }
+  const MmapPolicy *previous =
+      policy.exchange(frozen, std::memory_order_acq_rel);
+  if (previous != nullptr) freeze_retire(previous);
+}
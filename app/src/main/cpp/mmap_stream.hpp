@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Memory-mapped `fopen` streams
+ * =========================================================================================
+ *
+ * Reading a large asset through a regular stream costs a `read` syscall per
+ * buffer refill, with the kernel copying every byte out of the page cache.
+ * With `kFeatureMmapStreams`, `fopen_enforce` first offers read-only opens
+ * to `mmap_stream_open`, which maps whitelisted files and returns a
+ * `fopencookie` stream that reads straight from the mapping:
+ *
+ *   fopen("/data/app/.../model.bin", "rb")
+ *        |
+ *        +-- mode other than "r" plus 'b' / 'e', relative path,
+ *        |   "." / ".." components, no prefix matches  --> backup_fopen
+ *        v
+ *   open + fstat: regular file of at least the minimum size?
+ *        | no --> backup_fopen
+ *        v
+ *   mmap(PROT_READ, MAP_PRIVATE), close(fd)
+ *   fopencookie(read / seek / close over the mapping)
+ *
+ * Refills become a `memcpy` from mapped pages, and large `fread`s bypass the
+ * stdio buffer entirely. Anything that fails along the way falls back to
+ * `backup_fopen`, so the caller sees a regular stream instead.
+ *
+ * The stream has no descriptor: `fileno` returns -1, and `fstat`, `mmap` or
+ * `flock` on it are impossible. Only whitelist files whose readers use stdio
+ * alone. The mapping is a snapshot in the sense of `MAP_PRIVATE`; a file
+ * truncated while mapped raises `SIGBUS` on access, as any mapping does, so
+ * only whitelist files that are not rewritten in place. `fopencookie` needs
+ * API 28; below that, the feature stays off.
+ */
+
+constexpr size_t kMaxMmapPrefixes = 8;
+constexpr size_t kMaxMmapPrefix = 63;
+
+/**
+ * @brief Sets the mapped path prefixes (separated by newlines, at most
+ *        `kMaxMmapPrefixes`) and the size below which files are read
+ *        normally. Streams already open are not affected.
+ */
+void mmap_stream_configure(std::string_view prefixes, uint32_t min_kib);
+
+/**
+ * @brief Opens `path` as a mapped stream if `mode` and `path` qualify.
+ *
+ * @return The stream, or nullptr if the caller should open the file itself.
+ */
+FILE *mmap_stream_open(const char *path, const char *mode);
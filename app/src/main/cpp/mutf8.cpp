@@ -0,0 +1,217 @@
+#include "mutf8.hpp"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Vector primitives. Each loop stops at the first block that is not all
+ *  ASCII; the scalar tail then finds the exact position.
+ * -----------------------------------------------------------------------------
+ */
+
+// Length of the leading whole 16-byte blocks of bytes in [0x01, 0x7f].
+static size_t ascii_blocks(const uint8_t *in, size_t length) {
+  size_t i = 0;
+#if defined(__aarch64__)
+  // Subtracting 1 maps the range to [0x00, 0x7e]; 0x00 wraps to 0xff.
+  const uint8x16_t one = vdupq_n_u8(1);
+  for (; i + 16 <= length; i += 16) {
+    uint8x16_t v = vsubq_u8(vld1q_u8(in + i), one);
+    if (vmaxvq_u8(v) >= 0x7f) break;
+  }
+#elif defined(__SSE2__)
+  // Same mapping; out-of-range bytes then have the sign bit set or are 0x7f.
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i del = _mm_set1_epi8(0x7f);
+  for (; i + 16 <= length; i += 16) {
+    __m128i v = _mm_sub_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)), one);
+    if (_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, del))) != 0) {
+      break;
+    }
+  }
+#endif
+  return i;
+}
+
+// Length of the leading whole 8-unit blocks of units in [0x0001, 0x007f].
+static size_t ascii_blocks(const uint16_t *in, size_t length) {
+  size_t i = 0;
+#if defined(__aarch64__)
+  const uint16x8_t one = vdupq_n_u16(1);
+  for (; i + 8 <= length; i += 8) {
+    uint16x8_t v = vsubq_u16(vld1q_u16(in + i), one);
+    if (vmaxvq_u16(v) >= 0x7f) break;
+  }
+#elif defined(__SSE2__)
+  // SSE2 only compares signed: units >= 0x8000 are negative and fail the
+  // first test, so the second can be signed as well.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi16(0x80);
+  for (; i + 8 <= length; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i ok = _mm_and_si128(_mm_cmpgt_epi16(v, zero),
+                               _mm_cmplt_epi16(v, limit));
+    if (_mm_movemask_epi8(ok) != 0xffff) break;
+  }
+#endif
+  return i;
+}
+
+// Copies ASCII bytes to UTF-16 units.
+static void widen(const uint8_t *in, size_t length, uint16_t *out) {
+  size_t i = 0;
+#if defined(__aarch64__)
+  for (; i + 16 <= length; i += 16) {
+    uint8x16_t v = vld1q_u8(in + i);
+    vst1q_u16(out + i, vmovl_u8(vget_low_u8(v)));
+    vst1q_u16(out + i + 8, vmovl_high_u8(v));
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8),
+                     _mm_unpackhi_epi8(v, zero));
+  }
+#endif
+  for (; i < length; ++i) out[i] = in[i];
+}
+
+// Copies ASCII UTF-16 units to bytes.
+static void narrow(const uint16_t *in, size_t length, uint8_t *out) {
+  size_t i = 0;
+#if defined(__aarch64__)
+  for (; i + 8 <= length; i += 8) {
+    vst1_u8(out + i, vmovn_u16(vld1q_u16(in + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 8 <= length; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i),
+                     _mm_packus_epi16(v, v));
+  }
+#endif
+  for (; i < length; ++i) out[i] = static_cast<uint8_t>(in[i]);
+}
+
+template <typename Unit> static size_t ascii_prefix(const Unit *in, size_t n) {
+  size_t i = ascii_blocks(in, n);
+  while (i < n && in[i] != 0 && in[i] < 0x80) ++i;
+  return i;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Transcoders
+ * -----------------------------------------------------------------------------
+ */
+
+size_t mutf8_ascii_prefix(const char *utf8, size_t length) {
+  return ascii_prefix(reinterpret_cast<const uint8_t *>(utf8), length);
+}
+
+ptrdiff_t mutf8_to_utf16(const char *utf8, size_t length, uint16_t *utf16) {
+  auto *in = reinterpret_cast<const uint8_t *>(utf8);
+  const uint8_t *end = in + length;
+  uint16_t *out = utf16;
+  while (in < end) {
+    size_t blocks = ascii_blocks(in, end - in);
+    widen(in, blocks, out);
+    in += blocks;
+    out += blocks;
+    // The next 16 bytes hold a character that is not plain ASCII, or are
+    // the last few: they go character by character.
+    const uint8_t *scalar_end = end - in > 16 ? in + 16 : end;
+    while (in < scalar_end) {
+      uint8_t lead = *in;
+      size_t left = end - in;
+      if (lead >= 0x01 && lead < 0x80) {
+        *out++ = lead;
+        in += 1;
+      } else if (lead >= 0xc0 && lead < 0xe0) {
+        if (left < 2 || (in[1] & 0xc0) != 0x80) return -1;
+        uint32_t code = ((lead & 0x1f) << 6) | (in[1] & 0x3f);
+        // Only the shortest form is well formed, except C0 80 for U+0000.
+        if (code < 0x80 && code != 0) return -1;
+        *out++ = static_cast<uint16_t>(code);
+        in += 2;
+      } else if (lead >= 0xe0 && lead < 0xf0) {
+        if (left < 3 || (in[1] & 0xc0) != 0x80 || (in[2] & 0xc0) != 0x80) {
+          return -1;
+        }
+        uint32_t code =
+            ((lead & 0x0f) << 12) | ((in[1] & 0x3f) << 6) | (in[2] & 0x3f);
+        if (code < 0x800) return -1;
+        *out++ = static_cast<uint16_t>(code);
+        in += 3;
+      } else if (lead >= 0xf0 && lead < 0xf8) {
+        if (left < 4 || (in[1] & 0xc0) != 0x80 || (in[2] & 0xc0) != 0x80 ||
+            (in[3] & 0xc0) != 0x80) {
+          return -1;
+        }
+        uint32_t code = ((lead & 0x07) << 18) | ((in[1] & 0x3f) << 12) |
+                        ((in[2] & 0x3f) << 6) | (in[3] & 0x3f);
+        // Four bytes must encode a supplementary code point.
+        if (code < 0x10000 || code > 0x10ffff) return -1;
+        // Same split as ART.
+        *out++ = static_cast<uint16_t>((code >> 10) + 0xd7c0);
+        *out++ = static_cast<uint16_t>((code & 0x3ff) + 0xdc00);
+        in += 4;
+      } else {
+        // NUL, stray continuation bytes, 0xf8..0xff.
+        return -1;
+      }
+    }
+  }
+  return out - utf16;
+}
+
+ptrdiff_t utf16_to_mutf8(const uint16_t *utf16, size_t length, char *utf8,
+                         size_t capacity) {
+  const uint16_t *in = utf16;
+  const uint16_t *end = utf16 + length;
+  auto *out = reinterpret_cast<uint8_t *>(utf8);
+  const uint8_t *out_end = out + capacity;
+  while (in < end) {
+    size_t blocks = ascii_blocks(in, end - in);
+    if (blocks > static_cast<size_t>(out_end - out)) return -1;
+    narrow(in, blocks, out);
+    in += blocks;
+    out += blocks;
+    // As when decoding, the next 8 units go one by one.
+    const uint16_t *scalar_end = end - in > 8 ? in + 8 : end;
+    while (in < scalar_end) {
+      uint32_t unit = *in++;
+      if (unit >= 0x01 && unit < 0x80) {
+        if (out == out_end) return -1;
+        *out++ = static_cast<uint8_t>(unit);
+      } else if (unit >= 0xd800 && unit <= 0xdbff && in < end &&
+                 *in >= 0xdc00 && *in <= 0xdfff) {
+        if (out_end - out < 4) return -1;
+        uint32_t code = (unit << 10) + *in++ - 0x035fdc00;
+        *out++ = static_cast<uint8_t>(0xf0 | (code >> 18));
+        *out++ = static_cast<uint8_t>(0x80 | ((code >> 12) & 0x3f));
+        *out++ = static_cast<uint8_t>(0x80 | ((code >> 6) & 0x3f));
+        *out++ = static_cast<uint8_t>(0x80 | (code & 0x3f));
+      } else if (unit > 0x7ff) {
+        if (out_end - out < 3) return -1;
+        *out++ = static_cast<uint8_t>(0xe0 | (unit >> 12));
+        *out++ = static_cast<uint8_t>(0x80 | ((unit >> 6) & 0x3f));
+        *out++ = static_cast<uint8_t>(0x80 | (unit & 0x3f));
+      } else {
+        // U+0000 and U+0080..U+07FF.
+        if (out_end - out < 2) return -1;
+        *out++ = static_cast<uint8_t>(0xc0 | (unit >> 6));
+        *out++ = static_cast<uint8_t>(0x80 | (unit & 0x3f));
+      }
+    }
+  }
+  return out - reinterpret_cast<uint8_t *>(utf8);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Modified UTF-8 <-> UTF-16
+ * =========================================================================================
+ *
+ * JNI passes strings as modified UTF-8 (MUTF-8) on the native side and as
+ * UTF-16 on the Java side. Real-world strings are overwhelmingly ASCII, so
+ * both transcoders first look for runs of ASCII and move them 16 bytes (or
+ * 8 UTF-16 units) at a time, and only fall back to the per-character state
+ * machine for the rest:
+ *
+ *   "config/ключ"
+ *    |---------|-------|
+ *     vector    scalar
+ *     (widen / narrow)
+ *
+ * The vector paths use NEON on arm64 and SSE2 on x86/x86_64 (both baseline
+ * for those ABIs); 32-bit ARM and everything else uses the scalar loop.
+ *
+ * Both functions produce exactly what ART's own converters produce
+ * (`ConvertModifiedUtf8ToUtf16` / `ConvertUtf16ToModifiedUtf8`):
+ *
+ *   U+0000              C0 80       (never a bare NUL byte)
+ *   U+0001..U+007F      1 byte
+ *   U+0080..U+07FF      2 bytes
+ *   U+0800..U+FFFF      3 bytes     (including unpaired surrogates)
+ *   surrogate pair      4 bytes     (ART's encoder, not the JVM's 6 bytes)
+ *
+ * ART decodes malformed input leniently, in ways that depend on the version.
+ * `mutf8_to_utf16` rejects anything that is not well formed instead, and
+ * callers hand those strings to ART unchanged. Well formed means the
+ * shortest form of each character, with C0 80 for U+0000; a surrogate pair
+ * may come as four bytes or, as the JVM writes it, as two three-byte
+ * surrogates. `mutf8_test` checks both directions against a port of ART's
+ * converters.
+ */
+
+/**
+ * @brief Returns the number of leading bytes of `utf8` in [0x01, 0x7f].
+ */
+size_t mutf8_ascii_prefix(const char *utf8, size_t length);
+
+/**
+ * @brief Decodes `length` bytes of modified UTF-8.
+ *
+ * Decoding never produces more units than there are bytes, so `utf16` needs
+ * room for `length` units.
+ *
+ * @return The number of UTF-16 units written, or -1 if the input is not well
+ *         formed (stray or missing continuation bytes, invalid lead bytes,
+ *         NUL bytes, overlong forms other than C0 80, code points above
+ *         U+10FFFF).
+ */
+ptrdiff_t mutf8_to_utf16(const char *utf8, size_t length, uint16_t *utf16);
+
+/**
+ * @brief Encodes `length` UTF-16 units as modified UTF-8, without a
+ *        terminator.
+ * @return The number of bytes written, or -1 if they do not fit into
+ *         `capacity` bytes.
+ */
+ptrdiff_t utf16_to_mutf8(const uint16_t *utf16, size_t length, char *utf8,
+                         size_t capacity);
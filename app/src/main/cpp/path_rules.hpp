@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Parsing and matching of path rules
+ * =========================================================================================
+ *
+ * The file policies (`fs_cache.hpp`, `mmap_stream.hpp`, `stdio_policy.hpp`,
+ * `fsync_policy.hpp`) and `property_cache.hpp` are configured with text from
+ * the app's preferences: one entry per line, the fields of an entry separated
+ * by spaces, and the first field an absolute path prefix.
+ *
+ *   "/data/data/com.example/cache/ 64 sequential\n/sdcard/ 0 noreuse"
+ *    `-------- next_line --------'
+ *    `------ next_field -------' `next_field' ...
+ *
+ * A prefix is compared byte for byte, so paths are matched only when they are
+ * absolute and free of "." and ".." components (`plain_path`).
+ */
+
+/**
+ * @brief Splits off the next line of `list`, without its '\n'.
+ */
+inline std::string_view next_line(std::string_view &list) {
+  size_t end = list.find('\n');
+  std::string_view line = list.substr(0, end);
+  list.remove_prefix(end == std::string_view::npos ? list.size() : end + 1);
+  return line;
+}
+
+/**
+ * @brief Splits off the next space-separated field of `line`.
+ */
+inline std::string_view next_field(std::string_view &line) {
+  size_t start = line.find_first_not_of(' ');
+  if (start == std::string_view::npos) return line = {};
+  line.remove_prefix(start);
+  size_t end = line.find(' ');
+  std::string_view field = line.substr(0, end);
+  line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+  return field;
+}
+
+/**
+ * @brief Whether `prefix` is absolute and at most `max_length` bytes.
+ */
+inline bool valid_prefix(std::string_view prefix, size_t max_length) {
+  return !prefix.empty() && prefix[0] == '/' && prefix.size() <= max_length;
+}
+
+/**
+ * @brief Whether `path` is absolute without "." or ".." components, which
+ *        would let a path outside every prefix match one.
+ */
+inline bool plain_path(const char *path) {
+  for (const char *dot = strstr(path, "/."); dot != nullptr;
+       dot = strstr(dot + 1, "/.")) {
+    char next = dot[2] == '.' ? dot[3] : dot[2];
+    if (next == '/' || next == '\0') return false;
+  }
+  return path[0] == '/';
+}
@@ -0,0 +1,267 @@
+#include "property_cache.hpp"
+#include "freeze.hpp"
+#include "handler_slot.hpp"
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "logging.hpp"
+#include "path_rules.hpp"
+#include "quiescence.hpp"
+#include "seqlock.hpp"
+#include "thread_shard.hpp"
+#include "watchdog.hpp"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <sys/system_properties.h>
+
+// The only rule of the `__system_property_get` hook.
+constexpr uint32_t kPropertyCacheLookup = 1u << 0;
+
+// Open addressing over the whitelist, at most half full.
+constexpr size_t kPropertyTableSlots = 2 * kMaxCachedProperties;
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Whitelist
+ * -----------------------------------------------------------------------------
+ */
+
+struct PropertyCopy {
+  // 0 until the first read is stored.
+  uint32_t valid;
+  uint32_t serial;
+  uint32_t length;
+  char value[PROP_VALUE_MAX];
+};
+
+// What the hook writes, by whitelist index.
+struct PropertyState {
+  // Found on first use; a `prop_info` lives as long as the process.
+  std::atomic<const prop_info *> info[kMaxCachedProperties];
+  Seqlock<PropertyCopy> copies[kMaxCachedProperties];
+};
+
+// Read-only once published (see `freeze.hpp`), apart from `*state`.
+struct PropertyPolicy {
+  uint32_t count;
+  // `index + 1` of the property hashed here, 0 if free.
+  uint8_t table[kPropertyTableSlots];
+  uint64_t hashes[kMaxCachedProperties];
+  char names[kMaxCachedProperties][kMaxCachedPropertyName + 1];
+  PropertyState *state;
+};
+
+// Replaced as a whole by `property_cache_configure`; readers hold a
+// quiescence read section.
+static std::atomic<const PropertyPolicy *> policy{nullptr};
+
+static void free_policy(void *object) {
+  auto *whitelist = static_cast<const PropertyPolicy *>(object);
+  delete whitelist->state;
+  freeze_release(whitelist, sizeof(PropertyPolicy));
+}
+
+static uint64_t name_hash(const char *name, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(name[i])) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// The whitelist index of `name`, or -1.
+static int find_index(const PropertyPolicy &whitelist, const char *name) {
+  size_t length = strnlen(name, kMaxCachedPropertyName + 1);
+  if (length > kMaxCachedPropertyName) return -1;
+  uint64_t hash = name_hash(name, length);
+  for (size_t i = 0; i < kPropertyTableSlots; ++i) {
+    uint8_t entry = whitelist.table[(hash + i) % kPropertyTableSlots];
+    if (entry == 0) return -1;
+    int index = entry - 1;
+    if (whitelist.hashes[index] == hash &&
+        strcmp(whitelist.names[index], name) == 0) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Hook
+ * -----------------------------------------------------------------------------
+ */
+
+// Serializes copy writes. Only ever taken with `try_lock`, see
+// `dlsym_cache.cpp`.
+static ForkMutex store_mutex;
+
+struct alignas(kCacheLine) PropertyShard {
+  std::atomic<uint64_t> lookups;
+  std::atomic<uint64_t> hits;
+};
+
+static PropertyShard shards[kThreadShards];
+
+int (*backup_system_property_get)(const char *name, char *value);
+
+static int fake_system_property_get(const char *name, char *value);
+
+static Hook property_get_hook{kHookSystemPropertyGet,
+                              (void *)fake_system_property_get,
+                              (void **)&backup_system_property_get};
+
+// What a lookup that missed leaves for `store_read`.
+struct PropertyMiss {
+  const prop_info *info;
+  uint32_t serial;
+};
+
+// Serves property `index` from the cache into `value` and returns its
+// length, or returns -1 and fills `miss` (`info` stays null if the property
+// does not exist yet). Called inside a read section.
+static int cached_read(PropertyState &state, int index, const char *name,
+                       char *value, PropertyMiss &miss) {
+  const prop_info *info = state.info[index].load(std::memory_order_acquire);
+  if (info == nullptr) {
+    info = __system_property_find(name);
+    if (info == nullptr) return -1;
+    state.info[index].store(info, std::memory_order_release);
+  }
+
+  PropertyShard &shard = shards[thread_shard()];
+  shard.lookups.fetch_add(1, std::memory_order_relaxed);
+  uint32_t serial = __system_property_serial(info);
+  PropertyCopy copy{};
+  bool readable = state.copies[index].try_read(copy);
+  if (readable && copy.valid && copy.serial == serial && !(serial & 1)) {
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    memcpy(value, copy.value, copy.length + 1);
+    return copy.length;
+  }
+  miss = {info, serial};
+  return -1;
+}
+
+// Stores the `length` bytes the backup read into `value` for `name`. The
+// whitelist may have been replaced while the backup ran, so it is looked up
+// again under a fresh read section.
+static void store_read(const char *name, const char *value, int length,
+                       const PropertyMiss &miss) {
+  // The value belongs to `serial` only if no update started in between.
+  if ((miss.serial & 1) || length < 0 || length >= PROP_VALUE_MAX ||
+      __system_property_serial(miss.info) != miss.serial) {
+    return;
+  }
+  std::unique_lock lock(store_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+  uint32_t token = quiescence_enter();
+  const PropertyPolicy *whitelist = policy.load(std::memory_order_acquire);
+  int index = whitelist != nullptr ? find_index(*whitelist, name) : -1;
+  if (index >= 0) {
+    PropertyCopy copy{1, miss.serial, static_cast<uint32_t>(length), {}};
+    memcpy(copy.value, value, length + 1);
+    whitelist->state->copies[index].write(copy);
+  }
+  quiescence_exit(token);
+}
+
+// Holds a read section only around the cache itself, never across the
+// backup (see `handler_slot.hpp`).
+static int property_get_cached(const char *name, char *value) {
+  if (!(hook_rules(property_get_hook) & kPropertyCacheLookup) ||
+      name == nullptr) {
+    return call_backup(backup_system_property_get, name, value);
+  }
+  PropertyMiss miss{};
+  uint32_t token = quiescence_enter();
+  const PropertyPolicy *whitelist = policy.load(std::memory_order_acquire);
+  int index = whitelist != nullptr ? find_index(*whitelist, name) : -1;
+  int length =
+      index >= 0 ? cached_read(*whitelist->state, index, name, value, miss)
+                 : -1;
+  quiescence_exit(token);
+  if (length >= 0) return length;
+
+  length = call_backup(backup_system_property_get, name, value);
+  if (miss.info != nullptr) store_read(name, value, length, miss);
+  return length;
+}
+
+static HandlerSlot<int(const char *, char *)> property_get_slot{
+    property_get_cached};
+
+static void property_get_trip() {
+  property_get_slot.exchange(pass_through<backup_system_property_get>);
+}
+
+static HookBudget property_get_budget{kHookSystemPropertyGet,
+                                      property_get_trip};
+
+static int fake_system_property_get(const char *name, char *value) {
+  return hook_dispatch(property_get_budget, property_get_slot,
+                       backup_system_property_get, name, value);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Control
+ * -----------------------------------------------------------------------------
+ */
+
+static ForkMutex control_mutex;
+
+void property_cache_init() {
+  std::lock_guard lock(control_mutex);
+  watchdog_register(property_get_budget);
+  hook_attach(property_get_hook, (void *)__system_property_get);
+}
+
+void property_cache_enable(bool enable) {
+  std::lock_guard lock(control_mutex);
+  hook_set_rules(property_get_hook, enable ? kPropertyCacheLookup : 0);
+}
+
+void property_cache_configure(std::string_view names) {
+  PropertyPolicy next{};
+  while (!names.empty() && next.count < kMaxCachedProperties) {
+    std::string_view name = next_line(names);
+    if (name.empty() || name.size() > kMaxCachedPropertyName) continue;
+    uint32_t index = next.count;
+    memcpy(next.names[index], name.data(), name.size());
+    next.names[index][name.size()] = '\0';
+    if (find_index(next, next.names[index]) >= 0) continue;
+    uint64_t hash = name_hash(name.data(), name.size());
+    next.hashes[index] = hash;
+    size_t slot = hash % kPropertyTableSlots;
+    while (next.table[slot] != 0) slot = (slot + 1) % kPropertyTableSlots;
+    next.table[slot] = index + 1;
+    next.count++;
+  }
+  const PropertyPolicy *frozen = nullptr;
+  if (next.count > 0) {
+    next.state = new PropertyState{};
+    frozen = freeze_copy(next);
+    if (frozen == nullptr) delete next.state;
+  }
+
+  std::lock_guard lock(control_mutex);
+  const PropertyPolicy *previous =
+      policy.exchange(frozen, std::memory_order_acq_rel);
+  if (previous != nullptr) {
+    quiescence_retire(free_policy, const_cast<PropertyPolicy *>(previous));
+  }
+}
+
+void property_cache_report() {
+  uint64_t lookups = 0, hits = 0;
+  for (auto &shard : shards) {
+    lookups += shard.lookups.load(std::memory_order_relaxed);
+    hits += shard.hits.load(std::memory_order_relaxed);
+  }
+  if (lookups == 0) return;
+  LOGI("property cache: %llu of %llu reads hit (%llu%%), self time ~%llu ns",
+       (unsigned long long)hits, (unsigned long long)lookups,
+       (unsigned long long)(hits * 100 / lookups),
+       (unsigned long long)budget_mean_self_ns(property_get_budget));
+}
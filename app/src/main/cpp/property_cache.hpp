@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  System property cache
+ * =========================================================================================
+ *
+ * Native code tends to call `__system_property_get` in loops, and every call
+ * walks the property area's trie to find the property before copying its
+ * value. With `kFeaturePropertyCache`, a hook answers repeated reads of
+ * whitelisted properties from a per-property copy instead:
+ *
+ *   __system_property_get("ro.build.version.sdk", value)
+ *        |
+ *        +-- not whitelisted (one hash probe) --> backup
+ *        v
+ *   info  = __system_property_find(name)       (once per property)
+ *   serial = __system_property_serial(info)    (one atomic load)
+ *   copy.serial == serial? --yes--> copy.value
+ *        | no
+ *        v
+ *   backup(name, value); keep it if the serial did not move meanwhile
+ *
+ * A property's serial changes with every update, so a copy is never served
+ * after its property changed. Properties that do not exist yet are not
+ * cached (there is no serial to validate against). While the serial is
+ * odd, an update is in progress and reads go to the backup.
+ *
+ * The whitelist is replaced as a whole by `property_cache_configure`; the
+ * copies live in it and start empty. Copies are seqlocks written with
+ * `try_lock`, as in `dlsym_cache.hpp`.
+ */
+
+constexpr uint32_t kPropertyCacheReportWindows = 10;
+constexpr size_t kMaxCachedProperties = 32;
+constexpr size_t kMaxCachedPropertyName = 63;
+
+/**
+ * @brief Attaches the hook, see `config.hpp`.
+ */
+void property_cache_init();
+
+/**
+ * @brief Enables or disables the cache.
+ */
+void property_cache_enable(bool enabled);
+
+/**
+ * @brief Sets the whitelisted property names, separated by newlines. At most
+ *        `kMaxCachedProperties` names are used.
+ */
+void property_cache_configure(std::string_view names);
+
+/**
+ * @brief Logs hits and lookups. Runs on the watchdog thread.
+ */
+void property_cache_report();
@@ -0,0 +1,71 @@
+#include "quiescence.hpp"
+#include "freeze.hpp"
+#include <mutex>
+#include <sched.h>
+#include <utility>
+#include <vector>
+
+QuiescenceShard quiescence_shards[kThreadShards];
+std::atomic<uint32_t> quiescence_epoch{0};
+
+// Writers are rare (handler swaps); serialize them so epochs flip one at a
+// time.
+static ForkMutex synchronize_mutex;
+
+// Sequentially consistent, like the readers' registration: see below.
+static void wait_drained(uint32_t idx) {
+  for (auto &shard : quiescence_shards) {
+    while (shard.active[idx].load(std::memory_order_seq_cst) != 0) {
+      sched_yield();
+    }
+  }
+}
+
+void quiescence_synchronize() {
+  // Store-buffer pattern: the writer stores the new pointer and then loads
+  // the reader counts, a reader adds to its count and then loads the
+  // pointer. Acquire/release alone lets both loads see the old values, so a
+  // reader holding the old pointer would go unnoticed. The fence orders the
+  // caller's publication before the counts are read.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::lock_guard lock(synchronize_mutex);
+  uint32_t current = quiescence_epoch.load(std::memory_order_relaxed) & 1;
+  // A reader may have sampled the epoch just before the previous flip and
+  // registered on the other side afterwards; drain it first.
+  wait_drained(current ^ 1);
+  quiescence_epoch.fetch_add(1, std::memory_order_seq_cst);
+  wait_drained(current);
+}
+
+struct Retired {
+  void (*reclaim)(void *object);
+  void *object;
+};
+
+static ForkMutex retired_mutex;
+static std::vector<Retired> retired;
+
+void quiescence_retire(void (*reclaim)(void *object), void *object) {
+  std::lock_guard lock(retired_mutex);
+  retired.push_back({reclaim, object});
+}
+
+void quiescence_reclaim() {
+  std::vector<Retired> batch;
+  {
+    std::lock_guard lock(retired_mutex);
+    batch = std::exchange(retired, {});
+  }
+  if (batch.empty()) return;
+  // Everything in `batch` was unreachable before it was retired, so once the
+  // readers of this grace period are gone, nobody can hold it any more.
+  quiescence_synchronize();
+  for (auto &item : batch) item.reclaim(item.object);
+}
+
+void quiescence_after_fork() {
+  for (auto &shard : quiescence_shards) {
+    shard.active[0].store(0, std::memory_order_relaxed);
+    shard.active[1].store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "thread_shard.hpp"
+#include <atomic>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Quiescence: knowing when no thread can still see old data
+ * =========================================================================================
+ *
+ * Hook handlers are swapped while other threads may be executing them. Before
+ * the old handler's code or data can be freed, every call that might have
+ * loaded the old pointer has to finish. This is a small sleepable-RCU scheme:
+ *
+ *   - Readers bracket their access with `quiescence_enter()` /
+ *     `quiescence_exit()`. That is one relaxed load of the epoch and two
+ *     atomic adds on the calling thread's own shard; no locks, no shared
+ *     cache line.
+ *   - A writer first publishes the new pointer, then calls
+ *     `quiescence_synchronize()`, which flips the epoch and waits until every
+ *     reader counted under the previous epoch has left.
+ *
+ * ASCII Art: Epoch flip
+ *
+ *   epoch 0:  readers count in active[0]
+ *                          |
+ *   synchronize():  wait active[1] == 0   (stragglers of the flip before)
+ *                   epoch = 1             (new readers count in active[1])
+ *                   wait active[0] == 0   (everyone who could see the old
+ *                                          pointer is gone)
+ *
+ * A reader that blocks inside the critical section never delays other
+ * readers, but it holds up every writer that synchronizes, and the watchdog
+ * thread that reclaims retired objects with them. Sections must therefore
+ * stay short and never span a call into the hooked function: copy what is
+ * needed, leave, then call the backup (see `handler_slot.hpp`).
+ */
+
+struct alignas(kCacheLine) QuiescenceShard {
+  std::atomic<uint32_t> active[2];
+};
+
+extern QuiescenceShard quiescence_shards[kThreadShards];
+extern std::atomic<uint32_t> quiescence_epoch;
+
+/**
+ * @brief Enters a read-side critical section.
+ * @return A token that must be passed to `quiescence_exit`.
+ */
+inline uint32_t quiescence_enter() {
+  uint32_t idx = quiescence_epoch.load(std::memory_order_relaxed) & 1;
+  // Sequentially consistent so that the caller's following load of the
+  // protected pointer cannot be reordered before the registration.
+  quiescence_shards[thread_shard()].active[idx].fetch_add(
+      1, std::memory_order_seq_cst);
+  return idx;
+}
+
+/**
+ * @brief Leaves the read-side critical section entered with token `idx`.
+ */
+inline void quiescence_exit(uint32_t idx) {
+  quiescence_shards[thread_shard()].active[idx].fetch_sub(
+      1, std::memory_order_release);
+}
+
+/**
+ * @brief Waits until every read-side critical section that started before
+ *        this call has ended.
+ *
+ * Must not be called from inside a read-side critical section.
+ */
+void quiescence_synchronize();
+
+/**
+ * @brief Hands `object` to `reclaim` once no read-side critical section that
+ *        may have seen it is left. Never blocks on readers.
+ *
+ * For writers that must not wait themselves, such as hook handlers running
+ * on app threads. The object must already be unreachable for new readers.
+ */
+void quiescence_retire(void (*reclaim)(void *object), void *object);
+
+/**
+ * @brief Synchronizes and reclaims everything retired before this call.
+ *
+ * Runs on the watchdog thread, which is also where reclaim functions run.
+ */
+void quiescence_reclaim();
+
+/**
+ * @brief Forgets the readers of threads that did not survive a fork. Runs in
+ *        the child, see `freeze.hpp`.
+ *
+ * The forking thread must not be inside a read-side critical section.
+ */
+void quiescence_after_fork();
@@ -0,0 +1,107 @@
+#include "remote_file.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "quiescence.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct RemoteFile {
+  char name[kMaxRemoteFileName + 1];
+  const char *data;
+  size_t size;
+  // Length of the mapping behind `data`, at least `size`.
+  size_t mapped;
+};
+
+static std::atomic<RemoteFile *> remote_files[kMaxRemoteFiles];
+
+// Serializes registrations; lookups never take it.
+static ForkMutex map_mutex;
+
+static void release(RemoteFile *file) {
+  if (file->mapped > 0) munmap(const_cast<char *>(file->data), file->mapped);
+  delete file;
+}
+
+// Copies the file into a private read-only mapping. Mapping the file itself
+// would share its pages with the app, which keeps rewriting it: a truncation
+// while a hook reads the view would raise SIGBUS.
+static bool snapshot(RemoteFile *file, int fd, size_t size) {
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    PLOGE("remote file: mmap");
+    return false;
+  }
+  size_t copied = 0;
+  while (copied < size) {
+    ssize_t n = pread(fd, static_cast<char *>(addr) + copied, size - copied,
+                      static_cast<off_t>(copied));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      PLOGE("remote file: read");
+      munmap(addr, size);
+      return false;
+    }
+    // The file shrank since `fstat`; keep what is there.
+    if (n == 0) break;
+    copied += n;
+  }
+  mprotect(addr, size, PROT_READ);
+  file->data = static_cast<const char *>(addr);
+  file->size = copied;
+  file->mapped = size;
+  return true;
+}
+
+long remote_file_map(std::string_view name, int fd) {
+  if (name.size() > kMaxRemoteFileName) return -1;
+  struct stat st{};
+  if (fstat(fd, &st) != 0) {
+    PLOGE("remote file: fstat");
+    return -1;
+  }
+
+  auto *file = new RemoteFile{};
+  memcpy(file->name, name.data(), name.size());
+  if (st.st_size > 0 && !snapshot(file, fd, st.st_size)) {
+    delete file;
+    return -1;
+  }
+
+  std::lock_guard lock(map_mutex);
+  std::atomic<RemoteFile *> *free_slot = nullptr;
+  for (auto &slot : remote_files) {
+    RemoteFile *current = slot.load(std::memory_order_relaxed);
+    if (current == nullptr) {
+      if (free_slot == nullptr) free_slot = &slot;
+    } else if (name == current->name) {
+      slot.store(file, std::memory_order_release);
+      quiescence_synchronize();
+      release(current);
+      return static_cast<long>(file->size);
+    }
+  }
+  if (free_slot == nullptr) {
+    LOGW("remote file: no room for %.*s", (int)name.size(), name.data());
+    release(file);
+    return -1;
+  }
+  free_slot->store(file, std::memory_order_release);
+  return static_cast<long>(file->size);
+}
+
+std::string_view remote_file_view(std::string_view name) {
+  for (auto &slot : remote_files) {
+    RemoteFile *file = slot.load(std::memory_order_acquire);
+    if (file != nullptr && name == file->name) {
+      return {file->data, file->size};
+    }
+  }
+  return {};
+}
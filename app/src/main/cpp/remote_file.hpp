@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Native snapshots of remote files
+ * =========================================================================================
+ *
+ * Config and rule blobs shipped through `openRemoteFile` can be several
+ * megabytes. Reading them on the Kotlin side decodes every byte into a Java
+ * string and encodes it again on the way through JNI. Instead, `ModuleMain`
+ * hands the file descriptor to `NativeBridge.mapRemoteFile`, which copies the
+ * file once into a private read-only mapping and registers it under its name;
+ * hook code then asks for a `std::string_view` of it. The `fopen` block list
+ * (`fopen_blocklist.txt`) is read this way.
+ *
+ * The copy is a snapshot: the app may rewrite or truncate the file at any
+ * time, which would fault a shared mapping of it. Load it again (map the
+ * name again) to pick up changes. `bench_remote_file` compares the load time
+ * with the Kotlin path.
+ *
+ * Mapping a name again replaces its view. The old mapping is only released
+ * after a quiescence period (see `quiescence.hpp`), so a view stays valid
+ * only inside the read-side critical section it was obtained in. Hook
+ * handlers enter one themselves and leave it before calling the backup.
+ */
+
+constexpr size_t kMaxRemoteFiles = 16;
+constexpr size_t kMaxRemoteFileName = 47;
+
+/**
+ * @brief Copies the file behind `fd` and registers the copy as `name`.
+ *
+ * The copy is independent of `fd`, which may be closed right away.
+ *
+ * @return The size of the file, or -1 on failure.
+ */
+long remote_file_map(std::string_view name, int fd);
+
+/**
+ * @brief Returns the contents of the remote file registered as `name`, or an
+ *        empty view if there is none. Lock-free.
+ */
+std::string_view remote_file_view(std::string_view name);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Seqlock: lock-free reads of a small, rarely written value
+ * =========================================================================================
+ *
+ * A reader loads the sequence number, copies the value and loads the sequence
+ * number again; if both loads match and are even, the copy is consistent.
+ * Writers make the sequence odd while they update the value, which sends
+ * concurrent readers around the loop once more.
+ *
+ *   writer:  seq = 2n+1  ->  store words  ->  seq = 2n+2
+ *   reader:  s1 = seq    ->  copy words   ->  s2 = seq   -> retry unless
+ *                                                           s1 == s2, even
+ *
+ * The value is stored as relaxed atomic words, so the racing copy is well
+ * defined. Readers never write shared memory, which keeps the cache line
+ * shared among all cores reading it.
+ *
+ * A writer that never finishes, such as one in another thread when the
+ * process forks, leaves the sequence odd in the child. `try_read` gives up
+ * after `kReadAttempts` and lets a cache treat the slot as a miss, and the
+ * next `write` starts from the odd sequence and evens it out, as the slots
+ * of `kv_store.hpp` do. `read` waits for the writer, so values without a
+ * fallback repair themselves after a fork (see `config_after_fork`).
+ */
+
+template <typename T> class Seqlock {
+  static_assert(std::is_trivially_copyable_v<T>);
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+public:
+  Seqlock() = default;
+  explicit Seqlock(const T &value) { store_words(value); }
+
+  static constexpr int kReadAttempts = 64;
+
+  /**
+   * @brief Copies a consistent value into `value`. False if writes kept
+   *        getting in the way for `kReadAttempts` tries.
+   */
+  bool try_read(T &value) const {
+    uint64_t buffer[kWords];
+    for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+      uint32_t before = seq_.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      for (size_t i = 0; i < kWords; ++i) {
+        buffer[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == before) {
+        memcpy(&value, buffer, sizeof(T));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Returns a consistent copy of the value, waiting out writers.
+   */
+  T read() const {
+    T value;
+    while (!try_read(value)) {
+    }
+    return value;
+  }
+
+  /**
+   * @brief Publishes `value`. Writers must be serialized by the caller.
+   */
+  void write(const T &value) {
+    // `| 1` also recovers a sequence left odd by a writer that never ended.
+    uint32_t seq = seq_.load(std::memory_order_relaxed) | 1;
+    seq_.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store_words(value);
+    seq_.store(seq + 1, std::memory_order_release);
+  }
+
+private:
+  void store_words(const T &value) {
+    uint64_t buffer[kWords] = {};
+    memcpy(buffer, &value, sizeof(T));
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(buffer[i], std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<uint64_t> words_[kWords]{};
+};
@@ -0,0 +1,106 @@
+#include "stdio_policy.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "path_rules.hpp"
+#include "quiescence.hpp"
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+
+struct StdioRule {
+  uint32_t length;
+  uint32_t buffer;
+  int advice;
+  char prefix[kMaxStdioPrefix + 1];
+};
+
+struct StdioPolicy {
+  uint32_t count;
+  StdioRule rules[kMaxStdioRules];
+};
+
+// Replaced as a whole by `stdio_policy_configure` with a read-only copy
+// (see `freeze.hpp`); readers hold a quiescence read section.
+static std::atomic<const StdioPolicy *> policy{nullptr};
+static ForkMutex configure_mutex;
+
+static bool parse_advice(std::string_view name, int &advice) {
+  static constexpr struct {
+    std::string_view name;
+    int advice;
+  } kAdvice[] = {
+      {"normal", POSIX_FADV_NORMAL},
+      {"sequential", POSIX_FADV_SEQUENTIAL},
+      {"random", POSIX_FADV_RANDOM},
+      {"noreuse", POSIX_FADV_NOREUSE},
+  };
+  for (auto &entry : kAdvice) {
+    if (entry.name != name) continue;
+    advice = entry.advice;
+    return true;
+  }
+  return false;
+}
+
+static bool parse_rule(std::string_view line, StdioRule &rule) {
+  std::string_view prefix = next_field(line);
+  std::string_view buffer = next_field(line);
+  std::string_view advice = next_field(line);
+  if (!valid_prefix(prefix, kMaxStdioPrefix)) return false;
+  uint32_t kib = 0;
+  auto [end, error] =
+      std::from_chars(buffer.data(), buffer.data() + buffer.size(), kib);
+  if (error != std::errc() || end != buffer.data() + buffer.size() ||
+      kib > kMaxStdioBufferKib || !parse_advice(advice, rule.advice)) {
+    return false;
+  }
+  memcpy(rule.prefix, prefix.data(), prefix.size());
+  rule.prefix[prefix.size()] = '\0';
+  rule.length = prefix.size();
+  rule.buffer = kib * 1024;
+  return true;
+}
+
+void stdio_policy_configure(std::string_view rules) {
+  StdioPolicy next{};
+  while (!rules.empty() && next.count < kMaxStdioRules) {
+    std::string_view line = next_line(rules);
+    if (line.empty()) continue;
+    if (parse_rule(line, next.rules[next.count])) {
+      next.count++;
+    } else {
+      LOGW("stdio policy: skipping rule \"%.*s\"", (int)line.size(),
+           line.data());
+    }
+  }
+  const StdioPolicy *frozen = next.count > 0 ? freeze_copy(next) : nullptr;
+
+  std::lock_guard lock(configure_mutex);
+  const StdioPolicy *previous =
+      policy.exchange(frozen, std::memory_order_acq_rel);
+  if (previous != nullptr) freeze_retire(previous);
+}
+
+void stdio_policy_apply(FILE *file, const char *path) {
+  if (file == nullptr || path == nullptr) return;
+  uint32_t token = quiescence_enter();
+  const StdioPolicy *current = policy.load(std::memory_order_acquire);
+  const StdioRule *match = nullptr;
+  for (uint32_t i = 0; current != nullptr && i < current->count; ++i) {
+    if (strncmp(path, current->rules[i].prefix, current->rules[i].length) ==
+        0) {
+      match = &current->rules[i];
+      break;
+    }
+  }
+  if (match != nullptr) {
+    // With no buffer of ours, bionic allocates one of this size itself.
+    if (match->buffer > 0) setvbuf(file, nullptr, _IOFBF, match->buffer);
+    if (match->advice != POSIX_FADV_NORMAL) {
+      posix_fadvise(fileno(file), 0, 0, match->advice);
+    }
+  }
+  quiescence_exit(token);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+/*
+ * =========================================================================================
+ *  Per-path stdio tuning for `fopen`
+ * =========================================================================================
+ *
+ * A stream from `fopen` reads through a default buffer of a few KiB, so an
+ * app that reads a multi-MB file front to back makes a `read` syscall every
+ * few KiB, and the kernel has to guess the access pattern from those calls
+ * alone. With `kFeatureStdioPolicy`, `fopen_enforce` hands every stream it
+ * opened to `stdio_policy_apply`, which matches the path against the
+ * configured rules and tunes the stream right after `backup_fopen`:
+ *
+ *   fopen("/data/app/.../base.apk", "r")
+ *        |
+ *        v
+ *   backup_fopen --> FILE *
+ *        |
+ *        +-- first rule whose prefix matches:
+ *        |     setvbuf(file, nullptr, _IOFBF, buffer)   (before any I/O)
+ *        |     posix_fadvise(fileno(file), 0, 0, advice)
+ *        v
+ *   return FILE *
+ *
+ * Rules are lines of `<prefix> <buffer KiB> <advice>`, where the advice is
+ * `normal`, `sequential`, `random` or `noreuse`, and a buffer of 0 keeps
+ * stdio's default. bionic allocates the requested buffer itself and frees it
+ * in `fclose`. The rule set is replaced as a whole by `stdio_policy_configure`
+ * and read under quiescence, like the prefixes in `fs_cache.hpp`.
+ */
+
+constexpr size_t kMaxStdioRules = 8;
+constexpr size_t kMaxStdioPrefix = 63;
+constexpr uint32_t kMaxStdioBufferKib = 1024;
+
+/**
+ * @brief Replaces the rules, one per line (see above). Malformed lines are
+ *        skipped; at most `kMaxStdioRules` rules are used.
+ */
+void stdio_policy_configure(std::string_view rules);
+
+/**
+ * @brief Tunes `file`, just opened from `path`, by the first matching rule.
+ *
+ * Must run before the first read or write on `file`.
+ */
+void stdio_policy_apply(FILE *file, const char *path);
@@ -0,0 +1,159 @@
+#include "telemetry.hpp"
+#include "clock.hpp"
+#include "logging.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static TelemetryProcess local_process;
+
+std::atomic<TelemetryProcess *> telemetry_process{&local_process};
+
+// The mapped file, kept for claiming a new slot after fork.
+static TelemetryFile *shared_file = nullptr;
+
+// How long to wait for another process to finish setting up the file.
+constexpr int64_t kInitializeTimeoutNs = 1'000'000'000;
+
+// Processes of other apps answer EPERM; only ESRCH means gone.
+static bool alive(uint32_t pid) {
+  return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+static bool initialize(TelemetryFile *file) {
+  uint64_t own = kTelemetryInitializing | static_cast<uint32_t>(getpid());
+  int64_t deadline = monotonic_ns() + kInitializeTimeoutNs;
+  for (;;) {
+    uint64_t state = file->state.load(std::memory_order_acquire);
+    if (state == kTelemetryReady) return true;
+    if ((state & kTelemetryInitializing) == kTelemetryInitializing &&
+        alive(static_cast<uint32_t>(state))) {
+      if (monotonic_ns() > deadline) return false;
+      usleep(1000);
+      continue;
+    }
+    // A new file, another layout, or an initializer that died.
+    if (!file->state.compare_exchange_strong(state, own,
+                                             std::memory_order_acquire)) {
+      continue;
+    }
+    memset(reinterpret_cast<char *>(file) + sizeof(file->state), 0,
+           kTelemetrySize - sizeof(file->state));
+    file->size = kTelemetrySize;
+    file->processes = kTelemetryProcesses;
+    file->state.store(kTelemetryReady, std::memory_order_release);
+    return true;
+  }
+}
+
+static void clear(TelemetryProcess &process) {
+  process.event_head.store(0, std::memory_order_relaxed);
+  for (auto &hook : process.hooks) {
+    hook.calls.store(0, std::memory_order_relaxed);
+    for (auto &bucket : hook.histogram) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+  for (auto &event : process.events) {
+    event.sequence.store(0, std::memory_order_relaxed);
+  }
+  // The cleared slot before anything this process records in it.
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Async-signal-safe, so it can run in the fork child.
+static TelemetryProcess *claim(TelemetryFile *file) {
+  uint32_t pid = static_cast<uint32_t>(getpid());
+  for (auto &process : file->process) {
+    uint32_t owner = process.pid.load(std::memory_order_relaxed);
+    if (owner != 0 && owner != pid && alive(owner)) continue;
+    if (process.pid.compare_exchange_strong(owner, pid,
+                                            std::memory_order_relaxed)) {
+      clear(process);
+      return &process;
+    }
+  }
+  return nullptr;
+}
+
+// Remote files may be handed to the module read-only. Try to reopen the same
+// file for writing through procfs; whether that is allowed depends on the
+// framework's file permissions and SELinux policy.
+static int writable_fd(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if (flags >= 0 && (flags & O_ACCMODE) != O_RDONLY) return dup(fd);
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  return open(path, O_RDWR | O_CLOEXEC);
+}
+
+bool telemetry_map(int fd) {
+  int rw_fd = writable_fd(fd);
+  if (rw_fd < 0) {
+    LOGW("telemetry: file is not writable, keeping stats process-local");
+    return false;
+  }
+  struct stat st{};
+  if (fstat(rw_fd, &st) != 0 || st.st_size < kTelemetrySize) {
+    LOGW("telemetry: file is smaller than %u bytes", kTelemetrySize);
+    close(rw_fd);
+    return false;
+  }
+  void *addr = mmap(nullptr, kTelemetrySize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, rw_fd, 0);
+  close(rw_fd);
+  if (addr == MAP_FAILED) {
+    PLOGE("telemetry: mmap");
+    return false;
+  }
+  auto *file = static_cast<TelemetryFile *>(addr);
+  if (!initialize(file)) {
+    LOGW("telemetry: file is still being set up by another process");
+    munmap(addr, kTelemetrySize);
+    return false;
+  }
+  TelemetryProcess *process = claim(file);
+  if (process == nullptr) {
+    LOGW("telemetry: all %u process slots are taken", kTelemetryProcesses);
+    munmap(addr, kTelemetrySize);
+    return false;
+  }
+  shared_file = file;
+  telemetry_process.store(process, std::memory_order_release);
+  telemetry_publish_calls();
+  LOGI("telemetry: mapped slot %td", process - file->process);
+  return true;
+}
+
+void telemetry_after_fork() {
+  if (shared_file == nullptr) return;
+  TelemetryProcess *process = claim(shared_file);
+  telemetry_process.store(process != nullptr ? process : &local_process,
+                          std::memory_order_relaxed);
+}
+
+void telemetry_publish_calls() {
+  TelemetryProcess *process = telemetry_process.load(std::memory_order_relaxed);
+  for (uint32_t id = 0; id < kHookCount; ++id) {
+    process->hooks[id].calls.store(stat_total(static_cast<HookId>(id)),
+                                   std::memory_order_relaxed);
+  }
+}
+
+void telemetry_event(TelemetryEventType type, HookId id, uint64_t value) {
+  TelemetryProcess *process = telemetry_process.load(std::memory_order_relaxed);
+  uint64_t index = process->event_head.fetch_add(1, std::memory_order_relaxed);
+  TelemetryEvent &event = process->events[index % kTelemetryEvents];
+  event.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.timestamp_ns.store(monotonic_ns(), std::memory_order_relaxed);
+  event.type.store(type, std::memory_order_relaxed);
+  event.hook.store(id, std::memory_order_relaxed);
+  event.value.store(value, std::memory_order_relaxed);
+  event.sequence.store(index + 1, std::memory_order_release);
+}
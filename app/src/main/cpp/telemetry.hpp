@@ -0,0 +1,162 @@
+#pragma once
+
+#include "hook_stats.hpp"
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Telemetry: live hook statistics shared with the companion app
+ * =========================================================================================
+ *
+ * The companion app (`MainActivity`) cannot ask a target process what its
+ * hooks are doing without an IPC round trip. Instead, the module maps a file
+ * obtained through `openRemoteFile("telemetry.bin")` and keeps a fixed-layout
+ * region in it up to date; the app creates the file at `kTelemetrySize`,
+ * maps it as well and simply reads it.
+ *
+ * All fields are little-endian and at fixed offsets (checked below), so the
+ * Kotlin reader (`TelemetryReader.kt`) can decode it with a `ByteBuffer`.
+ * Bump `kTelemetryVersion` whenever the layout changes.
+ *
+ * Several processes of the same app can have the module loaded, and all of
+ * them map the same file. Each one claims a process slot of its own (CAS of
+ * its pid into `pid`, taking over slots of processes that have exited) and
+ * only ever writes there; a forked child claims a new slot. When all slots
+ * are taken, the process keeps its statistics local.
+ *
+ * The header word `state` decides who sets the file up. The first process to
+ * find it zero (a new file) or holding another layout swaps in
+ * `kTelemetryInitializing | pid`, clears the file and then stores
+ * `kTelemetryReady`; everybody else waits for that, or takes over if the
+ * initializing process died half-way.
+ *
+ * ASCII Art: File layout (version 3, `kTelemetrySize` bytes)
+ *
+ *   0     state               magic "TELM" | version << 32 once ready
+ *   8     size | processes
+ *   64    processes[8]        6416 bytes each:
+ *           0     pid | reserved
+ *           8     event_head          (number of events ever written)
+ *           16    hooks[32]           calls + 16-bucket self-time histogram
+ *           4368  events[64]          ring of the last 64 events
+ *
+ * Slots of processes that exited keep their last values until reused. Pid
+ * reuse makes a dead process look alive, which only costs a slot.
+ *
+ * Writers only use relaxed atomics: counters are published by the watchdog
+ * thread once per window, histograms by sampled calls, events when hooks are
+ * installed, removed or tripped. Nothing is written per call.
+ */
+
+constexpr uint32_t kTelemetryMagic = 0x4d4c4554; // "TELM"
+constexpr uint32_t kTelemetryVersion = 3;
+constexpr uint64_t kTelemetryReady =
+    kTelemetryMagic | uint64_t{kTelemetryVersion} << 32;
+constexpr uint64_t kTelemetryInitializing = uint64_t{0xffffffff} << 32;
+constexpr uint32_t kTelemetrySize = 64 * 1024;
+constexpr uint32_t kTelemetryProcesses = 8;
+constexpr uint32_t kTelemetryHooks = 32;
+constexpr uint32_t kTelemetryBuckets = 16;
+constexpr uint32_t kTelemetryEvents = 64;
+
+static_assert(kHookCount <= kTelemetryHooks);
+
+enum TelemetryEventType : uint32_t {
+  kEventHookInstalled = 1,
+  kEventHookRemoved = 2,
+  kEventHookTripped = 3,
+};
+
+struct TelemetryHook {
+  std::atomic<uint64_t> calls;
+  // Bucket `i` counts sampled self times in [2^(i+6), 2^(i+7)) ns; bucket 0
+  // also holds everything faster, the last bucket everything slower.
+  std::atomic<uint64_t> histogram[kTelemetryBuckets];
+};
+
+struct TelemetryEvent {
+  // `index + 1` of the event stored here: cleared (and fenced) first, written
+  // last. Readers check it before and after copying the fields, and skip
+  // slots whose sequence does not match the index they expect.
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> timestamp_ns;
+  std::atomic<uint32_t> type;
+  std::atomic<uint32_t> hook;
+  std::atomic<uint64_t> value;
+};
+
+struct TelemetryProcess {
+  std::atomic<uint32_t> pid;
+  uint32_t reserved;
+  std::atomic<uint64_t> event_head;
+  TelemetryHook hooks[kTelemetryHooks];
+  TelemetryEvent events[kTelemetryEvents];
+};
+
+struct TelemetryFile {
+  std::atomic<uint64_t> state;
+  uint32_t size;
+  uint32_t processes;
+  uint8_t reserved[48];
+  TelemetryProcess process[kTelemetryProcesses];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be address-free");
+static_assert(offsetof(TelemetryProcess, event_head) == 8);
+static_assert(offsetof(TelemetryProcess, hooks) == 16);
+static_assert(sizeof(TelemetryHook) == 136);
+static_assert(offsetof(TelemetryProcess, events) == 4368);
+static_assert(sizeof(TelemetryEvent) == 32);
+static_assert(sizeof(TelemetryProcess) == 6416);
+static_assert(offsetof(TelemetryFile, process) == 64);
+static_assert(sizeof(TelemetryFile) <= kTelemetrySize);
+
+// Points at this process's slot once `telemetry_map` succeeded, and at a
+// process-local slot before that, so writers never need a null check.
+extern std::atomic<TelemetryProcess *> telemetry_process;
+
+/**
+ * @brief Maps the telemetry file behind `fd` and starts publishing into it.
+ *
+ * The mapping stays valid after `fd` is closed. Falls back to the
+ * process-local slot if the file is not writable, has no free slot, or
+ * another process does not finish setting it up.
+ *
+ * @return `true` if a slot in the shared file is now in use.
+ */
+bool telemetry_map(int fd);
+
+/**
+ * @brief Moves a forked child to a slot of its own, see `freeze.hpp`.
+ */
+void telemetry_after_fork();
+
+/**
+ * @brief Records one sampled self time of hook `id` in its histogram.
+ */
+inline void telemetry_record_latency(HookId id, int64_t ns) {
+  uint32_t bucket = 0;
+  if (ns > 0) {
+    int width = std::bit_width(static_cast<uint64_t>(ns));
+    bucket = width > 7 ? width - 7 : 0;
+    if (bucket >= kTelemetryBuckets) bucket = kTelemetryBuckets - 1;
+  }
+  telemetry_process.load(std::memory_order_relaxed)
+      ->hooks[id]
+      .histogram[bucket]
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Publishes the current call counters of all hooks.
+ */
+void telemetry_publish_calls();
+
+/**
+ * @brief Appends an event to this process's ring.
+ */
+void telemetry_event(TelemetryEventType type, HookId id, uint64_t value);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Per-thread shards
+ * =========================================================================================
+ *
+ * State that every thread updates on the call path (counters, reader
+ * registrations, ...) is split into `kThreadShards` copies, each padded to its
+ * own cache line. A thread always uses the same shard, so up to
+ * `kThreadShards` threads never write the same cache line, and readers sum
+ * or scan all shards when they need the global picture.
+ */
+
+constexpr size_t kCacheLine = 64;
+constexpr uint32_t kThreadShards = 16;
+
+/**
+ * @brief Returns the shard owned by the calling thread.
+ *
+ * Shards are handed out round-robin the first time a thread asks.
+ */
+inline uint32_t thread_shard() {
+  static std::atomic<uint32_t> next_shard{0};
+  thread_local uint32_t shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % kThreadShards;
+  return shard;
+}
@@ -0,0 +1,153 @@
+#include "trace.hpp"
+#include "clock.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+static TraceRecord records[kTraceCapacity];
+static std::atomic<uint64_t> head{0};
+
+// Index of the next record `trace_flush` will look at. Only touched by the
+// flushing thread.
+static uint64_t flushed = 0;
+
+// Log formats, indexed by record ID. Written rarely (once per ID at startup)
+// and only read by the flushing thread, so a mutex is fine here.
+static char formats[kMaxLogFormats][kMaxLogFormat + 1];
+static ForkMutex formats_mutex;
+
+// Appends a record and returns its index + 1.
+static uint64_t append(TraceKind kind, uint32_t tag, uint64_t id,
+                       int64_t a = 0, int64_t b = 0) {
+  uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+  TraceRecord &record = records[index % kTraceCapacity];
+  record.sequence.store(0, std::memory_order_relaxed);
+  // Keeps the field stores below from becoming visible before the reset.
+  std::atomic_thread_fence(std::memory_order_release);
+  record.timestamp_ns.store(monotonic_ns(), std::memory_order_relaxed);
+  record.kind.store(kind, std::memory_order_relaxed);
+  record.tag.store(tag, std::memory_order_relaxed);
+  record.id.store(id != 0 ? id : index + 1, std::memory_order_relaxed);
+  record.args[0].store(a, std::memory_order_relaxed);
+  record.args[1].store(b, std::memory_order_relaxed);
+  record.sequence.store(index + 1, std::memory_order_release);
+  return index + 1;
+}
+
+// A record as read by `copy_record`.
+struct TraceCopy {
+  uint64_t timestamp_ns;
+  uint64_t id;
+  int64_t args[2];
+  uint32_t kind;
+  uint32_t tag;
+};
+
+// Copies the record that carries `sequence`. Fails if the slot holds another
+// record, or was reused while it was being copied.
+static bool copy_record(const TraceRecord &record, uint64_t sequence,
+                        TraceCopy &copy) {
+  if (record.sequence.load(std::memory_order_acquire) != sequence) {
+    return false;
+  }
+  copy.timestamp_ns = record.timestamp_ns.load(std::memory_order_relaxed);
+  copy.id = record.id.load(std::memory_order_relaxed);
+  copy.args[0] = record.args[0].load(std::memory_order_relaxed);
+  copy.args[1] = record.args[1].load(std::memory_order_relaxed);
+  copy.kind = record.kind.load(std::memory_order_relaxed);
+  copy.tag = record.tag.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return record.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+uint64_t trace_span_begin(uint32_t tag) {
+  return append(kTraceSpanBegin, tag, 0);
+}
+
+void trace_span_end(uint64_t id) {
+  if (id == 0) return;
+  // The begin record of span `id` sits at index `id - 1`; copy its tag so the
+  // end record can be reported on its own.
+  TraceCopy begin;
+  bool found = copy_record(records[(id - 1) % kTraceCapacity], id, begin);
+  append(kTraceSpanEnd, found ? begin.tag : 0, id);
+}
+
+void trace_set_format(uint32_t id, const char *format) {
+  if (id >= kMaxLogFormats) return;
+  std::lock_guard lock(formats_mutex);
+  strncpy(formats[id], format, kMaxLogFormat);
+}
+
+void trace_log(uint32_t id, int64_t a, int64_t b) {
+  append(kTraceLog, id, 0, a, b);
+}
+
+static void flush_log(const TraceCopy &record) {
+  uint32_t id = record.tag;
+  const int64_t *args = record.args;
+  char format[kMaxLogFormat + 1] = "";
+  if (id < kMaxLogFormats) {
+    std::lock_guard lock(formats_mutex);
+    memcpy(format, formats[id], sizeof(format));
+  }
+  if (format[0] == '\0') {
+    LOGI("log record %u: %" PRId64 " %" PRId64, id, args[0], args[1]);
+    return;
+  }
+
+  char line[256];
+  size_t out = 0;
+  size_t next_arg = 0;
+  for (const char *p = format; *p != '\0' && out < sizeof(line) - 1; ++p) {
+    if (p[0] == '{' && p[1] == '}' && next_arg < 2) {
+      int n = snprintf(line + out, sizeof(line) - out, "%" PRId64,
+                       args[next_arg++]);
+      if (n > 0) out = std::min(out + n, sizeof(line) - 1);
+      ++p;
+    } else {
+      line[out++] = *p;
+    }
+  }
+  line[out] = '\0';
+  LOGI("%s", line);
+}
+
+void trace_flush() {
+  uint64_t end = head.load(std::memory_order_acquire);
+  if (end - flushed > kTraceCapacity) {
+    LOGW("trace: dropped %llu records",
+         (unsigned long long)(end - flushed - kTraceCapacity));
+    flushed = end - kTraceCapacity;
+  }
+  for (; flushed < end; ++flushed) {
+    const TraceRecord &slot = records[flushed % kTraceCapacity];
+    if (slot.sequence.load(std::memory_order_acquire) != flushed + 1) {
+      // Still being written; pick it up on the next flush.
+      break;
+    }
+    TraceCopy record;
+    // Overwritten by a writer a full ring ahead while we copied it.
+    if (!copy_record(slot, flushed + 1, record)) continue;
+    if (record.kind == kTraceLog) flush_log(record);
+    if (record.kind != kTraceSpanEnd) continue;
+
+    TraceCopy begin;
+    if (!copy_record(records[(record.id - 1) % kTraceCapacity], record.id,
+                     begin)) {
+      continue;
+    }
+    LOGI("span %llu tag %u: %lld ns", (unsigned long long)record.id,
+         record.tag, (long long)(record.timestamp_ns - begin.timestamp_ns));
+  }
+}
+
+void trace_after_fork() {
+  // Also skips records that a thread of the parent was still writing, which
+  // would otherwise stall every flush in the child.
+  flushed = head.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * =========================================================================================
+ *  Native trace buffer
+ * =========================================================================================
+ *
+ * Measuring hooks from Kotlin by building log strings costs more than the
+ * thing being measured. Instead, Kotlin hooks call into this buffer through
+ * `NativeBridge`: `spanBegin` stores a timestamped record and returns its
+ * position as a monotonic span ID, `spanEnd` stores the matching end record.
+ * No strings are built on the call path; the watchdog thread turns new
+ * records into log lines once per window (`trace_flush`).
+ *
+ * The same buffer is the module's log sink: Kotlin registers a format for a
+ * record ID once (`trace_set_format`), then logs with
+ * `NativeBridge.logRecord(id, a, b)`, which stores two primitives instead of
+ * a concatenated string.
+ *
+ * ASCII Art: Ring of `kTraceCapacity` records
+ *
+ *   head (fetch_add) --> [ ... | begin #41 | end #41 | begin #43 | ... ]
+ *                                                              ^
+ *                                          last flushed -------+
+ *
+ * Each record is a small seqlock. The writer clears `sequence`, fences, writes
+ * the fields and stores `sequence` last. A reader checks `sequence` before
+ * and after copying the fields; if either differs from the one it expects,
+ * the slot was overwritten (or is still being written) and it skips it.
+ */
+
+constexpr uint32_t kTraceCapacity = 4096;
+
+enum TraceKind : uint32_t {
+  kTraceSpanBegin = 1,
+  kTraceSpanEnd = 2,
+  kTraceLog = 3,
+};
+
+constexpr uint32_t kMaxLogFormats = 64;
+constexpr size_t kMaxLogFormat = 95;
+
+struct TraceRecord {
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> timestamp_ns;
+  // The span ID for span records.
+  std::atomic<uint64_t> id;
+  // Arguments of log records.
+  std::atomic<int64_t> args[2];
+  std::atomic<uint32_t> kind;
+  std::atomic<uint32_t> tag;
+};
+
+/**
+ * @brief Opens a span with the caller-defined `tag`.
+ * @return The span ID to pass to `trace_span_end`. Never 0.
+ */
+uint64_t trace_span_begin(uint32_t tag);
+
+/**
+ * @brief Closes the span `id`.
+ */
+void trace_span_end(uint64_t id);
+
+/**
+ * @brief Sets the format of log record `id`. Each `{}` in `format` is replaced
+ *        by the next argument when the record is flushed.
+ */
+void trace_set_format(uint32_t id, const char *format);
+
+/**
+ * @brief Appends log record `id` with two arguments. Lock-free.
+ */
+void trace_log(uint32_t id, int64_t a, int64_t b);
+
+/**
+ * @brief Logs the records written since the previous flush. Single caller.
+ */
+void trace_flush();
+
+/**
+ * @brief Starts a forked child with an empty trace: records written before
+ *        the fork are the parent's to flush. See `freeze.hpp`.
+ */
+void trace_after_fork();
@@ -0,0 +1,113 @@
+#include "watchdog.hpp"
+#include "freeze.hpp"
+#include "logging.hpp"
+#include "telemetry.hpp"
+#include "trace.hpp"
+#include <chrono>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+
+static std::atomic<uint64_t> budget_ns{kDefaultConfig.budget_us * 1000ull};
+static std::atomic<uint32_t> window_ms{kWatchdogWindowMs};
+static std::atomic<uint32_t> min_samples{kWatchdogMinSamples};
+
+static std::atomic<HookBudget *> budgets[kHookCount];
+static std::atomic<bool> started{false};
+
+struct WatchdogTask {
+  std::atomic<void (*)()> run{nullptr};
+  uint32_t every;
+};
+
+// Slots are filled in order under `task_mutex`; `run` is published last, so
+// the watchdog thread never sees a half-written task.
+static WatchdogTask tasks[kWatchdogMaxTasks];
+static ForkMutex task_mutex;
+
+struct WindowStart {
+  uint64_t self_ns;
+  uint64_t samples;
+};
+
+static void evaluate(HookBudget &budget, WindowStart &last) {
+  uint64_t self_ns = 0, samples = 0;
+  for (auto &shard : budget.shards) {
+    self_ns += shard.self_ns.load(std::memory_order_relaxed);
+    samples += shard.samples.load(std::memory_order_relaxed);
+  }
+  uint64_t window_self = self_ns - last.self_ns;
+  uint64_t window_samples = samples - last.samples;
+  last = {self_ns, samples};
+
+  if (budget.tripped.load(std::memory_order_relaxed)) return;
+  if (window_samples == 0 ||
+      window_samples < min_samples.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  uint64_t mean = window_self / window_samples;
+  uint64_t limit = budget_ns.load(std::memory_order_relaxed);
+  if (mean <= limit) return;
+
+  budget.tripped.store(true, std::memory_order_relaxed);
+  budget.trip();
+  telemetry_event(kEventHookTripped, budget.id, mean);
+  LOGW("watchdog: %s averaged %llu ns self time over %llu samples "
+       "(budget %llu ns), switched to pass-through",
+       hook_name(budget.id), (unsigned long long)mean,
+       (unsigned long long)window_samples, (unsigned long long)limit);
+}
+
+static void watchdog_loop() {
+  pthread_setname_np(pthread_self(), "hook-watchdog");
+  WindowStart windows[kHookCount]{};
+  for (uint64_t window = 1;; ++window) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(window_ms.load(std::memory_order_relaxed)));
+    for (uint32_t id = 0; id < kHookCount; ++id) {
+      HookBudget *budget = budgets[id].load(std::memory_order_acquire);
+      if (budget != nullptr) evaluate(*budget, windows[id]);
+    }
+    // Once per window is also often enough for the other housekeeping that
+    // must stay off hook call paths.
+    telemetry_publish_calls();
+    trace_flush();
+    for (auto &task : tasks) {
+      auto run = task.run.load(std::memory_order_acquire);
+      if (run == nullptr) break;
+      if (window % task.every == 0) run();
+    }
+  }
+}
+
+void watchdog_configure(uint64_t budget, uint32_t window, uint32_t samples) {
+  budget_ns.store(budget, std::memory_order_relaxed);
+  window_ms.store(window, std::memory_order_relaxed);
+  min_samples.store(samples, std::memory_order_relaxed);
+}
+
+void watchdog_register(HookBudget &budget) {
+  budgets[budget.id].store(&budget, std::memory_order_release);
+}
+
+bool watchdog_add_task(void (*task)(), uint32_t every_windows) {
+  std::lock_guard lock(task_mutex);
+  for (auto &slot : tasks) {
+    if (slot.run.load(std::memory_order_relaxed) != nullptr) continue;
+    slot.every = every_windows > 0 ? every_windows : 1;
+    slot.run.store(task, std::memory_order_release);
+    return true;
+  }
+  LOGE("watchdog: more than %zu tasks", kWatchdogMaxTasks);
+  return false;
+}
+
+void watchdog_start() {
+  if (started.exchange(true)) return;
+  std::thread(watchdog_loop).detach();
+}
+
+void watchdog_after_fork() {
+  started.store(false, std::memory_order_relaxed);
+}
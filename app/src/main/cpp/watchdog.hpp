@@ -0,0 +1,176 @@
+#pragma once
+
+#include "clock.hpp"
+#include "config.hpp"
+#include "hook_stats.hpp"
+#include "hook_thread.hpp"
+#include "telemetry.hpp"
+#include "thread_shard.hpp"
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Watchdog: a circuit breaker for slow hooks
+ * =========================================================================================
+ *
+ * A replacement that does too much work (say, a pathological rule set) slows
+ * down every call of the hooked function in the whole process. The watchdog
+ * measures each hook's *self* overhead, the time spent in the replacement
+ * minus the time spent in the original function, and when the mean over a
+ * window exceeds the configured budget it trips the hook's breaker: the
+ * hook's handler slot is switched to pass-through and the event is logged.
+ *
+ * ASCII Art: What is measured
+ *
+ *   fake_fopen()  |<------------------ sampled call ------------------>|
+ *                 |  policy  |<--- call_backup(backup_fopen) --->| ...  |
+ *                 |          |        (subtracted)               |      |
+ *                 self = total - backup
+ *
+ * The call path only ever touches thread-local state (see `hook_thread.hpp`)
+ * and the calling thread's shard of the hook's budget; one call in
+ * `ModuleConfig::sample_every` is timed. The watchdog thread aggregates the
+ * shards once per window and does the swap, which never waits for calls
+ * still inside the old handler (see `handler_slot.hpp`).
+ *
+ * A tripped breaker is never reset: the hook keeps passing through for the
+ * life of the process, and children forked afterwards inherit that. The
+ * rules that made it slow are still in place, so switching it back would
+ * only trip it again; restarting the app starts with closed breakers.
+ */
+
+constexpr uint32_t kWatchdogWindowMs = 1000;
+constexpr uint32_t kWatchdogMinSamples = 16;
+constexpr size_t kWatchdogMaxTasks = 16;
+
+struct alignas(kCacheLine) BudgetShard {
+  std::atomic<uint64_t> self_ns;
+  std::atomic<uint64_t> samples;
+};
+
+struct HookBudget {
+  HookId id;
+  // Switches the hook to pass-through. Runs on the watchdog thread.
+  void (*trip)();
+  std::atomic<bool> tripped{false};
+  BudgetShard shards[kThreadShards]{};
+};
+
+/**
+ * @brief Mean self time of the timed calls of `budget` so far, in ns.
+ */
+inline uint64_t budget_mean_self_ns(const HookBudget &budget) {
+  uint64_t self_ns = 0, samples = 0;
+  for (auto &shard : budget.shards) {
+    self_ns += shard.self_ns.load(std::memory_order_relaxed);
+    samples += shard.samples.load(std::memory_order_relaxed);
+  }
+  return samples > 0 ? self_ns / samples : 0;
+}
+
+// Books a timed call that started at `start_ns`. Part of `budget_track`.
+inline void budget_record(HookThreadState &state, HookBudget &budget,
+                          int64_t start_ns) {
+  int64_t self = monotonic_ns() - start_ns - state.backup_ns;
+  state.sampling = false;
+  telemetry_record_latency(budget.id, self);
+  BudgetShard &shard = budget.shards[thread_shard()];
+  shard.self_ns.fetch_add(self > 0 ? self : 0, std::memory_order_relaxed);
+  shard.samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Runs `slot(args...)`, timing one call in
+ *        `ModuleConfig::sample_every` against `budget`.
+ *
+ * The configuration snapshot is only read when a call is timed, to reload
+ * the thread's countdown.
+ *
+ * @param state The calling thread's `hook_thread_state()`.
+ */
+template <typename Slot, typename... Args>
+auto budget_track(HookThreadState &state, HookBudget &budget, Slot &slot,
+                  Args... args) {
+  if (--state.countdown > 0 || state.sampling ||
+      budget.tripped.load(std::memory_order_relaxed)) {
+    return slot(args...);
+  }
+  state.countdown = static_cast<int32_t>(config_read().sample_every);
+  state.sampling = true;
+  state.backup_ns = 0;
+  int64_t start = monotonic_ns();
+  if constexpr (std::is_void_v<decltype(slot(args...))>) {
+    slot(args...);
+    budget_record(state, budget, start);
+  } else {
+    auto result = slot(args...);
+    budget_record(state, budget, start);
+    return result;
+  }
+}
+
+/**
+ * @brief Calls a backup function, excluding its time from the self overhead
+ *        of a sampled call.
+ *
+ * Hooks reached from inside the backup are not timed on their own (the
+ * call in progress is), and what they book is replaced by the backup's
+ * total time.
+ */
+template <typename R, typename... Params, typename... Args>
+R call_backup(R (*backup)(Params...), Args... args) {
+  HookThreadState &state = hook_thread_state();
+  if (!state.sampling) return backup(args...);
+  int64_t booked = state.backup_ns;
+  int64_t start = monotonic_ns();
+  if constexpr (std::is_void_v<R>) {
+    backup(args...);
+    state.backup_ns = booked + (monotonic_ns() - start);
+  } else {
+    R result = backup(args...);
+    state.backup_ns = booked + (monotonic_ns() - start);
+    return result;
+  }
+}
+
+/**
+ * @brief Watchdog tuning. All values can be changed at runtime.
+ *
+ * @param budget_ns Maximum mean self overhead per call.
+ * @param window_ms Length of an evaluation window.
+ * @param min_samples Windows with fewer timed calls are not judged.
+ */
+void watchdog_configure(uint64_t budget_ns, uint32_t window_ms,
+                        uint32_t min_samples);
+
+/**
+ * @brief Puts `budget` under the watchdog's supervision.
+ */
+void watchdog_register(HookBudget &budget);
+
+/**
+ * @brief Runs `task` on the watchdog thread every `every_windows` windows.
+ *
+ * For periodic reports and other housekeeping that must stay off hook call
+ * paths. At most `kWatchdogMaxTasks` tasks; tasks cannot be removed.
+ *
+ * @return `false` if the task table is full.
+ */
+bool watchdog_add_task(void (*task)(), uint32_t every_windows);
+
+/**
+ * @brief Starts the watchdog thread. Safe to call more than once.
+ *
+ * Budgets and tasks registered later are picked up, but a window may pass
+ * before they are; register everything first.
+ */
+void watchdog_start();
+
+/**
+ * @brief Marks the watchdog thread as gone, so that the next
+ *        `watchdog_start` starts a new one. Runs in a forked child, see
+ *        `freeze.hpp`.
+ */
+void watchdog_after_fork();
@@ -65,6 +65,8 @@ class MainActivity : Activity() {
                 binding.frameworkVersion.text = "Framework version " + service.frameworkVersion
                 binding.frameworkVersionCode.text = "Framework version code " + service.frameworkVersionCode
                 binding.scope.text = "Scope: " + service.scope
+                // The store stays mapped for the life of the process.
+                val settingsOpen = openSettingsStore(service)
 
                 binding.requestScope.setOnClickListener {
                     service.requestScope("com.android.settings", mCallback)
@@ -75,6 +77,8 @@ class MainActivity : Activity() {
                     val new = Random.nextInt()
                     Toast.makeText(this@MainActivity, "$old -> $new", Toast.LENGTH_SHORT).show()
                     prefs.edit().putInt("test", new).apply()
+                    // Mirror the value into the native store that hook code reads.
+                    if (settingsOpen) NativeBridge.kvPutLong("test", new.toLong())
                 }
                 binding.remoteFile.setOnClickListener {
                     service.openRemoteFile("test.txt").use { pfd ->
@@ -83,6 +87,12 @@ class MainActivity : Activity() {
                         }
                     }
                 }
+                binding.telemetry.setOnClickListener {
+                    val reader = service.openRemoteFile(TelemetryReader.FILE_NAME).use {
+                        TelemetryReader(it)
+                    }
+                    Toast.makeText(this@MainActivity, reader.summary(), Toast.LENGTH_LONG).show()
+                }
             }
 
             override fun onServiceDied(service: XposedService) {
@@ -96,4 +106,11 @@ class MainActivity : Activity() {
             }
         }, 5000)
     }
+
+    private fun openSettingsStore(service: XposedService): Boolean {
+        NativeBridge.load()
+        return service.openRemoteFile(NativeBridge.SETTINGS_FILE).use {
+            NativeBridge.kvOpen(it.fd, true)
+        }
+    }
 }
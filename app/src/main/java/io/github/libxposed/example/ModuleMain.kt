@@ -12,9 +12,9 @@ import io.github.libxposed.api.XposedModuleInterface.PackageLoadedParam
 import io.github.libxposed.api.annotations.AfterInvocation
 import io.github.libxposed.api.annotations.BeforeInvocation
 import io.github.libxposed.api.annotations.XposedHooker
+import java.io.File
 import java.io.FileNotFoundException
 import java.io.FileReader
-import kotlin.random.Random
 
 private lateinit var module: ModuleMain
 
@@ -26,22 +26,27 @@ class ModuleMain(base: XposedInterface, param: ModuleLoadedParam) : XposedModule
     }
 
     @XposedHooker
-    class MyHooker(private val magic: Int) : XposedInterface.Hooker {
+    class MyHooker(private val span: Long) : XposedInterface.Hooker {
         companion object {
             @JvmStatic
             @BeforeInvocation
             fun beforeInvocation(callback: BeforeHookCallback): MyHooker {
-                val key = Random.nextInt()
-                val appContext = callback.args[0]
-                module.log("beforeInvocation: key = $key")
-                module.log("app context: $appContext")
-                return MyHooker(key)
+                if (NativeBridge.isLoaded) {
+                    // Timestamped natively; no strings are built per call.
+                    return MyHooker(NativeBridge.spanBegin(NativeBridge.TRACE_TAG_APP_ATTACH))
+                }
+                module.log("beforeInvocation: app context: ${callback.args[0]}")
+                return MyHooker(0)
             }
 
             @JvmStatic
             @AfterInvocation
             fun afterInvocation(callback: AfterHookCallback, context: MyHooker) {
-                module.log("afterInvocation: key = ${context.magic}")
+                if (context.span != 0L) {
+                    NativeBridge.spanEnd(context.span)
+                } else {
+                    module.log("afterInvocation")
+                }
             }
         }
     }
@@ -50,28 +55,51 @@ class ModuleMain(base: XposedInterface, param: ModuleLoadedParam) : XposedModule
     override fun onPackageLoaded(param: PackageLoadedParam) {
         super.onPackageLoaded(param)
         log("onPackageLoaded: " + param.packageName)
-        log("param classloader is " + param.classLoader)
-        log("module apk path: " + this.applicationInfo.sourceDir)
-        log("----------")
+        if (NativeBridge.isLoaded) {
+            // The details as two primitives into the native log sink instead of concatenated strings.
+            val first = if (param.isFirstPackage) 1L else 0L
+            NativeBridge.logRecord(NativeBridge.LOG_PACKAGE_LOADED, param.applicationInfo.uid.toLong(), first)
+        } else {
+            log("param classloader is " + param.classLoader)
+            log("module apk path: " + this.applicationInfo.sourceDir)
+            log("----------")
+        }
 
         if (param.packageName == "com.android.settings") {
-            System.loadLibrary("native")
+            NativeBridge.load()
+            mapTelemetry()
+            mapSettings()
+            mapBlockList()
         }
 
         if (!param.isFirstPackage) return
 
         val prefs = getRemotePreferences("test")
         log("remote prefs: " + prefs.getInt("test", -1))
+        if (NativeBridge.isLoaded) {
+            NativeBridge.pushConfig(prefs)
+            val profile = File(param.applicationInfo.dataDir, "cache/" + NativeBridge.CLASS_PROFILE_FILE)
+            val preloading = NativeBridge.classProfileStart(profile.path, param.classLoader)
+            if (preloading > 0) log("preloading $preloading classes")
+        }
         prefs.registerOnSharedPreferenceChangeListener { _, key ->
             val value = prefs.getInt(key, 0)
             log("onSharedPreferenceChanged: $key->$value")
+            if (NativeBridge.isLoaded) NativeBridge.pushConfig(prefs)
         }
 
         try {
-            val text = openRemoteFile("test.txt").use {
-                FileReader(it.fileDescriptor).readText()
+            openRemoteFile("test.txt").use {
+                if (NativeBridge.isLoaded) {
+                    // Load it natively instead of copying it through a Java string.
+                    val size = NativeBridge.mapRemoteFile("test.txt", it.fd)
+                    log("remote file mapped: $size bytes")
+                    log("remote file content: " + NativeBridge.remoteFileText("test.txt"))
+                } else {
+                    val text = FileReader(it.fileDescriptor).readText()
+                    log("remote file content: $text")
+                }
             }
-            log("remote file content: $text")
         } catch (e: FileNotFoundException) {
             log("remote file not found")
         }
@@ -79,4 +107,38 @@ class ModuleMain(base: XposedInterface, param: ModuleLoadedParam) : XposedModule
         val exampleMethod = Application::class.java.getDeclaredMethod("attach", Context::class.java)
         hook(exampleMethod, MyHooker::class.java)
     }
+
+    private fun mapSettings() {
+        try {
+            openRemoteFile(NativeBridge.SETTINGS_FILE).use {
+                if (NativeBridge.kvOpen(it.fd, false)) {
+                    log("settings mapped, test = " + NativeBridge.kvGetLong("test", -1))
+                }
+            }
+        } catch (e: FileNotFoundException) {
+            log("settings file not found")
+        }
+    }
+
+    private fun mapBlockList() {
+        try {
+            openRemoteFile(NativeBridge.BLOCK_LIST_FILE).use {
+                val size = NativeBridge.mapRemoteFile(NativeBridge.BLOCK_LIST_FILE, it.fd)
+                log("fopen block list mapped: $size bytes")
+            }
+        } catch (e: FileNotFoundException) {
+            log("fopen block list not found")
+        }
+    }
+
+    private fun mapTelemetry() {
+        try {
+            // The mapping outlives the descriptor, so it can be closed right away.
+            openRemoteFile(TelemetryReader.FILE_NAME).use {
+                log("telemetry mapped: " + NativeBridge.mapTelemetry(it.fd))
+            }
+        } catch (e: FileNotFoundException) {
+            log("telemetry file not found")
+        }
+    }
 }
@@ -0,0 +1,272 @@
+package io.github.libxposed.example
+
+import android.content.SharedPreferences
+import dalvik.annotation.optimization.CriticalNative
+import dalvik.annotation.optimization.FastNative
+
+/**
+ * Kotlin side of `libnative.so`. The native implementations live in
+ * `bridge.cpp` and are bound from `JNI_OnLoad` with `RegisterNatives`;
+ * nothing here may be called before [load].
+ *
+ * Hot calls with primitive arguments are [CriticalNative], short calls that
+ * take strings and never block are [FastNative]; see `bridge.cpp` before
+ * changing either.
+ */
+object NativeBridge {
+
+    /** Span tag of `Application.attach`, see [spanBegin]. */
+    const val TRACE_TAG_APP_ATTACH = 1
+
+    /** Record ID of the per-package log line, see [logRecord]. */
+    const val LOG_PACKAGE_LOADED = 1
+
+    /** Bit of the `features` preference enabling the JNI profiler, see `jni_profiler.hpp`. */
+    const val FEATURE_JNI_PROFILER = 1 shl 0
+
+    /**
+     * Bit of the `features` preference enabling the JNI member ID cache,
+     * see `jni_id_cache.hpp`.
+     */
+    const val FEATURE_JNI_ID_CACHE = 1 shl 1
+
+    /**
+     * Bit of the `features` preference enabling the `NewStringUTF` transcoder,
+     * see `jni_strings.hpp`.
+     */
+    const val FEATURE_JNI_STRINGS = 1 shl 2
+
+    /**
+     * Bit of the `features` preference enabling global reference accounting,
+     * see `global_refs.hpp`.
+     */
+    const val FEATURE_GLOBAL_REFS = 1 shl 3
+
+    /**
+     * Bit of the `features` preference enabling hot-class recording and
+     * preloading, see `class_profile.hpp`.
+     */
+    const val FEATURE_CLASS_PROFILE = 1 shl 4
+
+    /**
+     * Bit of the `features` preference enabling the `dlsym` result cache,
+     * see `dlsym_cache.hpp`.
+     */
+    const val FEATURE_DLSYM_CACHE = 1 shl 5
+
+    /**
+     * Bit of the `features` preference enabling the filesystem metadata cache,
+     * see `fs_cache.hpp` and [configureFsCache].
+     */
+    const val FEATURE_FS_CACHE = 1 shl 6
+
+    /**
+     * Bit of the `features` preference enabling the system property cache,
+     * see `property_cache.hpp` and [configurePropertyCache].
+     */
+    const val FEATURE_PROPERTY_CACHE = 1 shl 7
+
+    /**
+     * Bit of the `features` preference enabling per-path stdio buffering and
+     * readahead advice in `fopen`, see `stdio_policy.hpp` and
+     * [configureStdioPolicy].
+     */
+    const val FEATURE_STDIO_POLICY = 1 shl 8
+
+    /**
+     * Bit of the `features` preference serving whitelisted read-only `fopen`s
+     * from a memory mapping, see `mmap_stream.hpp` and [configureMmapStreams].
+     */
+    const val FEATURE_MMAP_STREAMS = 1 shl 9
+
+    /**
+     * Bit of the `features` preference enabling per-path `fsync` policies,
+     * see `fsync_policy.hpp` and [configureFsyncPolicy].
+     */
+    const val FEATURE_FSYNC_POLICY = 1 shl 10
+
+    /** Remote file backing the native settings store, see `kv_store.hpp`. */
+    const val SETTINGS_FILE = "settings.kv"
+
+    /** Boolean setting: `fopen` refuses "banned" paths while true (the default). */
+    const val SETTING_BLOCK_BANNED = "fopen_block_banned"
+
+    /** Remote file listing path fragments that `fopen` refuses, one per line. */
+    const val BLOCK_LIST_FILE = "fopen_blocklist.txt"
+
+    /** Hot-class profile in the target app's cache directory, see [classProfileStart]. */
+    const val CLASS_PROFILE_FILE = "native_class_profile.txt"
+
+    var isLoaded = false
+        private set
+
+    fun load() {
+        if (isLoaded) return
+        System.loadLibrary("native")
+        isLoaded = true
+        registerLogFormat(LOG_PACKAGE_LOADED, "package loaded: uid {}, first package {}")
+    }
+
+    /** Maps the telemetry file behind [fd], see `telemetry.hpp`. */
+    @JvmStatic
+    external fun mapTelemetry(fd: Int): Boolean
+
+    /** Publishes a new native configuration snapshot, see `config.hpp`. */
+    @JvmStatic
+    external fun pushConfig(
+        rulesVersion: Int,
+        enabledHooks: Int,
+        sampleEvery: Int,
+        budgetUs: Int,
+        features: Int,
+    )
+
+    /**
+     * Maps the settings store behind [fd]. The companion app maps it [writable];
+     * the module maps it read-only and reads it from hook code.
+     */
+    @JvmStatic
+    external fun kvOpen(fd: Int, writable: Boolean): Boolean
+
+    @JvmStatic
+    @FastNative
+    external fun kvGetLong(key: String, fallback: Long): Long
+
+    @JvmStatic
+    @FastNative
+    external fun kvGetBoolean(key: String, fallback: Boolean): Boolean
+
+    @JvmStatic
+    @FastNative
+    external fun kvGetDouble(key: String, fallback: Double): Double
+
+    /**
+     * Writes wait for the store's lock, so unlike the reads they are regular
+     * natives: a [FastNative] call that blocks holds up garbage collection.
+     */
+    @JvmStatic
+    external fun kvPutLong(key: String, value: Long): Boolean
+
+    @JvmStatic
+    external fun kvPutBoolean(key: String, value: Boolean): Boolean
+
+    @JvmStatic
+    external fun kvPutDouble(key: String, value: Double): Boolean
+
+    @JvmStatic
+    external fun kvRemove(key: String): Boolean
+
+    /**
+     * Copies the remote file behind [fd] into native memory and registers it
+     * as [name] for hook code, see `remote_file.hpp`.
+     *
+     * @return The size of the file, or -1 on failure.
+     */
+    @JvmStatic
+    external fun mapRemoteFile(name: String, fd: Int): Long
+
+    /** The contents registered as [name] by [mapRemoteFile], empty if none. */
+    @JvmStatic
+    external fun remoteFileText(name: String): String
+
+    /**
+     * Opens a span in the native trace buffer, see `trace.hpp`.
+     *
+     * @return The span ID to pass to [spanEnd].
+     */
+    @JvmStatic
+    @CriticalNative
+    external fun spanBegin(tag: Int): Long
+
+    @JvmStatic
+    @CriticalNative
+    external fun spanEnd(id: Long)
+
+    /**
+     * Appends log record [id] with two arguments to the native trace buffer.
+     * Nothing is formatted on the calling thread, see `trace.hpp`.
+     */
+    @JvmStatic
+    @CriticalNative
+    external fun logRecord(id: Int, a: Long, b: Long)
+
+    /**
+     * Loads the class profile at [path], keeps recording into it and preloads
+     * its hottest classes through [loader] on a background thread. Does
+     * nothing unless [FEATURE_CLASS_PROFILE] is set; see `class_profile.hpp`.
+     *
+     * @return The number of classes scheduled for preloading.
+     */
+    @JvmStatic
+    external fun classProfileStart(path: String, loader: ClassLoader): Int
+
+    /**
+     * Sets the path prefixes (one per line) whose `stat`/`access`/`opendir`
+     * outcomes may be cached, and for how long. Drops every cached entry.
+     */
+    @JvmStatic
+    external fun configureFsCache(prefixes: String, ttlMs: Int)
+
+    /** Sets the system properties (one per line) whose values may be cached. */
+    @JvmStatic
+    external fun configurePropertyCache(names: String)
+
+    /**
+     * Sets the `fopen` tuning rules, one `<prefix> <buffer KiB> <advice>` per
+     * line, where the advice is `normal`, `sequential`, `random` or `noreuse`.
+     */
+    @JvmStatic
+    external fun configureStdioPolicy(rules: String)
+
+    /**
+     * Sets the path prefixes (one per line) whose files `fopen` may map, and
+     * the size in KiB below which files are read normally.
+     */
+    @JvmStatic
+    external fun configureMmapStreams(prefixes: String, minKib: Int)
+
+    /**
+     * Sets the `fsync` rules, one `<prefix> <mode> <window ms>` per line,
+     * where the mode is `passthrough`, `coalesce` or `group`. Coalescing
+     * gives up durability until the window has passed, so its rules must end
+     * in `unsafe`.
+     */
+    @JvmStatic
+    external fun configureFsyncPolicy(rules: String)
+
+    /** Sets the format of record [id]; each `{}` is replaced by an argument. */
+    @JvmStatic
+    external fun registerLogFormat(id: Int, format: String)
+
+    /** Calls of hook [id] (a `HookId`) so far in this process, or -1. */
+    @JvmStatic
+    @CriticalNative
+    external fun hookCalls(id: Int): Long
+
+    /** Rules version of the current native configuration snapshot. */
+    @JvmStatic
+    @CriticalNative
+    external fun configRulesVersion(): Int
+
+    /** Pushes the native configuration stored in [prefs]. */
+    fun pushConfig(prefs: SharedPreferences) {
+        pushConfig(
+            prefs.getInt("rules_version", 0),
+            prefs.getInt("enabled_hooks", -1),
+            prefs.getInt("sample_every", 64),
+            prefs.getInt("budget_us", 50),
+            prefs.getInt("features", 0),
+        )
+        configureFsCache(
+            prefs.getString("fs_cache_prefixes", null) ?: "",
+            prefs.getInt("fs_cache_ttl_ms", 500),
+        )
+        configurePropertyCache(prefs.getString("property_cache_names", null) ?: "")
+        configureStdioPolicy(prefs.getString("stdio_rules", null) ?: "")
+        configureMmapStreams(
+            prefs.getString("mmap_stream_prefixes", null) ?: "",
+            prefs.getInt("mmap_stream_min_kib", 256),
+        )
+        configureFsyncPolicy(prefs.getString("fsync_rules", null) ?: "")
+    }
+}
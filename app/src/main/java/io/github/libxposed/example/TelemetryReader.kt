@@ -0,0 +1,130 @@
+package io.github.libxposed.example
+
+import android.os.ParcelFileDescriptor
+import android.system.Os
+import java.io.FileInputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
+
+/**
+ * Reads the live hook statistics that the native module publishes into
+ * [FILE_NAME]. The layout is defined in `telemetry.hpp`; the offsets below
+ * must be kept in sync with it.
+ *
+ * Every process of the target app that loaded the module writes its own
+ * process slot; [calls] and [histogram] add them up, [events] merges them.
+ *
+ * The file is mapped, so every read sees the current values without any IPC.
+ */
+class TelemetryReader(pfd: ParcelFileDescriptor) {
+
+    data class Event(val pid: Int, val timestampNs: Long, val type: Int, val hook: Int, val value: Long)
+
+    private val buffer: ByteBuffer
+
+    init {
+        // The module side may not be allowed to grow the file, so the app
+        // creates it at its full size before the module maps it.
+        if (Os.fstat(pfd.fileDescriptor).st_size < SIZE) {
+            Os.ftruncate(pfd.fileDescriptor, SIZE.toLong())
+        }
+        buffer = FileInputStream(pfd.fileDescriptor).channel
+            .map(FileChannel.MapMode.READ_ONLY, 0, SIZE.toLong())
+            .order(ByteOrder.LITTLE_ENDIAN)
+    }
+
+    val isValid: Boolean
+        get() = buffer.getInt(0) == MAGIC && buffer.getInt(4) == VERSION
+
+    /** Offsets of the slots that a process has claimed. */
+    private fun slots(): List<Int> = (0 until PROCESSES)
+        .map { PROCESSES_OFFSET + it * PROCESS_STRIDE }
+        .filter { buffer.getInt(it) != 0 }
+
+    /** Pids of the processes that publish (or last published) statistics. */
+    fun pids(): List<Int> = slots().map { buffer.getInt(it) }
+
+    fun calls(hook: Int): Long = slots().sumOf {
+        buffer.getLong(it + HOOKS_OFFSET + hook * HOOK_STRIDE)
+    }
+
+    fun histogram(hook: Int): LongArray = LongArray(BUCKETS) { bucket ->
+        slots().sumOf {
+            buffer.getLong(it + HOOKS_OFFSET + hook * HOOK_STRIDE + 8 + bucket * 8)
+        }
+    }
+
+    /** The most recent events of every process, oldest first. */
+    fun events(): List<Event> = slots().flatMap { slot ->
+        val pid = buffer.getInt(slot)
+        val head = buffer.getLong(slot + EVENT_HEAD_OFFSET)
+        val first = maxOf(0L, head - EVENTS)
+        (first until head).mapNotNull { index ->
+            val offset = slot + EVENTS_OFFSET + (index % EVENTS).toInt() * EVENT_STRIDE
+            // A slot that is being overwritten carries another sequence,
+            // before or after the fields are read.
+            if (buffer.getLong(offset) != index + 1) return@mapNotNull null
+            val event = Event(
+                pid = pid,
+                timestampNs = buffer.getLong(offset + 8),
+                type = buffer.getInt(offset + 16),
+                hook = buffer.getInt(offset + 20),
+                value = buffer.getLong(offset + 24),
+            )
+            if (buffer.getLong(offset) != index + 1) return@mapNotNull null
+            event
+        }
+    }.sortedBy { it.timestampNs }
+
+    fun summary(): String {
+        if (!isValid) return "No telemetry yet"
+        val calls = HOOK_NAMES.indices.joinToString { "${HOOK_NAMES[it]}: ${calls(it)}" }
+        return "pids: ${pids().joinToString()}; $calls, events: ${events().size}"
+    }
+
+    companion object {
+        const val FILE_NAME = "telemetry.bin"
+
+        private const val MAGIC = 0x4d4c4554
+        private const val VERSION = 3
+        private const val SIZE = 65536
+        private const val PROCESSES_OFFSET = 64
+        private const val PROCESS_STRIDE = 6416
+        private const val PROCESSES = 8
+        private const val EVENT_HEAD_OFFSET = 8
+        private const val HOOKS_OFFSET = 16
+        private const val HOOK_STRIDE = 136
+        private const val BUCKETS = 16
+        private const val EVENTS_OFFSET = 4368
+        private const val EVENT_STRIDE = 32
+        private const val EVENTS = 64L
+
+        /** Indexed by `HookId` in `hook_stats.hpp`. */
+        val HOOK_NAMES = arrayOf(
+            "target_fun",
+            "fopen",
+            "FindClass",
+            "GetMethodID",
+            "GetStaticMethodID",
+            "GetFieldID",
+            "GetStaticFieldID",
+            "NewStringUTF",
+            "NewGlobalRef",
+            "DeleteGlobalRef",
+            "NewWeakGlobalRef",
+            "DeleteWeakGlobalRef",
+            "dlsym",
+            "dlclose",
+            "stat",
+            "access",
+            "faccessat",
+            "opendir",
+            "rename",
+            "unlink",
+            "__system_property_get",
+            "fsync",
+            "fdatasync",
+        )
+    }
+}
@@ -0,0 +1,159 @@
+#include "class_profile.hpp"
+#include "config.hpp"
+#include "host_support.hpp"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Startup class lookups on the main thread before and after preloading,
+ * against a mock VM.
+ *
+ * The host JNI table gets a class linker of its own: the first lookup of a
+ * class, by `FindClass` or by `ClassLoader.loadClass` (the preload thread's
+ * `CallObjectMethodA`), spins for `kLoadNs` under one lock, later lookups
+ * are free. The "app" looks up `kClasses` classes through the hooked
+ * `FindClass`, after a gap in which its main thread waits for something
+ * else (inflating its first screen, say):
+ *
+ *   cold       the profile is still empty; this run records and saves it
+ *   preload    the profile is loaded and preloading starts when the gap
+ *              does, as `classProfileStart` from `onPackageLoaded` would
+ *   no gap     preloading starts right before the lookups, so the two
+ *              threads race for the classes
+ *
+ * For each run the benchmark prints the time the main thread spent in the
+ * lookups, the whole startup (gap plus lookups) and how many classes the
+ * main thread had to load itself. The machine the numbers come from decides
+ * how much of the preload overlaps with the gap; with a single CPU it only
+ * does while the main thread sleeps.
+ */
+
+constexpr int kClasses = 200;
+constexpr int64_t kLoadNs = 50'000;
+constexpr int kGapMs = 20;
+
+static std::mutex linker_mutex;
+static std::unordered_set<std::string> loaded;
+static std::thread::id main_thread;
+static std::atomic<int> main_loads{0};
+static std::atomic<int> preloaded{0};
+static _jclass host_class;
+static _jobject host_loader;
+
+static void spin(int64_t ns) {
+  int64_t start = host_now_ns();
+  while (host_now_ns() - start < ns) {
+  }
+}
+
+static jclass link(const std::string &name) {
+  std::lock_guard lock(linker_mutex);
+  if (loaded.insert(name).second) {
+    spin(kLoadNs);
+    if (std::this_thread::get_id() == main_thread) main_loads.fetch_add(1);
+  }
+  return &host_class;
+}
+
+static jclass find_class(JNIEnv *, const char *name) { return link(name); }
+
+// `ClassLoader.loadClass(String)`: the name with dots.
+static jobject load_class(JNIEnv *env, jobject, jmethodID,
+                          const jvalue *args) {
+  auto string = static_cast<jstring>(args[0].l);
+  std::vector<jchar> units(env->GetStringLength(string));
+  env->GetStringRegion(string, 0, units.size(), units.data());
+  std::string name(units.begin(), units.end());
+  for (char &c : name) c = c == '.' ? '/' : c;
+  link(name);
+  preloaded.fetch_add(1);
+  return &host_class;
+}
+
+static jstring new_string_utf(JNIEnv *, const char *bytes) {
+  return host_jstring(bytes);
+}
+
+static jmethodID get_method_id(JNIEnv *, jclass, const char *, const char *) {
+  static int method;
+  return reinterpret_cast<jmethodID>(&method);
+}
+
+static jint get_java_vm(JNIEnv *, JavaVM **vm) {
+  *vm = host_java_vm();
+  return JNI_OK;
+}
+
+static std::vector<std::string> names;
+
+enum Run { kCold, kPreload, kNoGap };
+
+static void startup(Run run, const char *path) {
+  {
+    std::lock_guard lock(linker_mutex);
+    loaded.clear();
+  }
+  main_loads.store(0);
+  preloaded.store(0);
+  JNIEnv *env = host_jni_env();
+  uint32_t scheduled = 0;
+  int64_t start = host_now_ns();
+  if (run != kNoGap) scheduled = class_profile_start(env, path, &host_loader);
+  if (run != kNoGap) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kGapMs));
+  }
+  if (run == kNoGap) scheduled = class_profile_start(env, path, &host_loader);
+  int64_t lookups_start = host_now_ns();
+  for (const std::string &name : names) {
+    CHECK(mock_call(host_jni_functions()->FindClass, env, name.c_str()) !=
+          nullptr);
+  }
+  int64_t end = host_now_ns();
+  if (run == kCold) class_profile_save();
+  CHECK(scheduled == (run == kCold ? 0 : kClasses));
+  // Let the preload thread finish before the next run clears the linker.
+  while (preloaded.load() < static_cast<int>(scheduled)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const char *run_names[] = {"cold", "preload", "no gap"};
+  printf("%8s %12.2f %12.2f %10d\n", run_names[run],
+         (end - lookups_start) / 1e6,
+         (end - start) / 1e6, main_loads.load());
+}
+
+int main() {
+  JNINativeInterface *functions = host_jni_functions();
+  functions->FindClass = find_class;
+  functions->CallObjectMethodA = load_class;
+  functions->NewStringUTF = new_string_utf;
+  functions->GetMethodID = get_method_id;
+  functions->GetJavaVM = get_java_vm;
+  host_load_module();
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureClassProfile;
+  config_publish(config);
+  main_thread = std::this_thread::get_id();
+
+  char path[] = "/tmp/bench_class_preload_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  for (int i = 0; i < kClasses; ++i) {
+    names.push_back("com/example/app/Startup" + std::to_string(i));
+  }
+
+  printf("%8s %12s %12s %10s\n", "run", "lookups_ms", "startup_ms",
+         "main_loads");
+  startup(kCold, path);
+  startup(kPreload, path);
+  startup(kNoGap, path);
+  unlink(path);
+  return 0;
+}
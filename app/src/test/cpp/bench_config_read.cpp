@@ -0,0 +1,122 @@
+#include "config.hpp"
+#include "host_support.hpp"
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * What `config_read` costs the hooks while the app publishes changes, next
+ * to the same snapshot behind a mutex.
+ *
+ * 1 to 4 reader threads each read `kReads` snapshots while one writer
+ * publishes a new one
+ *
+ *   none      never
+ *   1 ms      every millisecond, far more often than preferences change
+ *   busy      back to back
+ *
+ * Every snapshot published has `rules_version == budget_us`, and readers
+ * check that they never see a mix. Times are the readers' mean CPU time per
+ * read in ns (thread CPU time, so a reader waiting for the CPU on a machine
+ * with fewer cores than threads is not charged for it), followed by the
+ * number of snapshots published meanwhile.
+ */
+
+constexpr int kReaderCounts[] = {1, 2, 4};
+constexpr int kReads = 2000000;
+
+enum Writer { kNone, kMillisecond, kBusy };
+
+struct Source {
+  ModuleConfig (*read)();
+  void (*publish)(const ModuleConfig &config);
+};
+
+static std::mutex locked_mutex;
+static ModuleConfig locked_config = kDefaultConfig;
+
+static ModuleConfig locked_read() {
+  std::lock_guard lock(locked_mutex);
+  return locked_config;
+}
+
+static void locked_publish(const ModuleConfig &config) {
+  std::lock_guard lock(locked_mutex);
+  locked_config = config;
+}
+
+constexpr Source kSeqlock{config_read, config_publish};
+constexpr Source kMutex{locked_read, locked_publish};
+
+static int64_t thread_cpu_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+struct Result {
+  double ns_per_read;
+  uint64_t publishes;
+};
+
+static Result run(const Source &source, int readers, Writer writer) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> publishes{0};
+  std::thread publisher([&] {
+    ModuleConfig config = kDefaultConfig;
+    while (writer != kNone && !stop.load(std::memory_order_relaxed)) {
+      config.rules_version++;
+      config.budget_us = config.rules_version;
+      source.publish(config);
+      publishes.fetch_add(1, std::memory_order_relaxed);
+      if (writer == kMillisecond) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  });
+
+  std::vector<int64_t> cpu_ns(readers);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < readers; ++t) {
+    threads.emplace_back([&, t] {
+      int64_t start = thread_cpu_ns();
+      for (int i = 0; i < kReads; ++i) {
+        ModuleConfig config = source.read();
+        CHECK(config.rules_version == config.budget_us);
+      }
+      cpu_ns[t] = thread_cpu_ns() - start;
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  stop.store(true);
+  publisher.join();
+
+  int64_t total = 0;
+  for (int64_t ns : cpu_ns) total += ns;
+  return {static_cast<double>(total) / (uint64_t{kReads} * readers),
+          publishes.load()};
+}
+
+int main() {
+  const char *writer_names[] = {"none", "1 ms", "busy"};
+  printf("%8s %8s %18s %18s\n", "readers", "writer", "seqlock", "mutex");
+  for (int readers : kReaderCounts) {
+    for (Writer writer : {kNone, kMillisecond, kBusy}) {
+      // Both start from a consistent snapshot.
+      ModuleConfig config = kDefaultConfig;
+      config.budget_us = config.rules_version;
+      config_publish(config);
+      locked_publish(config);
+      Result seqlock = run(kSeqlock, readers, writer);
+      Result mutex = run(kMutex, readers, writer);
+      printf("%8d %8s %8.1f %9llu %8.1f %9llu\n", readers,
+             writer_names[writer], seqlock.ns_per_read,
+             (unsigned long long)seqlock.publishes, mutex.ns_per_read,
+             (unsigned long long)mutex.publishes);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "dlsym_cache.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <dlfcn.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * `dlsym` on an explicit handle from 1 to 8 threads, through the hooked
+ * `__loader_dlsym`:
+ *
+ *   uncached  cache disabled: every call reaches the linker
+ *   hit       cache enabled, `kHotNames` names looked up in turn, all stored
+ *   miss      cache enabled, all `SYNTHETIC_FUNCTIONS` names in turn: with
+ *             more names than slots, an entry is overwritten before its name
+ *             comes round again, so every call looks up, asks the linker
+ *             and stores
+ *
+ * The names are those of the synthetic library `bench_hook_install` patches.
+ * Each cell is the total throughput in million lookups per second (median
+ * of `kRuns`), followed by the share of lookups that reached the linker.
+ * The table is direct-mapped, so hot names that share a slot keep evicting
+ * each other and the hit column never gets to 0%.
+ * On a glibc host the linker side is `dlsym` itself, which is cheaper than
+ * bionic's (no namespace walk), so the hit/uncached ratio understates the
+ * gain on a device. With more threads than CPUs, throughput is shared, not
+ * added.
+ */
+
+using LoaderDlsym = void *(*)(void *, const char *, const void *);
+
+constexpr int kThreadCounts[] = {1, 2, 4, 8};
+constexpr int kRuns = 5;
+constexpr int kLookups = 200'000;
+constexpr int kHotNames = 256;
+
+enum Mode { kUncached, kHit, kMiss };
+
+static LoaderDlsym loader_dlsym;
+static void *library;
+static std::vector<std::string> names;
+
+// Looks up `kLookups` names starting at `first`, cycling through `count`.
+static void lookups(int first, int count) {
+  for (int i = 0; i < kLookups; ++i) {
+    const char *name = names[(first + i) % count].c_str();
+    CHECK(mock_call(loader_dlsym, library, name, nullptr) != nullptr);
+  }
+}
+
+// Million lookups per second over all threads.
+static double run(Mode mode, int threads) {
+  int count = mode == kMiss ? SYNTHETIC_FUNCTIONS : kHotNames;
+  if (mode == kHit) lookups(0, count);
+  std::vector<std::thread> workers;
+  int64_t start = host_now_ns();
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back(lookups, t * count / threads, count);
+  }
+  for (auto &worker : workers) worker.join();
+  return threads * kLookups / ((host_now_ns() - start) / 1e3);
+}
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  loader_dlsym =
+      reinterpret_cast<LoaderDlsym>(dlsym(RTLD_DEFAULT, "__loader_dlsym"));
+  CHECK(loader_dlsym != nullptr);
+  dlsym_cache_init();
+  library = dlopen(SYNTHETIC_LIBRARY, RTLD_NOW | RTLD_LOCAL);
+  CHECK(library != nullptr);
+  for (int i = 0; i < SYNTHETIC_FUNCTIONS; ++i) {
+    names.push_back("synthetic_" + std::to_string(i));
+  }
+
+  const char *mode_names[] = {"uncached", "hit", "miss"};
+  printf("%8s", "threads");
+  for (const char *name : mode_names) printf(" %17s", name);
+  printf("\n");
+  for (int threads : kThreadCounts) {
+    printf("%8d", threads);
+    for (Mode mode : {kUncached, kHit, kMiss}) {
+      dlsym_cache_enable(mode != kUncached);
+      std::vector<double> mops;
+      uint64_t linker = host_loader_dlsym_calls();
+      for (int r = 0; r < kRuns; ++r) mops.push_back(run(mode, threads));
+      linker = host_loader_dlsym_calls() - linker;
+      // The hit runs warm the table first.
+      if (mode == kHit) linker -= uint64_t{kRuns} * kHotNames;
+      std::sort(mops.begin(), mops.end());
+      printf(" %9.2f %6.1f%%", mops[kRuns / 2],
+             100.0 * linker / (uint64_t{kRuns} * threads * kLookups));
+    }
+    printf("\n");
+  }
+  dlsym_cache_enable(false);
+  dlclose(library);
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "config.hpp"
+#include "fs_cache.hpp"
+#include "host_support.hpp"
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Replays the probes of a root-detection check, the pattern the cache is
+ * for, against a fake system tree: `stat`, `access`, `faccessat` and
+ * `opendir` on a few paths that exist and many that do not, `kRounds`
+ * times over.
+ *
+ *   off       kFeatureFsCache disabled: no hooks
+ *   cached    the tree's prefix cached with a 60 s TTL
+ *   written   the same, but every round also opens a file under the prefix
+ *             for writing (not timed), which drops every entry
+ *
+ * For each variant the benchmark prints the calls replayed, the calls that
+ * reached the kernel (those the table did not answer; a successful
+ * `opendir` always does), and the mean time per call. The tree is warm in
+ * the dentry cache, so the kernel side is the cheapest it gets; on a device
+ * with SELinux checks on every path walk a miss costs more.
+ */
+
+constexpr int kRounds = 2000;
+
+enum Op { kStat, kAccess, kFaccessat, kOpendir };
+
+struct Probe {
+  Op op;
+  const char *path;
+};
+
+// Relative to the tree; the ones marked exist, the rest do not.
+constexpr Probe kProbes[] = {
+    {kStat, "/bin/su"},
+    {kStat, "/xbin/su"},
+    {kStat, "/sbin/su"},
+    {kAccess, "/bin/su"},
+    {kAccess, "/xbin/su"},
+    {kAccess, "/xbin/busybox"},
+    {kFaccessat, "/bin/magisk"},
+    {kFaccessat, "/app/Superuser.apk"},
+    {kStat, "/build.prop"}, // exists
+    {kAccess, "/build.prop"}, // exists
+    {kStat, "/bin/sh"}, // exists
+    {kOpendir, "/bin"}, // exists
+    {kOpendir, "/xbin"},
+    {kOpendir, "/su/bin"},
+    {kStat, "/lib/libc.so"}, // exists
+    {kFaccessat, "/lib/libsubstrate.so"},
+};
+
+constexpr size_t kProbeCount = sizeof(kProbes) / sizeof(kProbes[0]);
+
+static int (*const stat_function)(const char *, struct stat *) = stat;
+
+static void probe(Op op, const char *path) {
+  struct stat st;
+  switch (op) {
+  case kStat:
+    mock_call(stat_function, path, &st);
+    break;
+  case kAccess:
+    mock_call(access, path, F_OK);
+    break;
+  case kFaccessat:
+    mock_call(faccessat, AT_FDCWD, path, F_OK, 0);
+    break;
+  case kOpendir:
+    if (DIR *dir = mock_call(opendir, path)) closedir(dir);
+    break;
+  }
+}
+
+static void touch(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "w");
+  CHECK(file != nullptr);
+  fclose(file);
+}
+
+int main() {
+  host_load_module();
+  char dir_template[] = "/tmp/bench_fs_cache_XXXXXX";
+  CHECK(mkdtemp(dir_template) != nullptr);
+  std::string root = dir_template;
+  CHECK(mkdir((root + "/bin").c_str(), 0755) == 0);
+  CHECK(mkdir((root + "/lib").c_str(), 0755) == 0);
+  touch(root + "/build.prop");
+  touch(root + "/bin/sh");
+  touch(root + "/lib/libc.so");
+  std::vector<std::string> paths;
+  for (const Probe &probe : kProbes) paths.push_back(root + probe.path);
+
+  struct Variant {
+    const char *name;
+    bool enabled;
+    bool write;
+  };
+  constexpr Variant kVariants[] = {
+      {"off", false, false}, {"cached", true, false}, {"written", true, true}};
+  std::string log = root + "/log";
+
+  printf("%8s %10s %10s %10s\n", "variant", "calls", "kernel", "ns/call");
+  for (const Variant &variant : kVariants) {
+    fs_cache_configure(root + "/", 60000);
+    ModuleConfig config = kDefaultConfig;
+    config.features = variant.enabled ? kFeatureFsCache : 0;
+    config_publish(config);
+
+    uint64_t hits = fs_cache_hits();
+    int64_t elapsed = 0;
+    for (int round = 0; round < kRounds; ++round) {
+      if (variant.write) {
+        FILE *file = mock_call(fopen, log.c_str(), "w");
+        CHECK(file != nullptr);
+        fclose(file);
+      }
+      int64_t start = host_now_ns();
+      for (size_t i = 0; i < kProbeCount; ++i) {
+        probe(kProbes[i].op, paths[i].c_str());
+      }
+      elapsed += host_now_ns() - start;
+    }
+    uint64_t calls = uint64_t{kRounds} * kProbeCount;
+    uint64_t kernel = calls - (fs_cache_hits() - hits);
+    printf("%8s %10llu %10llu %10.0f\n", variant.name,
+           (unsigned long long)calls, (unsigned long long)kernel,
+           static_cast<double>(elapsed) / calls);
+  }
+
+  unlink(log.c_str());
+  unlink((root + "/build.prop").c_str());
+  unlink((root + "/bin/sh").c_str());
+  unlink((root + "/lib/libc.so").c_str());
+  rmdir((root + "/bin").c_str());
+  rmdir((root + "/lib").c_str());
+  rmdir(root.c_str());
+  return 0;
+}
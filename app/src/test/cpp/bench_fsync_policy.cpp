@@ -0,0 +1,104 @@
+#include "config.hpp"
+#include "fsync_policy.hpp"
+#include "host_support.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * A chatty writer: threads appending `kRecord`-byte records to one file, as
+ * a database journal does, each write followed by `fdatasync` through the
+ * hook, under each kind of rule for the file's directory.
+ *
+ *   none        no rule
+ *   passthrough `<dir>/ passthrough 0`
+ *   group 0     `<dir>/ group 0`
+ *   group 2     `<dir>/ group 2`
+ *   coalesce    `<dir>/ coalesce 50 unsafe`
+ *
+ * The file lives in the working directory, since `/tmp` may be a tmpfs
+ * where syncs cost nothing. Each cell is writes per second over `kRunNs`.
+ * A group window only pays off when it is shorter than a sync of the
+ * device; on a fast disk it mostly adds latency.
+ */
+
+constexpr int kThreadCounts[] = {1, 4, 16};
+constexpr int64_t kRunNs = 300'000'000;
+constexpr size_t kRecord = 512;
+
+struct Variant {
+  const char *name;
+  const char *rule;
+};
+
+constexpr Variant kVariants[] = {
+    {"none", nullptr},
+    {"passthrough", "passthrough 0"},
+    {"group 0", "group 0"},
+    {"group 2", "group 2"},
+    {"coalesce", "coalesce 50 unsafe"},
+};
+
+static double writes_per_second(const std::string &path, int threads) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+  CHECK(fd >= 0);
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> writes{0};
+  std::vector<std::thread> workers;
+  int64_t start = host_now_ns();
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      char record[kRecord] = {};
+      while (!stop.load(std::memory_order_relaxed)) {
+        CHECK(write(fd, record, sizeof(record)) == sizeof(record));
+        CHECK(mock_call(fdatasync, fd) == 0);
+        writes.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  while (host_now_ns() - start < kRunNs) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  stop.store(true);
+  for (auto &worker : workers) worker.join();
+  double seconds = (host_now_ns() - start) / 1e9;
+  close(fd);
+  unlink(path.c_str());
+  return writes.load() / seconds;
+}
+
+int main() {
+  host_load_module();
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureFsyncPolicy;
+  config_publish(config);
+
+  char cwd[4096];
+  CHECK(getcwd(cwd, sizeof(cwd)) != nullptr);
+  std::string dir = std::string(cwd) + "/bench_fsync_policy.d";
+  CHECK(mkdir(dir.c_str(), 0700) == 0 || errno == EEXIST);
+  std::string path = dir + "/journal";
+
+  printf("%7s", "threads");
+  for (const Variant &variant : kVariants) printf(" %12s", variant.name);
+  printf("\n");
+  for (int threads : kThreadCounts) {
+    printf("%7d", threads);
+    for (const Variant &variant : kVariants) {
+      fsync_policy_configure(
+          variant.rule ? dir + "/ " + variant.rule : std::string());
+      printf(" %12.0f", writes_per_second(path, threads));
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  fsync_policy_configure("");
+  fsync_policy_enable(false);
+  rmdir(dir.c_str());
+  return 0;
+}
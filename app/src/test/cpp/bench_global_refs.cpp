@@ -0,0 +1,99 @@
+#include "global_refs.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/*
+ * What the global reference hooks add to a `NewGlobalRef` and
+ * `DeleteGlobalRef` pair, with more and more references already live in the
+ * table:
+ *
+ *   plain        the host table's functions, unhooked
+ *   tracked      through the hooks with accounting on: the reentrancy
+ *                guard, the caller's library (a cached return address) and
+ *                the table insert, then the erase
+ *   unseen       `DeleteGlobalRef` alone, tracked, of a reference the table
+ *                does not hold (one created before the hooks were attached),
+ *                which scans all `kRefProbes` slots
+ *
+ * The host's functions only count calls, where ART's take a lock and touch
+ * the reference table, so `tracked - plain` is the hooks' cost and the
+ * plain column is not what a device pays for the pair. Times are the median
+ * over `kRuns` of the mean per pair (per delete for `unseen`), in ns.
+ */
+
+constexpr int kLive[] = {0, 8192, 16384};
+constexpr int kPairs = 1000000;
+constexpr int kRuns = 7;
+
+using NewRef = jobject (*)(JNIEnv *, jobject);
+using DeleteRef = void (*)(JNIEnv *, jobject);
+
+static jobject ref_value(uint64_t n) {
+  return reinterpret_cast<jobject>((n + 1) * 16);
+}
+
+// Distinct values for every pair of every run, so that the inserts land all
+// over the table rather than in one slot.
+static uint64_t next_value = 1u << 24;
+
+static double time_pairs(NewRef new_ref, DeleteRef delete_ref) {
+  JNIEnv *env = host_jni_env();
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kPairs; ++i) {
+      delete_ref(env, new_ref(env, ref_value(next_value++)));
+    }
+    runs.push_back(static_cast<double>(host_now_ns() - start) / kPairs);
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+static double time_unseen(DeleteRef delete_ref) {
+  JNIEnv *env = host_jni_env();
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kPairs; ++i) {
+      delete_ref(env, ref_value(next_value++));
+    }
+    runs.push_back(static_cast<double>(host_now_ns() - start) / kPairs);
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  JNINativeInterface *functions = host_jni_functions();
+  JNIEnv *env = host_jni_env();
+  NewRef plain_new = functions->NewGlobalRef;
+  DeleteRef plain_delete = functions->DeleteGlobalRef;
+  global_refs_init(functions);
+  global_refs_enable(true);
+  NewRef tracked_new = mock_replacement(plain_new);
+  DeleteRef tracked_delete = mock_replacement(plain_delete);
+  CHECK(tracked_new != nullptr && tracked_delete != nullptr);
+
+  printf("%6s %8s %8s %8s\n", "live", "plain", "tracked", "unseen");
+  uint64_t live = 0;
+  for (int target : kLive) {
+    for (; live < static_cast<uint64_t>(target); ++live) {
+      tracked_new(env, ref_value(live));
+    }
+    CHECK(global_refs_live() == live);
+    double plain = time_pairs(plain_new, plain_delete);
+    double tracked = time_pairs(tracked_new, tracked_delete);
+    CHECK(global_refs_live() == live);
+    double unseen = time_unseen(tracked_delete);
+    printf("%6d %8.1f %8.1f %8.1f\n", target, plain, tracked, unseen);
+  }
+
+  global_refs_enable(false);
+  CHECK(mock_hook_count() == 0);
+  return 0;
+}
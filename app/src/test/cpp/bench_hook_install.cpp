@@ -0,0 +1,117 @@
+#include "hook_dispatch.hpp"
+#include "host_support.hpp"
+#include "patch_hooker.hpp"
+#include <cstdio>
+#include <dlfcn.h>
+#include <vector>
+
+/*
+ * How hook installation and hooked calls scale with the number of hooks.
+ *
+ * The synthetic library exports `SYNTHETIC_FUNCTIONS` functions, each
+ * compiled with a pad of nops at its entry, and hooks are installed by
+ * patching that pad (`patch_hooker.hpp`). What this shares with a real
+ * inline hook is the part that scales: a write to the target's code page,
+ * which turns a clean, shared page of the library into a private dirty one.
+ *
+ * For N = 1 to 10,000 the benchmark installs N hooks through
+ * `NativeAPIEntries::hookFunc` and reports the install and removal time,
+ * the growth of private dirty memory (RSS itself barely moves: a copied
+ * page replaces a file page that was resident already) and the cost of
+ * calling a hooked function whose replacement goes through `hook_dispatch`,
+ * against calling it unhooked.
+ */
+
+#ifdef HOST_PATCH_HOOKER
+
+// The replacement of every hook. Only `synthetic_0` is ever called while
+// hooked, so one backup pointer is enough.
+static int (*backup_synthetic)(int);
+
+static int synthetic_handler(int x) {
+  return call_backup(backup_synthetic, x);
+}
+
+static HandlerSlot<int(int)> synthetic_slot{synthetic_handler};
+static HookBudget synthetic_budget{kHookTargetFun, [] {}};
+
+static int fake_synthetic(int x) {
+  return hook_dispatch(synthetic_budget, synthetic_slot, backup_synthetic, x);
+}
+
+constexpr int kCalls = 2000000;
+static volatile int sink;
+
+// Mean time of a call through `fn`, in ns.
+static double time_calls(int (*fn)(int)) {
+  int (*volatile call)(int) = fn;
+  int sum = 0;
+  int64_t start = host_now_ns();
+  for (int i = 0; i < kCalls; ++i) sum += call(i);
+  int64_t elapsed = host_now_ns() - start;
+  sink = sum;
+  return static_cast<double>(elapsed) / kCalls;
+}
+
+static void run(size_t count) {
+  void *library = dlopen(SYNTHETIC_LIBRARY, RTLD_NOW | RTLD_LOCAL);
+  CHECK(library != nullptr);
+  std::vector<void *> targets(count);
+  for (size_t i = 0; i < count; ++i) {
+    char name[32];
+    snprintf(name, sizeof(name), "synthetic_%zu", i);
+    targets[i] = dlsym(library, name);
+    CHECK(targets[i] != nullptr);
+  }
+  auto first = reinterpret_cast<int (*)(int)>(targets[0]);
+  double plain_ns = time_calls(first);
+
+  std::vector<void *> backups(count);
+  long dirty_before = host_private_dirty_kib();
+  int64_t start = host_now_ns();
+  for (size_t i = 0; i < count; ++i) {
+    CHECK(kPatchApi.hookFunc(targets[i], (void *)fake_synthetic,
+                             &backups[i]) == 0);
+  }
+  int64_t install_ns = host_now_ns() - start;
+  long dirty_after = host_private_dirty_kib();
+
+  backup_synthetic = reinterpret_cast<int (*)(int)>(backups[0]);
+  uint64_t counted = stat_total(kHookTargetFun);
+  CHECK(first(41) == 41);
+  double hooked_ns = time_calls(first);
+  CHECK(stat_total(kHookTargetFun) == counted + 1 + kCalls);
+
+  start = host_now_ns();
+  for (size_t i = 0; i < count; ++i) {
+    CHECK(kPatchApi.unhookFunc(targets[i]) == 0);
+  }
+  int64_t remove_ns = host_now_ns() - start;
+  CHECK(first(41) == 41);
+  CHECK(stat_total(kHookTargetFun) == counted + 1 + kCalls);
+
+  printf("%6zu %12.1f %12.0f %10.0f %10ld %9.2f %9.2f\n", count,
+         install_ns / 1e3, static_cast<double>(install_ns) / count,
+         static_cast<double>(remove_ns) / count, dirty_after - dirty_before,
+         plain_ns, hooked_ns - plain_ns);
+  dlclose(library);
+}
+
+int main() {
+  printf("%6s %12s %12s %10s %10s %9s %9s\n", "hooks", "install_us",
+         "ns/install", "ns/remove", "dirty_kib", "call_ns", "extra_ns");
+  for (size_t count : {1, 10, 100, 1000, 10000}) {
+    if (count > SYNTHETIC_FUNCTIONS) break;
+    run(count);
+  }
+  return 0;
+}
+
+#else
+
+int main() {
+  printf("no patching hooker for this architecture, skipped\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "config.hpp"
+#include "hook_stats.hpp"
+#include "host_support.hpp"
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+/*
+ * Hooked calls from 1 to 64 threads while the hooks come and go.
+ *
+ * The module is loaded as on a device (`host_load_module`), `target_fun` is
+ * attached as if `libtarget.so` had been loaded, and a toggler thread keeps
+ * publishing configurations that remove and reinstall every hook, the way a
+ * user flipping switches in the app does. Worker threads call `target_fun`,
+ * `fopen` and `FindClass` the way their callers would (`mock_call`), and
+ * check every result.
+ *
+ * For each function and thread count the benchmark prints the throughput
+ * and the spread of per-thread throughput (coefficient of variation): with
+ * all threads doing the same work, a spread that grows with the thread count
+ * points at threads contending for the same cache lines.
+ *
+ * The second table isolates the call counters. Every thread increments
+ *
+ *   sharded  its `stat_count` shard, as the hooks do
+ *   packed   its own counter, but next to the other threads' counters
+ *   shared   one counter for everybody
+ *
+ * and the `packed / sharded` ratio is the cost of false sharing that the
+ * sharding avoids. Times are per thread and in wall time, so with more
+ * threads than CPUs they include waiting for a CPU; on a single CPU all three
+ * columns are about equal.
+ */
+
+extern "C" [[gnu::visibility("default")]] [[gnu::noinline]] int target_fun() {
+  return 41;
+}
+
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+constexpr int kMaxThreads = 64;
+constexpr int64_t kRunNs = 100'000'000;
+
+enum Op { kOpTargetFun, kOpFopen, kOpFindClass };
+
+static const char *op_name(Op op) {
+  switch (op) {
+  case kOpTargetFun:
+    return "target_fun";
+  case kOpFopen:
+    return "fopen";
+  case kOpFindClass:
+    return "FindClass";
+  }
+  return "?";
+}
+
+static void call(Op op) {
+  switch (op) {
+  case kOpTargetFun: {
+    int value = mock_call(target_fun);
+    CHECK(value == 41 || value == 42);
+    break;
+  }
+  case kOpFopen: {
+    FILE *file = mock_call(fopen, "/dev/null", "r");
+    CHECK(file != nullptr);
+    fclose(file);
+    break;
+  }
+  case kOpFindClass:
+    CHECK(mock_call(host_jni_functions()->FindClass, host_jni_env(),
+                    "java/lang/String") != nullptr);
+    break;
+  }
+}
+
+struct Spread {
+  double mean;
+  double cv;
+};
+
+static Spread spread(const std::vector<double> &values) {
+  double sum = 0;
+  for (double value : values) sum += value;
+  double mean = sum / values.size();
+  double squares = 0;
+  for (double value : values) squares += (value - mean) * (value - mean);
+  double sd = std::sqrt(squares / values.size());
+  return {mean, mean > 0 ? sd / mean : 0};
+}
+
+static void stress(Op op, int threads) {
+  std::atomic<bool> stop{false};
+  std::vector<uint64_t> calls(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      uint64_t count = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        call(op);
+        ++count;
+      }
+      calls[t] = count;
+    });
+  }
+
+  // Remove and reinstall every hook while the workers run.
+  uint64_t toggles = 0;
+  ModuleConfig config = kDefaultConfig;
+  int64_t start = host_now_ns();
+  while (host_now_ns() - start < kRunNs) {
+    config.enabled_hooks = toggles++ % 2 == 0 ? 0 : ~0u;
+    config_publish(config);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  config_publish(kDefaultConfig);
+  stop.store(true);
+  for (auto &worker : workers) worker.join();
+  double seconds = (host_now_ns() - start) / 1e9;
+
+  std::vector<double> per_thread;
+  uint64_t total = 0;
+  for (uint64_t count : calls) {
+    per_thread.push_back(count / seconds);
+    total += count;
+  }
+  Spread s = spread(per_thread);
+  printf("%-10s %7d %14.0f %14.0f %8.3f %8llu\n", op_name(op), threads,
+         total / seconds, s.mean, s.cv, (unsigned long long)toggles);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Counters
+ * -----------------------------------------------------------------------------
+ */
+
+constexpr uint64_t kIncrements = 1'000'000;
+
+static std::atomic<uint64_t> shared_counter;
+static std::atomic<uint64_t> packed_counters[kMaxThreads];
+
+enum Counter { kSharded, kPacked, kShared };
+
+// Mean ns per increment of each thread.
+static Spread count(Counter counter, int threads) {
+  std::vector<double> ns(threads);
+  std::vector<std::thread> workers;
+  std::atomic<int> ready{0};
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (ready.load() < threads) std::this_thread::yield();
+      int64_t start = host_now_ns();
+      for (uint64_t i = 0; i < kIncrements; ++i) {
+        switch (counter) {
+        case kSharded:
+          stat_count(kHookTargetFun);
+          break;
+        case kPacked:
+          packed_counters[t].fetch_add(1, std::memory_order_relaxed);
+          break;
+        case kShared:
+          shared_counter.fetch_add(1, std::memory_order_relaxed);
+          break;
+        }
+      }
+      ns[t] = static_cast<double>(host_now_ns() - start) / kIncrements;
+    });
+  }
+  for (auto &worker : workers) worker.join();
+  return spread(ns);
+}
+
+int main() {
+  NativeOnModuleLoaded on_library_loaded = host_load_module();
+  // `dlsym(RTLD_DEFAULT, "target_fun")` finds the function above.
+  on_library_loaded("libtarget.so", RTLD_DEFAULT);
+  CHECK(mock_replacement(target_fun) != nullptr);
+  CHECK(mock_call(target_fun) == 42);
+
+  printf("%-10s %7s %14s %14s %8s %8s\n", "function", "threads", "calls/s",
+         "calls/s/thread", "cv", "toggles");
+  for (Op op : {kOpTargetFun, kOpFopen, kOpFindClass}) {
+    for (int threads : kThreadCounts) stress(op, threads);
+  }
+  CHECK(mock_call(target_fun) == 42);
+
+  printf("\n%7s %12s %12s %12s %14s\n", "threads", "sharded_ns", "packed_ns",
+         "shared_ns", "packed/sharded");
+  for (int threads : kThreadCounts) {
+    Spread sharded = count(kSharded, threads);
+    Spread packed = count(kPacked, threads);
+    Spread shared = count(kShared, threads);
+    printf("%7d %12.2f %12.2f %12.2f %14.2f\n", threads, sharded.mean,
+           packed.mean, shared.mean, packed.mean / sharded.mean);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "hook_dispatch.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include "patch_hooker.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <dlfcn.h>
+#include <vector>
+
+/*
+ * What a call to a hooked function costs as its rules come and go.
+ *
+ * `synthetic_0` of the synthetic library is hooked through the hook manager
+ * with the patching `NativeAPIEntries` of `patch_hooker.hpp`, and its
+ * replacement goes through `hook_dispatch` to a handler that checks the
+ * rules, like `fake_fopen`. The benchmark times calls:
+ *
+ *   never hooked   the baseline
+ *   rules          installed, with a rule set
+ *   empty, kept    installed with no rules, as every hook stayed before
+ *                  the manager removed empty ones: pure pass-through cost
+ *   removed        rules cleared, so the manager unhooked it
+ *   rules again    reinstalled by setting a rule
+ *   removed again  and cleared once more
+ *
+ * Each row is the median over `kRuns` of the mean time per call, and the
+ * difference to the baseline, which the removed rows should be back at.
+ */
+
+constexpr int kCalls = 2000000;
+constexpr int kRuns = 5;
+static volatile int sink;
+
+static int (*backup_synthetic)(int);
+
+static int fake_synthetic(int x);
+
+static Hook synthetic_hook{kHookTargetFun, (void *)fake_synthetic,
+                           (void **)&backup_synthetic};
+
+// Calls that found the rule set; an empty mask passes through.
+static int enforced;
+
+static int synthetic_handler(int x) {
+  if (hook_rules(synthetic_hook) & 1u) enforced++;
+  return call_backup(backup_synthetic, x);
+}
+
+static HandlerSlot<int(int)> synthetic_slot{synthetic_handler};
+static HookBudget synthetic_budget{kHookTargetFun, [] {}};
+
+static int fake_synthetic(int x) {
+  return hook_dispatch(synthetic_budget, synthetic_slot, backup_synthetic, x);
+}
+
+#ifdef HOST_PATCH_HOOKER
+
+// Median over `kRuns` of the mean time of a call through `fn`, in ns.
+static double time_calls(int (*fn)(int)) {
+  int (*volatile call)(int) = fn;
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int sum = 0;
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kCalls; ++i) sum += call(i);
+    runs.push_back(static_cast<double>(host_now_ns() - start) / kCalls);
+    sink = sum;
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+int main() {
+  void *library = dlopen(SYNTHETIC_LIBRARY, RTLD_NOW | RTLD_LOCAL);
+  CHECK(library != nullptr);
+  void *target = dlsym(library, "synthetic_0");
+  CHECK(target != nullptr);
+  auto call = reinterpret_cast<int (*)(int)>(target);
+  hook_manager_init(&kPatchApi);
+
+  printf("%14s %9s %9s\n", "state", "call_ns", "extra_ns");
+  double baseline = time_calls(call);
+  auto row = [&](const char *state, bool hooked) {
+    uint64_t counted = stat_total(kHookTargetFun);
+    CHECK(call(41) == 41);
+    CHECK(stat_total(kHookTargetFun) == counted + (hooked ? 1 : 0));
+    double ns = time_calls(call);
+    printf("%14s %9.2f %9.2f\n", state, ns, ns - baseline);
+  };
+  printf("%14s %9.2f %9.2f\n", "never hooked", baseline, 0.0);
+
+  CHECK(hook_attach(synthetic_hook, target));
+  CHECK(hook_set_rules(synthetic_hook, 1));
+  row("rules", true);
+
+  // What the manager avoids: the same replacement left in place.
+  CHECK(hook_set_rules(synthetic_hook, 0));
+  CHECK(kPatchApi.hookFunc(target, (void *)fake_synthetic,
+                           (void **)&backup_synthetic) == 0);
+  row("empty, kept", true);
+  CHECK(kPatchApi.unhookFunc(target) == 0);
+
+  row("removed", false);
+  CHECK(hook_set_rules(synthetic_hook, 1));
+  row("rules again", true);
+  CHECK(hook_set_rules(synthetic_hook, 0));
+  row("removed again", false);
+  dlclose(library);
+  return 0;
+}
+
+#else
+
+int main() {
+  printf("no patching hooker for this architecture, skipped\n");
+  return 0;
+}
+
+#endif
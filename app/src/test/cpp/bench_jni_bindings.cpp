@@ -0,0 +1,91 @@
+#include "bridge.hpp"
+#include "host_support.hpp"
+#include "kv_store.hpp"
+#include <cstdio>
+#include <dlfcn.h>
+#include <unistd.h>
+
+/*
+ * The native side of `NativeBridge` calls, by binding style, as bound by
+ * `bridge_register_natives` on the host JNI table.
+ *
+ *   @CriticalNative   `hookCalls`, `logRecord`: called as registered on
+ *                     API 26+, and through the `WithEnv` adapter that older
+ *                     runtimes get
+ *   @FastNative       `kvGetLong`: one string argument, copied with
+ *                     `GetStringLength` + `GetStringRegion`
+ *   regular           `kvPutLong`: the same copy, plus the store's lock
+ *
+ * What the binding style itself saves is the runtime's transition into
+ * native code (thread state change, `JNIEnv`/`jclass` and local reference
+ * frames), which only exists in ART; on the host the columns show what each
+ * implementation costs once it is reached, i.e. the floor for each style.
+ * The last line is what binding by name costs instead of `RegisterNatives`:
+ * the `dlsym` of a mangled name that ART does on the first call of each
+ * method (here a miss over every loaded library, as for a method whose
+ * library has not exported it).
+ */
+
+constexpr int kCalls = 2'000'000;
+
+template <typename Fn> static double ns_per_call(Fn fn) {
+  int64_t start = host_now_ns();
+  for (int i = 0; i < kCalls; ++i) fn(i);
+  return static_cast<double>(host_now_ns() - start) / kCalls;
+}
+
+template <typename Fn> static Fn native(const char *name) {
+  void *fn = host_registered_native(name);
+  CHECK(fn != nullptr);
+  return reinterpret_cast<Fn>(fn);
+}
+
+int main() {
+  host_property_set("ro.build.version.sdk", "34");
+  host_load_module();
+  JNIEnv *env = host_jni_env();
+  jclass clazz = nullptr;
+
+  char path[] = "/tmp/bench_jni_bindings_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  unlink(path);
+  CHECK(module_settings().map(fd, true));
+  jstring key = host_jstring("bench.binding.key");
+
+  auto hook_calls = native<jlong (*)(jint)>("hookCalls");
+  auto log_record = native<void (*)(jint, jlong, jlong)>("logRecord");
+  auto kv_get_long =
+      native<jlong (*)(JNIEnv *, jclass, jstring, jlong)>("kvGetLong");
+  auto kv_put_long =
+      native<jboolean (*)(JNIEnv *, jclass, jstring, jlong)>("kvPutLong");
+
+  // As registered on a runtime that ignores the annotations.
+  host_property_set("ro.build.version.sdk", "25");
+  CHECK(bridge_register_natives(env));
+  auto hook_calls_adapted =
+      native<jlong (*)(JNIEnv *, jclass, jint)>("hookCalls");
+  CHECK(reinterpret_cast<void *>(hook_calls_adapted) !=
+        reinterpret_cast<void *>(hook_calls));
+
+  CHECK(kv_put_long(env, clazz, key, 1) == JNI_TRUE);
+  CHECK(kv_get_long(env, clazz, key, -1) == 1);
+
+  printf("%-12s %-16s %10s\n", "method", "style", "ns/call");
+  printf("%-12s %-16s %10.1f\n", "hookCalls", "critical",
+         ns_per_call([&](int) { hook_calls(0); }));
+  printf("%-12s %-16s %10.1f\n", "hookCalls", "critical, pre-26",
+         ns_per_call([&](int) { hook_calls_adapted(env, clazz, 0); }));
+  printf("%-12s %-16s %10.1f\n", "logRecord", "critical",
+         ns_per_call([&](int i) { log_record(0, i, i); }));
+  printf("%-12s %-16s %10.1f\n", "kvGetLong", "fast",
+         ns_per_call([&](int) { kv_get_long(env, clazz, key, -1); }));
+  printf("%-12s %-16s %10.1f\n", "kvPutLong", "regular",
+         ns_per_call([&](int i) { kv_put_long(env, clazz, key, i); }));
+  printf("%-12s %-16s %10.1f\n", "(by name)", "dlsym, first call",
+         ns_per_call([&](int) {
+           dlsym(RTLD_DEFAULT,
+                 "Java_io_github_libxposed_example_NativeBridge_hookCalls");
+         }));
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include "jni_id_cache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * `GetMethodID` with the ID cache off and on, for hot sets of 8 to 512
+ * distinct (class, name, signature) lookups repeated in turn.
+ *
+ * The host table's `GetMethodID` is replaced by a stand-in for ART's
+ * resolution: a linear search of the class's `kMethods` methods by name and
+ * signature. ART does more (a thread state transition, the dex cache, the
+ * superclasses and interfaces), so the uncached column is a lower bound of
+ * what a device pays, and the cached column is what the hook costs there
+ * too. Each cell is the mean time per lookup in ns (median of `kRuns`),
+ * followed by the share of lookups that reached the stand-in.
+ */
+
+constexpr int kClasses = 8;
+constexpr int kMethods = 64;
+constexpr int kHotSets[] = {8, 64, 512};
+constexpr int kLookups = 1000000;
+constexpr int kRuns = 5;
+
+struct HostMethod {
+  std::string name;
+  std::string signature;
+};
+
+struct HostClass : _jclass {
+  std::vector<HostMethod> methods;
+};
+
+static HostClass classes[kClasses];
+static uint64_t resolutions;
+
+static jmethodID resolve_method(JNIEnv *, jclass clazz, const char *name,
+                                const char *sig) {
+  resolutions++;
+  auto *host = static_cast<HostClass *>(clazz);
+  for (HostMethod &method : host->methods) {
+    if (method.name == name && method.signature == sig) {
+      return reinterpret_cast<jmethodID>(&method);
+    }
+  }
+  return nullptr;
+}
+
+static jboolean same_object(JNIEnv *, jobject a, jobject b) {
+  return a == b ? JNI_TRUE : JNI_FALSE;
+}
+
+struct Lookup {
+  jclass clazz;
+  const char *name;
+  const char *sig;
+};
+
+// Mean time per lookup over `kLookups` calls cycling through `set`.
+static double time_lookups(const std::vector<Lookup> &set) {
+  JNIEnv *env = host_jni_env();
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kLookups; ++i) {
+      const Lookup &lookup = set[i % set.size()];
+      CHECK(mock_call(resolve_method, env, lookup.clazz, lookup.name,
+                      lookup.sig) != nullptr);
+    }
+    runs.push_back(static_cast<double>(host_now_ns() - start) / kLookups);
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+int main() {
+  for (HostClass &host : classes) {
+    for (int m = 0; m < kMethods; ++m) {
+      host.methods.push_back({"method" + std::to_string(m),
+                              "(ILjava/lang/String;)V"});
+    }
+  }
+  JNINativeInterface *functions = host_jni_functions();
+  functions->GetMethodID = resolve_method;
+  functions->IsSameObject = same_object;
+  hook_manager_init(mock_hook_api());
+  jni_id_cache_init(host_java_vm(), functions);
+
+  printf("%6s %10s %10s %8s\n", "set", "uncached", "cached", "resolved");
+  for (int size : kHotSets) {
+    std::vector<Lookup> set;
+    for (int i = 0; i < size; ++i) {
+      // Spread over the classes, and over the methods from the back, so
+      // that lookups search most of the class.
+      HostClass &host = classes[i % kClasses];
+      const HostMethod &method =
+          host.methods[kMethods - 1 - (i / kClasses) % kMethods];
+      set.push_back({&host, method.name.c_str(), method.signature.c_str()});
+    }
+    jni_id_cache_enable(false);
+    double uncached = time_lookups(set);
+    jni_id_cache_enable(true);
+    uint64_t before = resolutions;
+    double cached = time_lookups(set);
+    double resolved =
+        100.0 * (resolutions - before) / (uint64_t{kRuns} * kLookups);
+    printf("%6d %10.1f %10.1f %7.2f%%\n", size, uncached, cached, resolved);
+  }
+  jni_id_cache_enable(false);
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "bridge.hpp"
+#include "host_support.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <android/log.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * The per-package log line of `ModuleMain.onPackageLoaded`, through the
+ * native log sink and through a host stand-in for the string path it
+ * replaced:
+ *
+ *   sink         `NativeBridge.logRecord` as bound by `RegisterNatives`:
+ *                two primitives appended to the trace ring
+ *   string       the same line built by concatenation (`std::string`, as
+ *                Kotlin's `+` builds it with a `StringBuilder`) and handed
+ *                to the log
+ *
+ * `call` is the mean time on the logging thread and `allocs` the heap
+ * allocations per line there; `flush` is the time per record the watchdog
+ * thread spends formatting sink records later (`trace_flush`), none for the
+ * string path. Times are the median over `kRuns`, in ns.
+ *
+ * Host logging is silent, so neither column includes the write to logcat.
+ * The string path's allocations are `operator new` calls of `std::string`;
+ * the ART heap, the GC work they cause and the JNI transition into
+ * `logRecord` cannot be measured on the host.
+ */
+
+constexpr uint32_t kRecordId = 1;
+constexpr int kLines = static_cast<int>(kTraceCapacity);
+constexpr int kRuns = 9;
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size != 0 ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+using LogRecord = void (*)(JNIEnv *, jclass, jint, jlong, jlong);
+using RegisterLogFormat = void (*)(JNIEnv *, jclass, jint, jstring);
+
+struct Result {
+  double call_ns;
+  double allocs;
+  double flush_ns;
+};
+
+static double median(std::vector<double> &runs) {
+  std::sort(runs.begin(), runs.end());
+  return runs[runs.size() / 2];
+}
+
+// One ring's worth of lines per run, so that every record is still there
+// when it is flushed.
+static Result time_sink(LogRecord log_record) {
+  JNIEnv *env = host_jni_env();
+  std::vector<double> calls, flushes;
+  uint64_t allocs = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kLines; ++i) {
+      log_record(env, nullptr, kRecordId, 10000 + i, i & 1);
+    }
+    int64_t logged = host_now_ns();
+    allocs += allocations.load(std::memory_order_relaxed) - before;
+    trace_flush();
+    int64_t flushed = host_now_ns();
+    calls.push_back(static_cast<double>(logged - start) / kLines);
+    flushes.push_back(static_cast<double>(flushed - logged) / kLines);
+  }
+  return {median(calls), static_cast<double>(allocs) / (kRuns * kLines),
+          median(flushes)};
+}
+
+static Result time_string() {
+  std::vector<double> calls;
+  uint64_t allocs = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kLines; ++i) {
+      std::string line = "package loaded: uid " + std::to_string(10000 + i) +
+                         ", first package " + std::to_string(i & 1);
+      __android_log_print(ANDROID_LOG_INFO, "bench", "%s", line.c_str());
+    }
+    int64_t logged = host_now_ns();
+    allocs += allocations.load(std::memory_order_relaxed) - before;
+    calls.push_back(static_cast<double>(logged - start) / kLines);
+  }
+  return {median(calls), static_cast<double>(allocs) / (kRuns * kLines), 0};
+}
+
+int main() {
+  // Binds the natives without `host_load_module`, whose watchdog thread
+  // would flush the ring concurrently with `time_sink`.
+  JNIEnv *env = host_jni_env();
+  CHECK(bridge_register_natives(env));
+  auto log_record =
+      reinterpret_cast<LogRecord>(host_registered_native("logRecord"));
+  auto register_log_format = reinterpret_cast<RegisterLogFormat>(
+      host_registered_native("registerLogFormat"));
+  CHECK(log_record != nullptr && register_log_format != nullptr);
+  register_log_format(env, nullptr, kRecordId,
+                      host_jstring("package loaded: uid {}, first package {}"));
+
+  Result sink = time_sink(log_record);
+  Result string = time_string();
+  CHECK(sink.allocs == 0);
+
+  printf("%8s %8s %8s %8s\n", "path", "call", "allocs", "flush");
+  printf("%8s %8.1f %8.2f %8.1f\n", "sink", sink.call_ns, sink.allocs,
+         sink.flush_ns);
+  printf("%8s %8.1f %8.2f %8s\n", "string", string.call_ns, string.allocs,
+         "-");
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "host_support.hpp"
+#include "mutf8.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+ * Throughput of the transcoders against scalar ports of ART's converters
+ * (the loops `mutf8_test` checks against, writing into a caller buffer),
+ * for strings of 16 bytes to 64 KiB of
+ *
+ *   ascii     printable ASCII, the common case
+ *   mixed     ASCII with one two-byte character in 16
+ *   cyrillic  two-byte characters separated by spaces
+ *   cjk       three-byte characters
+ *
+ * Each cell is MB of modified UTF-8 per second, median of `kRuns`:
+ * decoding to UTF-16 (`mutf8_to_utf16` / ART's), then encoding back
+ * (`utf16_to_mutf8` / ART's). Ours also validates while decoding, which
+ * ART's lenient decoder does not.
+ */
+
+constexpr size_t kSizes[] = {16, 256, 4096, 65536};
+constexpr size_t kBytesPerRun = 16 << 20;
+constexpr int kRuns = 5;
+
+static size_t art_decode(const uint8_t *in, size_t length, uint16_t *out) {
+  uint16_t *start = out;
+  for (const uint8_t *end = in + length; in < end;) {
+    uint8_t one = *in++;
+    if ((one & 0x80) == 0) {
+      *out++ = one;
+      continue;
+    }
+    uint8_t two = *in++;
+    if ((one & 0x20) == 0) {
+      *out++ = ((one & 0x1f) << 6) | (two & 0x3f);
+      continue;
+    }
+    uint8_t three = *in++;
+    if ((one & 0x10) == 0) {
+      *out++ = ((one & 0x0f) << 12) | ((two & 0x3f) << 6) | (three & 0x3f);
+      continue;
+    }
+    uint8_t four = *in++;
+    uint32_t code = ((one & 0x0f) << 18) | ((two & 0x3f) << 12) |
+                    ((three & 0x3f) << 6) | (four & 0x3f);
+    *out++ = (code >> 10) + 0xd7c0;
+    *out++ = (code & 0x3ff) + 0xdc00;
+  }
+  return out - start;
+}
+
+static size_t art_encode(const uint16_t *in, size_t length, uint8_t *out) {
+  uint8_t *start = out;
+  for (size_t i = 0; i < length; ++i) {
+    uint32_t ch = in[i];
+    if (ch != 0 && ch <= 0x7f) {
+      *out++ = ch;
+    } else if (ch <= 0x7ff) {
+      *out++ = 0xc0 | (ch >> 6);
+      *out++ = 0x80 | (ch & 0x3f);
+    } else if (ch >= 0xd800 && ch <= 0xdbff && i + 1 < length &&
+               in[i + 1] >= 0xdc00 && in[i + 1] <= 0xdfff) {
+      uint32_t code = ((ch - 0xd800) << 10) + (in[++i] - 0xdc00) + 0x10000;
+      *out++ = 0xf0 | (code >> 18);
+      *out++ = 0x80 | ((code >> 12) & 0x3f);
+      *out++ = 0x80 | ((code >> 6) & 0x3f);
+      *out++ = 0x80 | (code & 0x3f);
+    } else {
+      *out++ = 0xe0 | (ch >> 12);
+      *out++ = 0x80 | ((ch >> 6) & 0x3f);
+      *out++ = 0x80 | (ch & 0x3f);
+    }
+  }
+  return out - start;
+}
+
+enum Text { kAscii, kMixed, kCyrillic, kCjk };
+
+// About `size` bytes of `text`, never splitting a character.
+static std::vector<uint8_t> make_text(Text text, size_t size) {
+  std::mt19937 random(7);
+  std::vector<uint8_t> out;
+  auto put = [&](uint32_t code) {
+    if (code < 0x80) {
+      out.push_back(code);
+    } else if (code < 0x800) {
+      out.push_back(0xc0 | (code >> 6));
+      out.push_back(0x80 | (code & 0x3f));
+    } else {
+      out.push_back(0xe0 | (code >> 12));
+      out.push_back(0x80 | ((code >> 6) & 0x3f));
+      out.push_back(0x80 | (code & 0x3f));
+    }
+  };
+  while (out.size() + 3 <= size) {
+    uint32_t ascii = 0x20 + random() % 95;
+    switch (text) {
+    case kAscii:
+      put(ascii);
+      break;
+    case kMixed:
+      put(out.size() % 16 == 15 ? 0xe9 : ascii);
+      break;
+    case kCyrillic:
+      put(out.size() % 8 == 6 ? ' ' : 0x430 + random() % 32);
+      break;
+    case kCjk:
+      put(0x4e00 + random() % 0x5000);
+      break;
+    }
+  }
+  while (out.size() < size) out.push_back('a');
+  return out;
+}
+
+template <typename Fn> static double mbps(size_t size, Fn fn) {
+  size_t calls = std::max<size_t>(1, kBytesPerRun / size);
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    for (size_t i = 0; i < calls; ++i) fn();
+    runs.push_back(calls * size / ((host_now_ns() - start) / 1e3));
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+int main() {
+  const char *text_names[] = {"ascii", "mixed", "cyrillic", "cjk"};
+  printf("%9s %6s %10s %10s %10s %10s\n", "text", "bytes", "decode",
+         "art", "encode", "art");
+  for (Text text : {kAscii, kMixed, kCyrillic, kCjk}) {
+    for (size_t size : kSizes) {
+      std::vector<uint8_t> bytes = make_text(text, size);
+      const char *utf8 = reinterpret_cast<const char *>(bytes.data());
+      std::vector<uint16_t> units(size);
+      std::vector<uint8_t> back(4 * size);
+      ptrdiff_t count = mutf8_to_utf16(utf8, size, units.data());
+      CHECK(count >= 0);
+      CHECK(static_cast<size_t>(count) ==
+            art_decode(bytes.data(), size, units.data()));
+
+      volatile ptrdiff_t sink;
+      double decode = mbps(size, [&] {
+        sink = mutf8_to_utf16(utf8, size, units.data());
+      });
+      double art_decoded = mbps(size, [&] {
+        sink = art_decode(bytes.data(), size, units.data());
+      });
+      double encode = mbps(size, [&] {
+        sink = utf16_to_mutf8(units.data(), count,
+                              reinterpret_cast<char *>(back.data()),
+                              back.size());
+      });
+      double art_encoded = mbps(size, [&] {
+        sink = art_encode(units.data(), count, back.data());
+      });
+      (void)sink;
+      printf("%9s %6zu %10.0f %10.0f %10.0f %10.0f\n", text_names[text],
+             size, decode, art_decoded, encode, art_encoded);
+    }
+  }
+  return 0;
+}
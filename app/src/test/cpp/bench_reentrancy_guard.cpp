@@ -0,0 +1,84 @@
+#include "hook_dispatch.hpp"
+#include "host_support.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/*
+ * The reentrancy guard of `hook_dispatch` on the path every hooked call
+ * takes, the one that does not recurse. Each function is called through a
+ * pointer, as a patched entry would be:
+ *
+ *   backup       the original alone
+ *   slot         the handler slot, no guard
+ *   guard        the guard's steps (TLS load, test, set and clear the bit)
+ *                around the slot, as `hook_dispatch` does them
+ *   dispatch     `hook_dispatch` itself: guard, call count and the watchdog's
+ *                sampling countdown
+ *   recursive    `hook_dispatch` with the bit already set, which goes
+ *                straight to the backup
+ *
+ * `guard - slot` is what the guard adds to a call. Times are the median over
+ * `kRuns` of the mean per call, in ns.
+ */
+
+constexpr int kCalls = 5000000;
+constexpr int kRuns = 7;
+static volatile int sink;
+
+[[gnu::noinline]] static int original(int x) {
+  asm volatile("");
+  return x + 1;
+}
+static int (*backup_original)(int) = original;
+
+static int handler(int x) { return call_backup(backup_original, x); }
+static HandlerSlot<int(int)> slot{handler};
+static HookBudget budget{kHookTargetFun, [] {}};
+
+static int via_slot(int x) { return slot(x); }
+
+static int via_guard(int x) {
+  HookThreadState &state = hook_thread_state();
+  uint32_t bit = 1u << budget.id;
+  if (state.in_hook & bit) return backup_original(x);
+  state.in_hook |= bit;
+  int result = slot(x);
+  state.in_hook &= ~bit;
+  return result;
+}
+
+static int via_dispatch(int x) {
+  return hook_dispatch(budget, slot, backup_original, x);
+}
+
+static double time_calls(int (*fn)(int)) {
+  int (*volatile call)(int) = fn;
+  std::vector<double> runs;
+  for (int run = 0; run < kRuns; ++run) {
+    int sum = 0;
+    int64_t start = host_now_ns();
+    for (int i = 0; i < kCalls; ++i) sum += call(i);
+    runs.push_back(static_cast<double>(host_now_ns() - start) / kCalls);
+    sink = sum;
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[kRuns / 2];
+}
+
+int main() {
+  CHECK(via_dispatch(1) == 2);
+  double backup_ns = time_calls(original);
+  double slot_ns = time_calls(via_slot);
+  double guard_ns = time_calls(via_guard);
+  double dispatch_ns = time_calls(via_dispatch);
+  hook_thread_state().in_hook |= 1u << budget.id;
+  double recursive_ns = time_calls(via_dispatch);
+  hook_thread_state().in_hook = 0;
+
+  printf("%10s %10s %10s %10s %10s %10s\n", "backup", "slot", "guard",
+         "dispatch", "recursive", "guard-slot");
+  printf("%10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", backup_ns, slot_ns,
+         guard_ns, dispatch_ns, recursive_ns, guard_ns - slot_ns);
+  return 0;
+}
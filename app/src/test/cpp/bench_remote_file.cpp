@@ -0,0 +1,92 @@
+#include "host_support.hpp"
+#include "mutf8.hpp"
+#include "remote_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Loading a remote file natively against the Kotlin path it replaces.
+ *
+ *   native  `remote_file_map`: one read into a private snapshot
+ *   kotlin  what `FileReader(fd).readText()` followed by handing the string
+ *           to native code does, minus the JVM: 8 KiB reads, decoding to
+ *           UTF-16, and encoding back to modified UTF-8 as
+ *           `GetStringUTFChars` does
+ *
+ * The Kotlin column is a lower bound: allocation, GC and the JNI transitions
+ * are not included. Times are the median of `kRuns` loads of a warm file.
+ */
+
+constexpr size_t kSizes[] = {4 << 10, 64 << 10, 1 << 20, 16 << 20};
+constexpr int kRuns = 9;
+constexpr size_t kReadChunk = 8192;
+
+static std::string text_of(size_t size) {
+  std::string text;
+  text.reserve(size);
+  for (int line = 0; text.size() < size; ++line) {
+    text += "rule ";
+    text += std::to_string(line);
+    text += " /data/data/com.example/cache/ \xc3\xa9t\xc3\xa9\n";
+  }
+  text.resize(size);
+  // Do not end on half a character.
+  while (!text.empty() && (text.back() & 0x80)) text.pop_back();
+  return text;
+}
+
+static size_t kotlin_path(int fd) {
+  std::vector<char> bytes;
+  char chunk[kReadChunk];
+  off_t offset = 0;
+  for (ssize_t n; (n = pread(fd, chunk, sizeof(chunk), offset)) > 0;) {
+    bytes.insert(bytes.end(), chunk, chunk + n);
+    offset += n;
+  }
+  std::vector<uint16_t> units(bytes.size());
+  ptrdiff_t length = mutf8_to_utf16(bytes.data(), bytes.size(), units.data());
+  CHECK(length >= 0);
+  std::vector<char> utf(3 * length + 1);
+  ptrdiff_t encoded = utf16_to_mutf8(units.data(), length, utf.data(),
+                                     utf.size());
+  CHECK(encoded == static_cast<ptrdiff_t>(bytes.size()));
+  return encoded;
+}
+
+template <typename Fn> static double median_us(Fn fn) {
+  std::vector<double> us;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    fn();
+    us.push_back((host_now_ns() - start) / 1e3);
+  }
+  std::sort(us.begin(), us.end());
+  return us[kRuns / 2];
+}
+
+int main() {
+  printf("%10s %12s %12s %8s\n", "bytes", "native_us", "kotlin_us", "ratio");
+  for (size_t size : kSizes) {
+    char path[] = "/tmp/bench_remote_file_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    std::string text = text_of(size);
+    CHECK(write(fd, text.data(), text.size()) ==
+          static_cast<ssize_t>(text.size()));
+
+    double native = median_us([&] {
+      CHECK(remote_file_map("bench", fd) == static_cast<long>(text.size()));
+    });
+    CHECK(remote_file_view("bench") == text);
+    double kotlin = median_us([&] { kotlin_path(fd); });
+    printf("%10zu %12.1f %12.1f %8.1f\n", text.size(), native, kotlin,
+           kotlin / native);
+    close(fd);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "config.hpp"
+#include "host_support.hpp"
+#include "stdio_policy.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Reading a multi-MB file front to back through the hooked `fopen`, with and
+ * without a stdio rule for its directory.
+ *
+ *   default     no rule: stdio's own buffer
+ *   64k seq     `<dir>/ 64 sequential`
+ *   1m seq      `<dir>/ 1024 sequential`
+ *   1m caller   no rule, but a 1 MiB buffer passed to `setvbuf` by the caller
+ *
+ * glibc ignores the size in `setvbuf(file, nullptr, _IOFBF, size)` and keeps
+ * its own buffer of `st_blksize`, so on a glibc host the two rule columns
+ * only show the cost of the policy itself. bionic allocates the requested
+ * size, which the last column stands in for.
+ *
+ * The reader asks for `kChunk` bytes at a time, as a parser pulling records
+ * would, so the buffer size decides how many `read` syscalls it takes. The
+ * file is warm in the page cache, so the numbers are the syscall and copy
+ * cost only; on a device the read-ahead from the advice comes on top.
+ * Throughput is the median of `kRuns` reads, in MB/s, followed by the number
+ * of `read` syscalls per read of the file (`syscr` in `/proc/self/io`).
+ */
+
+constexpr size_t kSizes[] = {1 << 20, 4 << 20, 16 << 20};
+constexpr int kRuns = 9;
+constexpr size_t kChunk = 512;
+
+struct Variant {
+  const char *name;
+  const char *rule;
+  size_t caller_buffer;
+};
+
+constexpr Variant kVariants[] = {
+    {"default", nullptr, 0},
+    {"64k seq", "64 sequential", 0},
+    {"1m seq", "1024 sequential", 0},
+    {"1m caller", nullptr, 1 << 20},
+};
+
+static std::vector<char> caller_buffer;
+
+static size_t read_all(const std::string &path) {
+  FILE *file = mock_call(fopen, path.c_str(), "r");
+  CHECK(file != nullptr);
+  if (!caller_buffer.empty()) {
+    setvbuf(file, caller_buffer.data(), _IOFBF, caller_buffer.size());
+  }
+  char chunk[kChunk];
+  size_t total = 0;
+  for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) total += n;
+  fclose(file);
+  return total;
+}
+
+// Read syscalls made by this process so far.
+static uint64_t read_syscalls() {
+  FILE *io = fopen("/proc/self/io", "r");
+  CHECK(io != nullptr);
+  char line[128];
+  unsigned long long count = 0;
+  while (fgets(line, sizeof(line), io) != nullptr) {
+    if (sscanf(line, "syscr: %llu", &count) == 1) break;
+  }
+  fclose(io);
+  return count;
+}
+
+static double median_mbps(const std::string &path, size_t size) {
+  std::vector<double> mbps;
+  for (int run = 0; run < kRuns; ++run) {
+    int64_t start = host_now_ns();
+    CHECK(read_all(path) == size);
+    mbps.push_back(size / ((host_now_ns() - start) / 1e3));
+  }
+  std::sort(mbps.begin(), mbps.end());
+  return mbps[kRuns / 2];
+}
+
+int main() {
+  host_load_module();
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureStdioPolicy;
+  config_publish(config);
+
+  char dir_template[] = "/tmp/bench_stdio_policy_XXXXXX";
+  CHECK(mkdtemp(dir_template) != nullptr);
+  std::string dir = dir_template;
+
+  printf("%10s", "bytes");
+  for (const Variant &variant : kVariants) printf(" %18s", variant.name);
+  printf("\n");
+  for (size_t size : kSizes) {
+    std::string path = dir + "/data";
+    FILE *out = fopen(path.c_str(), "w");
+    CHECK(out != nullptr);
+    std::vector<char> bytes(size, 'x');
+    CHECK(fwrite(bytes.data(), 1, size, out) == size);
+    fclose(out);
+
+    printf("%10zu", size);
+    for (const Variant &variant : kVariants) {
+      stdio_policy_configure(
+          variant.rule ? dir + "/ " + variant.rule : std::string());
+      caller_buffer.assign(variant.caller_buffer, 0);
+      // Warm the page cache before the first timed run.
+      uint64_t before = read_syscalls();
+      CHECK(read_all(path) == size);
+      // Less the one `read_syscalls` makes of its own.
+      uint64_t reads = read_syscalls() - before - 1;
+      printf(" %10.0f %7llu", median_mbps(path, size),
+             (unsigned long long)reads);
+    }
+    printf("\n");
+    unlink(path.c_str());
+  }
+  rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "class_profile.hpp"
+#include "host_support.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+// Classes first seen in this run are ordered after those of the loaded
+// profile, instead of being numbered from 0 again.
+
+static unsigned first_use(const std::string &text, const char *name) {
+  size_t at = text.find(std::string(" ") + name + "\n");
+  CHECK(at != std::string::npos);
+  size_t line = text.rfind('\n', at) + 1;
+  unsigned count, use;
+  CHECK(sscanf(&text[line], "%u %u", &count, &use) == 2);
+  return use;
+}
+
+int main() {
+  char path[] = "/tmp/class_profile_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  const char profile[] = "# class profile v1\n"
+                         "8 3 a/Early\n"
+                         "4 40 b/Late\n";
+  CHECK(write(fd, profile, strlen(profile)) == (ssize_t)strlen(profile));
+  close(fd);
+
+  // No loader: the profile is loaded, nothing is preloaded.
+  class_profile_start(host_jni_env(), path, nullptr);
+  class_profile_record("c/New");
+  class_profile_record("a/Early");
+  class_profile_save();
+
+  std::string text;
+  FILE *file = fopen(path, "r");
+  CHECK(file != nullptr);
+  char chunk[256];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) text.append(chunk, n);
+  fclose(file);
+  unlink(path);
+
+  CHECK(first_use(text, "a/Early") == 3);
+  CHECK(first_use(text, "b/Late") == 40);
+  CHECK(first_use(text, "c/New") == 41);
+  return 0;
+}
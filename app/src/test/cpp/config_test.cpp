@@ -0,0 +1,29 @@
+#include "config.hpp"
+#include "host_support.hpp"
+
+// Sampling rates the hooks cannot honor are clamped before anyone sees them.
+
+static uint32_t applied = 0;
+
+int main() {
+  config_set_listener([](const ModuleConfig &config) {
+    applied = config.sample_every;
+  });
+  ModuleConfig config = kDefaultConfig;
+
+  config.sample_every = 0;
+  config_publish(config);
+  CHECK(config_read().sample_every == 1);
+  CHECK(applied == 1);
+
+  // `pushConfig(..., sampleEvery = -1, ...)`
+  config.sample_every = static_cast<uint32_t>(-1);
+  config_publish(config);
+  CHECK(config_read().sample_every == kMaxSampleEvery);
+  CHECK(applied == kMaxSampleEvery);
+
+  config.sample_every = 64;
+  config_publish(config);
+  CHECK(config_read().sample_every == 64);
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include "dlsym_cache.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include <dlfcn.h>
+
+// Lookups on an explicit handle are answered from the table until the next
+// `dlclose`; pseudo-handles always reach the linker.
+
+using LoaderDlsym = void *(*)(void *, const char *, const void *);
+using LoaderDlclose = int (*)(void *);
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  auto loader_dlsym =
+      reinterpret_cast<LoaderDlsym>(dlsym(RTLD_DEFAULT, "__loader_dlsym"));
+  auto loader_dlclose =
+      reinterpret_cast<LoaderDlclose>(dlsym(RTLD_DEFAULT, "__loader_dlclose"));
+  CHECK(loader_dlsym != nullptr && loader_dlclose != nullptr);
+  dlsym_cache_init();
+  dlsym_cache_enable(true);
+  CHECK(mock_replacement(loader_dlsym) != nullptr);
+  CHECK(mock_replacement(loader_dlclose) != nullptr);
+
+  void *libm = dlopen("libm.so.6", RTLD_NOW);
+  CHECK(libm != nullptr);
+  void *cos_address = dlsym(libm, "cos");
+  CHECK(cos_address != nullptr);
+
+  uint64_t calls = host_loader_dlsym_calls();
+  CHECK(mock_call(loader_dlsym, libm, "cos", nullptr) == cos_address);
+  CHECK(mock_call(loader_dlsym, libm, "cos", nullptr) == cos_address);
+  CHECK(host_loader_dlsym_calls() == calls + 1);
+
+  mock_call(loader_dlsym, RTLD_DEFAULT, "cos", nullptr);
+  mock_call(loader_dlsym, RTLD_DEFAULT, "cos", nullptr);
+  CHECK(host_loader_dlsym_calls() == calls + 3);
+
+  // libm stays loaded (this executable needs it), so the handle comes back.
+  CHECK(mock_call(loader_dlclose, libm) == 0);
+  CHECK(dlopen("libm.so.6", RTLD_NOW) == libm);
+  CHECK(mock_call(loader_dlsym, libm, "cos", nullptr) == cos_address);
+  CHECK(host_loader_dlsym_calls() == calls + 4);
+
+  dlsym_cache_enable(false);
+  CHECK(mock_hook_count() == 0);
+  dlclose(libm);
+  return 0;
+}
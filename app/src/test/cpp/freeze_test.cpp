@@ -0,0 +1,108 @@
+#include "config.hpp"
+#include "freeze.hpp"
+#include "fs_cache.hpp"
+#include "host_support.hpp"
+#include "stdio_policy.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// Children forked from a process with the module loaded and its policies
+// configured: none waits for a lock that another thread held at fork time,
+// and none privatizes more than a few pages, either when its state is reset
+// or when it runs hooked calls against the shared tables.
+
+constexpr int kChildren = 100;
+constexpr int kCalls = 1000;
+// Generous: the reset touches about a page per module, and the calls their
+// counters, the child's stack and its heap.
+constexpr long kMaxResetKib = 256;
+constexpr long kMaxCallsKib = 256;
+
+struct ChildDirty {
+  long fork_kib;
+  long reset_kib;
+  long calls_kib;
+};
+
+static ForkMutex held;
+
+// Taken by a fork handler registered before the module's, so that it runs
+// first in the child: what the fork itself privatized.
+static long forked_kib = -1;
+
+static void child(ChildDirty &result) {
+  // Past the module's fork handlers; what they wrote is the difference.
+  long reset = host_private_dirty_kib();
+  held.lock();
+  held.unlock();
+  long before = host_private_dirty_kib();
+  for (int i = 0; i < kCalls; ++i) {
+    FILE *file = mock_call(fopen, "/dev/null", "r");
+    if (file != nullptr) fclose(file);
+    struct stat st;
+    int (*stat_function)(const char *, struct stat *) = stat;
+    mock_call(stat_function, "/proc/self", &st);
+  }
+  result = {forked_kib, reset - forked_kib, host_private_dirty_kib() - before};
+}
+
+int main() {
+  pthread_atfork(nullptr, nullptr,
+                 [] { forked_kib = host_private_dirty_kib(); });
+  host_load_module();
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureFsCache | kFeatureStdioPolicy;
+  config_publish(config);
+  fs_cache_configure("/proc/\n/dev/", 1000);
+  stdio_policy_configure("/dev/ 4 sequential");
+  CHECK(host_private_dirty_kib() >= 0);
+
+  auto *results = static_cast<ChildDirty *>(
+      mmap(nullptr, sizeof(ChildDirty) * kChildren, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  CHECK(results != MAP_FAILED);
+
+  // Held by another thread across every fork.
+  std::atomic<bool> locked{false}, done{false};
+  std::thread holder([&] {
+    held.lock();
+    locked.store(true);
+    while (!done.load()) std::this_thread::yield();
+    held.unlock();
+  });
+  while (!locked.load()) std::this_thread::yield();
+
+  for (int i = 0; i < kChildren; ++i) {
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+      child(results[i]);
+      _exit(0);
+    }
+    int status = 0;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  done.store(true);
+  holder.join();
+
+  long max_fork = 0, max_reset = 0, max_calls = 0;
+  for (int i = 0; i < kChildren; ++i) {
+    CHECK(results[i].fork_kib >= 0);
+    max_fork = std::max(max_fork, results[i].fork_kib);
+    max_reset = std::max(max_reset, results[i].reset_kib);
+    max_calls = std::max(max_calls, results[i].calls_kib);
+  }
+  printf("%d children: private dirty after fork <= %ld KiB, reset +%ld KiB, "
+         "%d calls +%ld KiB\n",
+         kChildren, max_fork, max_reset, kCalls, max_calls);
+  CHECK(max_reset <= kMaxResetKib);
+  CHECK(max_calls <= kMaxCallsKib);
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "config.hpp"
+#include "fs_cache.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The table answers only while every hook that reports writes is live:
+// clearing `fopen` from the enabled hooks, or a watched hook tripping, sends
+// lookups back to the kernel.
+
+static int (*const stat_function)(const char *, struct stat *) = stat;
+
+static int noted() { return 0; }
+static int (*backup_noted)();
+static int fake_noted() { return backup_noted(); }
+static Hook noted_hook{kHookTargetFun, (void *)fake_noted,
+                       (void **)&backup_noted};
+static HookBudget noted_budget{kHookTargetFun, [] {}};
+
+static void touch(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "w");
+  CHECK(file != nullptr);
+  fclose(file);
+}
+
+// Whether `path` looks present through the hooked `stat`.
+static bool present(const std::string &path) {
+  struct stat st;
+  return mock_call(stat_function, path.c_str(), &st) == 0;
+}
+
+int main() {
+  host_load_module();
+  char dir_template[] = "/tmp/fs_cache_testXXXXXX";
+  CHECK(mkdtemp(dir_template) != nullptr);
+  std::string dir = dir_template;
+  std::string file = dir + "/file";
+  fs_cache_configure(dir + "/", 60000);
+  hook_attach(noted_hook, (void *)noted);
+  CHECK(hook_set_rules(noted_hook, 1));
+  fs_cache_watch(noted_hook, 1, noted_budget);
+
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureFsCache;
+  config_publish(config);
+
+  // Removed behind the module's back: the stale answer proves a hit.
+  touch(file);
+  CHECK(present(file));
+  unlink(file.c_str());
+  CHECK(present(file));
+
+  // A write reported by `fopen` drops it.
+  FILE *other = mock_call(fopen, (dir + "/other").c_str(), "w");
+  CHECK(other != nullptr);
+  fclose(other);
+  CHECK(!present(file) && errno == ENOENT);
+
+  // Without the `fopen` hook, nothing is answered from the table.
+  config.enabled_hooks &= ~(1u << kHookFopen);
+  config_publish(config);
+  touch(file);
+  CHECK(present(file));
+  unlink(file.c_str());
+  CHECK(!present(file));
+
+  // Back on: entries from before are gone too.
+  config.enabled_hooks = ~0u;
+  config_publish(config);
+  touch(file);
+  CHECK(present(file));
+  unlink(file.c_str());
+  CHECK(present(file));
+
+  // A tripped hook no longer reports writes.
+  noted_budget.tripped.store(true);
+  CHECK(!present(file));
+  touch(file);
+  CHECK(present(file));
+  unlink(file.c_str());
+  CHECK(!present(file));
+
+  unlink((dir + "/other").c_str());
+  rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include "config.hpp"
+#include "fsync_policy.hpp"
+#include "host_support.hpp"
+#include "quiescence.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+
+// Coalescing is only used when its rule says `unsafe`, and the failure of a
+// deferred sync reaches the caller on its next call. `/dev/null` cannot be
+// synced, so every real sync of it fails with EINVAL. A group leader
+// sleeping out its window holds no quiescence read section.
+
+static int sync_null(int fd) {
+  errno = 0;
+  return mock_call(fsync, fd);
+}
+
+int main() {
+  host_load_module();
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeatureFsyncPolicy;
+  config_publish(config);
+  int fd = open("/dev/null", O_WRONLY);
+  CHECK(fd >= 0);
+
+  // Without `unsafe` the rule is skipped: the call reaches the kernel.
+  fsync_policy_configure("/dev/null coalesce 0");
+  CHECK(sync_null(fd) == -1 && errno == EINVAL);
+  fsync_policy_configure("/dev/null coalesce 0 unsafe please");
+  CHECK(sync_null(fd) == -1 && errno == EINVAL);
+  fsync_policy_configure("/dev/null group 0 unsafe");
+  CHECK(sync_null(fd) == -1 && errno == EINVAL);
+
+  // Deferred: success now, the error on the next call.
+  fsync_policy_configure("/dev/null coalesce 0 unsafe");
+  CHECK(sync_null(fd) == 0);
+  int64_t deadline = host_now_ns() + 2'000'000'000;
+  int result = 0;
+  while (result == 0 && host_now_ns() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    result = sync_null(fd);
+  }
+  CHECK(result == -1 && errno == EINVAL);
+
+  // The leader sleeps for a second; replacing the rules and reclaiming the
+  // old ones meanwhile must not wait for it.
+  fsync_policy_configure("/dev/null group 1000");
+  int group_result = 0, group_error = 0;
+  std::thread leader([&] {
+    group_result = sync_null(fd);
+    group_error = errno;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  int64_t start = host_now_ns();
+  fsync_policy_configure("/dev/null passthrough 0");
+  quiescence_reclaim();
+  CHECK(host_now_ns() - start < 500'000'000);
+  leader.join();
+  CHECK(group_result == -1 && group_error == EINVAL);
+
+  fsync_policy_configure("/dev/null passthrough 0");
+  CHECK(sync_null(fd) == -1 && errno == EINVAL);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "global_refs.hpp"
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Accounting attaches only once every entry is free, and the table is empty
+// again after any order of deletes, round after round.
+
+static jobject (*backup_new_global_ref)(JNIEnv *, jobject);
+
+static jobject other_new_global_ref(JNIEnv *env, jobject object) {
+  return backup_new_global_ref(env, object);
+}
+
+constexpr uint64_t kRefs = 16384;
+constexpr int kRounds = 4;
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  JNINativeInterface *functions = host_jni_functions();
+  JNIEnv *env = host_jni_env();
+  void *new_global_ref = (void *)functions->NewGlobalRef;
+
+  CHECK(hook_install_unmanaged("other", new_global_ref,
+                               (void *)other_new_global_ref,
+                               (void **)&backup_new_global_ref));
+  global_refs_init(functions);
+  global_refs_enable(true);
+  CHECK(mock_replacement(new_global_ref) == (void *)other_new_global_ref);
+
+  CHECK(hook_uninstall_unmanaged("other", new_global_ref));
+  global_refs_enable(false);
+  global_refs_enable(true);
+  CHECK(mock_replacement(new_global_ref) != nullptr);
+  CHECK(mock_replacement(new_global_ref) != (void *)other_new_global_ref);
+
+  std::mt19937_64 random(67);
+  std::vector<jobject> refs(kRefs);
+  for (int round = 0; round < kRounds; ++round) {
+    for (uint64_t i = 0; i < kRefs; ++i) {
+      auto value = (i + 1 + round * kRefs) * 16;
+      refs[i] = mock_call(functions->NewGlobalRef, env,
+                          reinterpret_cast<jobject>(value));
+    }
+    CHECK(global_refs_live() == kRefs);
+
+    std::shuffle(refs.begin(), refs.end(), random);
+    for (uint64_t i = 0; i < kRefs; ++i) {
+      mock_call(functions->DeleteGlobalRef, env, refs[i]);
+      if (i == kRefs / 2) CHECK(global_refs_live() == kRefs - i - 1);
+    }
+    CHECK(global_refs_live() == 0);
+  }
+
+  global_refs_enable(false);
+  CHECK(mock_hook_count() == 0);
+  return 0;
+}
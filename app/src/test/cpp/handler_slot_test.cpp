@@ -0,0 +1,50 @@
+#include "hook_dispatch.hpp"
+#include "host_support.hpp"
+#include "quiescence.hpp"
+#include <thread>
+
+// A call blocked in the backup (a `fopen` on a FIFO, a group-commit wait)
+// holds no read section: switching the slot and synchronizing the
+// quiescence domain both return while it is still blocked.
+
+static std::atomic<bool> blocked{false};
+static std::atomic<bool> release{false};
+
+static int original() {
+  blocked.store(true);
+  while (!release.load()) std::this_thread::yield();
+  return 1;
+}
+static int (*backup_original)() = original;
+
+static int handler() { return call_backup(backup_original) + 1; }
+static HandlerSlot<int()> slot{handler};
+
+static void trip() { slot.exchange(pass_through<backup_original>); }
+static HookBudget budget{kHookTargetFun, trip};
+
+static int fake() { return hook_dispatch(budget, slot, backup_original); }
+
+static void reclaim(void *object) { *static_cast<bool *>(object) = true; }
+
+int main() {
+  int result = 0;
+  std::thread caller([&] { result = fake(); });
+  while (!blocked.load()) std::this_thread::yield();
+
+  trip();
+  CHECK(slot.current() == pass_through<backup_original>);
+  quiescence_synchronize();
+  bool reclaimed = false;
+  quiescence_retire(reclaim, &reclaimed);
+  quiescence_reclaim();
+  CHECK(reclaimed);
+  CHECK(!release.load());
+
+  release.store(true);
+  caller.join();
+  // The call that started before the switch finishes in the old handler.
+  CHECK(result == 2);
+  CHECK(fake() == 1);
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "hook_dispatch.hpp"
+#include "host_support.hpp"
+
+// The reentrancy guard is per hook: a handler that calls its own function
+// reaches the backup, one that calls another hooked function gets that
+// hook's policy, unless it bypasses on purpose.
+
+static int inner() { return 1; }
+static int outer() { return 10; }
+static int (*backup_inner)() = inner;
+static int (*backup_outer)() = outer;
+
+static int inner_handler() { return call_backup(backup_inner) + 100; }
+static HandlerSlot<int()> inner_slot{inner_handler};
+static HookBudget inner_budget{kHookFopen, [] {}};
+static int fake_inner() {
+  return hook_dispatch(inner_budget, inner_slot, backup_inner);
+}
+
+enum Mode { kNested, kSelf, kBypass };
+static Mode mode = kNested;
+
+static int fake_outer();
+
+static int outer_handler() {
+  switch (mode) {
+  case kNested:
+    return fake_inner();
+  case kSelf:
+    return fake_outer();
+  case kBypass: {
+    HookBypass bypass;
+    return fake_inner();
+  }
+  }
+  return 0;
+}
+
+static HandlerSlot<int()> outer_slot{outer_handler};
+static HookBudget outer_budget{kHookFindClass, [] {}};
+static int fake_outer() {
+  return hook_dispatch(outer_budget, outer_slot, backup_outer);
+}
+
+int main() {
+  mode = kNested;
+  CHECK(fake_outer() == 101);
+  CHECK(stat_total(kHookFopen) == 1);
+
+  mode = kSelf;
+  CHECK(fake_outer() == 10);
+  CHECK(stat_total(kHookFindClass) == 2);
+
+  mode = kBypass;
+  CHECK(fake_outer() == 1);
+  CHECK(stat_total(kHookFopen) == 1);
+
+  CHECK(hook_thread_state().in_hook == 0);
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+
+// Hooks follow their rule set, and without an `unhookFunc` they stay
+// installed and the replacement passes through.
+
+static int target() { return 1; }
+static int (*backup_target)();
+static Hook target_hook{kHookTargetFun, nullptr, (void **)&backup_target};
+
+static int fake_target() {
+  int value = backup_target();
+  return hook_rules(target_hook) != 0 ? value + 1 : value;
+}
+
+int main() {
+  target_hook.replace = (void *)fake_target;
+  hook_manager_init(mock_hook_api());
+
+  // Attaching with no rules claims the target but leaves it alone.
+  CHECK(hook_attach(target_hook, (void *)target));
+  CHECK(hook_target_claimed((void *)target));
+  CHECK(mock_replacement(target) == nullptr);
+
+  CHECK(hook_set_rules(target_hook, 1));
+  CHECK(mock_call(target) == 2);
+  CHECK(hook_set_rules(target_hook, 3));
+  CHECK(mock_hook_count() == 1);
+  CHECK(hook_set_rules(target_hook, 0));
+  CHECK(mock_replacement(target) == nullptr);
+  CHECK(mock_call(target) == 1);
+
+  // Unmanaged hooks cannot take a claimed target.
+  CHECK(!hook_install_unmanaged("other", (void *)target, (void *)fake_target,
+                                (void **)&backup_target));
+
+  NativeAPIEntries no_unhook = *mock_hook_api();
+  no_unhook.unhookFunc = nullptr;
+  hook_manager_init(&no_unhook);
+  CHECK(hook_set_rules(target_hook, 1));
+  CHECK(mock_call(target) == 2);
+  CHECK(!hook_set_rules(target_hook, 0));
+  CHECK(mock_replacement(target) != nullptr);
+  CHECK(mock_call(target) == 1);
+  return 0;
+}
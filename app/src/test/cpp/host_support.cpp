@@ -0,0 +1,407 @@
+#include "host_support.hpp"
+#include <android/log.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <mutex>
+#include <sys/system_properties.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" NativeOnModuleLoaded native_init(const NativeAPIEntries *entries);
+extern "C" jint JNI_OnLoad(JavaVM *jvm, void *reserved);
+
+void host_check_failed(const char *expr, const char *file, int line) {
+  fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+  abort();
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Logging
+ * -----------------------------------------------------------------------------
+ */
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt,
+                                   ...) {
+  static const bool enabled = getenv("HOST_TEST_LOG") != nullptr;
+  if (!enabled) return 0;
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "%d %s: ", prio, tag);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+  return 1;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  System properties
+ * -----------------------------------------------------------------------------
+ */
+
+struct prop_info {
+  char name[PROP_NAME_MAX];
+  char value[PROP_VALUE_MAX];
+  std::atomic<uint32_t> serial;
+};
+
+constexpr size_t kMaxProperties = 64;
+
+static prop_info properties[kMaxProperties];
+static size_t property_count = 0;
+static std::mutex property_mutex;
+static std::atomic<uint64_t> property_reads{0};
+
+static prop_info *find_locked(const char *name) {
+  for (size_t i = 0; i < property_count; ++i) {
+    if (strcmp(properties[i].name, name) == 0) return &properties[i];
+  }
+  return nullptr;
+}
+
+void host_property_set(const char *name, const char *value) {
+  std::lock_guard lock(property_mutex);
+  prop_info *info = find_locked(name);
+  if (info == nullptr) {
+    CHECK(property_count < kMaxProperties);
+    info = &properties[property_count++];
+    snprintf(info->name, sizeof(info->name), "%s", name);
+  }
+  snprintf(info->value, sizeof(info->value), "%s", value);
+  info->serial.fetch_add(2, std::memory_order_release);
+}
+
+uint64_t host_property_reads() {
+  return property_reads.load(std::memory_order_relaxed);
+}
+
+extern "C" int __system_property_get(const char *name, char *value) {
+  property_reads.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard lock(property_mutex);
+  prop_info *info = find_locked(name);
+  if (info == nullptr) {
+    value[0] = '\0';
+    return 0;
+  }
+  strcpy(value, info->value);
+  return static_cast<int>(strlen(value));
+}
+
+extern "C" const prop_info *__system_property_find(const char *name) {
+  std::lock_guard lock(property_mutex);
+  return find_locked(name);
+}
+
+extern "C" uint32_t __system_property_serial(const prop_info *info) {
+  return info->serial.load(std::memory_order_acquire);
+}
+
+extern "C" void __system_property_read_callback(
+    const prop_info *info,
+    void (*callback)(void *, const char *, const char *, uint32_t),
+    void *cookie) {
+  std::lock_guard lock(property_mutex);
+  callback(cookie, info->name, info->value,
+           info->serial.load(std::memory_order_relaxed));
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Mock hook API
+ * -----------------------------------------------------------------------------
+ */
+
+// Entries are claimed in order and never released, so lookups can scan
+// without the lock up to the first unused entry.
+struct MockPatch {
+  std::atomic<void *> target{nullptr};
+  std::atomic<void *> replace{nullptr};
+};
+
+constexpr size_t kMaxMockPatches = 128;
+
+static MockPatch patches[kMaxMockPatches];
+static std::mutex hook_mutex;
+
+static MockPatch *find_patch(void *target) {
+  for (auto &patch : patches) {
+    void *patched = patch.target.load(std::memory_order_acquire);
+    if (patched == nullptr) break;
+    if (patched == target) return &patch;
+  }
+  return nullptr;
+}
+
+static int mock_hook(void *target, void *replace, void **backup) {
+  std::lock_guard lock(hook_mutex);
+  MockPatch *patch = find_patch(target);
+  if (patch == nullptr) {
+    for (auto &free_patch : patches) {
+      if (free_patch.target.load(std::memory_order_relaxed) != nullptr) {
+        continue;
+      }
+      free_patch.target.store(target, std::memory_order_release);
+      patch = &free_patch;
+      break;
+    }
+    CHECK(patch != nullptr);
+  }
+  if (patch->replace.load(std::memory_order_relaxed) != nullptr) return -1;
+  *backup = target;
+  patch->replace.store(replace, std::memory_order_release);
+  return 0;
+}
+
+static int mock_unhook(void *target) {
+  std::lock_guard lock(hook_mutex);
+  MockPatch *patch = find_patch(target);
+  if (patch == nullptr) return -1;
+  return patch->replace.exchange(nullptr) != nullptr ? 0 : -1;
+}
+
+const NativeAPIEntries *mock_hook_api() {
+  static const NativeAPIEntries entries{1, mock_hook, mock_unhook};
+  return &entries;
+}
+
+void *mock_replacement(void *target) {
+  MockPatch *patch = find_patch(target);
+  return patch != nullptr ? patch->replace.load(std::memory_order_acquire)
+                          : nullptr;
+}
+
+size_t mock_hook_count() {
+  size_t count = 0;
+  for (auto &patch : patches) {
+    if (patch.replace.load(std::memory_order_relaxed) != nullptr) ++count;
+  }
+  return count;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Linker
+ * -----------------------------------------------------------------------------
+ */
+
+static std::atomic<uint64_t> loader_dlsym_calls{0};
+
+extern "C" [[gnu::visibility("default")]] void *
+__loader_dlsym(void *handle, const char *symbol, const void *) {
+  loader_dlsym_calls.fetch_add(1, std::memory_order_relaxed);
+  return dlsym(handle, symbol);
+}
+
+extern "C" [[gnu::visibility("default")]] int __loader_dlclose(void *handle) {
+  return dlclose(handle);
+}
+
+uint64_t host_loader_dlsym_calls() {
+  return loader_dlsym_calls.load(std::memory_order_relaxed);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  JNI
+ * -----------------------------------------------------------------------------
+ */
+
+static _jclass fake_class;
+
+static jclass find_class(JNIEnv *, const char *) {
+  JniStub<&JNINativeInterface::FindClass>::calls.fetch_add(1);
+  return &fake_class;
+}
+
+static jobject new_global_ref(JNIEnv *, jobject object) {
+  JniStub<&JNINativeInterface::NewGlobalRef>::calls.fetch_add(1);
+  return object;
+}
+
+static jweak new_weak_global_ref(JNIEnv *, jobject object) {
+  JniStub<&JNINativeInterface::NewWeakGlobalRef>::calls.fetch_add(1);
+  return object;
+}
+
+// A `jstring` of the host table: its UTF-16 units.
+struct HostString : _jstring {
+  std::vector<jchar> units;
+};
+
+jstring host_jstring(const char *text) {
+  auto *string = new HostString;
+  for (const char *c = text; *c != '\0'; ++c) {
+    string->units.push_back(static_cast<unsigned char>(*c));
+  }
+  return string;
+}
+
+static jsize get_string_length(JNIEnv *, jstring string) {
+  JniStub<&JNINativeInterface::GetStringLength>::calls.fetch_add(1);
+  if (string == nullptr) return 0;
+  return static_cast<jsize>(static_cast<HostString *>(string)->units.size());
+}
+
+static void get_string_region(JNIEnv *, jstring string, jsize start,
+                              jsize length, jchar *buffer) {
+  JniStub<&JNINativeInterface::GetStringRegion>::calls.fetch_add(1);
+  if (string == nullptr) return;
+  memcpy(buffer, static_cast<HostString *>(string)->units.data() + start,
+         length * sizeof(jchar));
+}
+
+struct HostNative {
+  const char *name;
+  void *fn;
+};
+
+static std::mutex natives_mutex;
+static std::vector<HostNative> natives;
+
+static jint register_natives(JNIEnv *, jclass, const JNINativeMethod *methods,
+                             jint count) {
+  JniStub<&JNINativeInterface::RegisterNatives>::calls.fetch_add(1);
+  std::lock_guard lock(natives_mutex);
+  for (jint i = 0; i < count; ++i) {
+    natives.push_back({methods[i].name, methods[i].fnPtr});
+  }
+  return JNI_OK;
+}
+
+void *host_registered_native(const char *name) {
+  std::lock_guard lock(natives_mutex);
+  for (auto native = natives.rbegin(); native != natives.rend(); ++native) {
+    if (strcmp(native->name, name) == 0) return native->fn;
+  }
+  return nullptr;
+}
+
+static JNINativeInterface make_functions() {
+  JNINativeInterface table{};
+#define HOST_JNI_STUB(name)                                                    \
+  table.name = JniStub<&JNINativeInterface::name>::call;
+  HOST_JNI_STUB(GetVersion)
+  HOST_JNI_STUB(ExceptionOccurred)
+  HOST_JNI_STUB(ExceptionClear)
+  HOST_JNI_STUB(DeleteGlobalRef)
+  HOST_JNI_STUB(DeleteLocalRef)
+  HOST_JNI_STUB(IsSameObject)
+  HOST_JNI_STUB(GetObjectClass)
+  HOST_JNI_STUB(GetMethodID)
+  HOST_JNI_STUB(GetFieldID)
+  HOST_JNI_STUB(GetStaticMethodID)
+  HOST_JNI_STUB(GetStaticFieldID)
+  HOST_JNI_STUB(NewString)
+  HOST_JNI_STUB(GetStringLength)
+  HOST_JNI_STUB(NewStringUTF)
+  HOST_JNI_STUB(GetStringUTFLength)
+  HOST_JNI_STUB(GetStringUTFRegion)
+  HOST_JNI_STUB(GetStringUTFChars)
+  HOST_JNI_STUB(ReleaseStringUTFChars)
+  HOST_JNI_STUB(RegisterNatives)
+  HOST_JNI_STUB(GetJavaVM)
+  HOST_JNI_STUB(GetStringRegion)
+  HOST_JNI_STUB(DeleteWeakGlobalRef)
+  HOST_JNI_STUB(ExceptionCheck)
+  HOST_JNI_STUB(GetDirectBufferAddress)
+  HOST_JNI_STUB(GetDirectBufferCapacity)
+  HOST_JNI_STUB(IsInstanceOf)
+  HOST_JNI_STUB(GetArrayLength)
+  HOST_JNI_STUB(NewByteArray)
+  HOST_JNI_STUB(GetByteArrayRegion)
+  HOST_JNI_STUB(SetByteArrayRegion)
+  HOST_JNI_STUB(GetPrimitiveArrayCritical)
+  HOST_JNI_STUB(ReleasePrimitiveArrayCritical)
+  HOST_JNI_STUB(CallObjectMethodA)
+  HOST_JNI_STUB(CallVoidMethodA)
+  HOST_JNI_STUB(CallStaticObjectMethodA)
+#undef HOST_JNI_STUB
+  table.FindClass = find_class;
+  table.NewGlobalRef = new_global_ref;
+  table.NewWeakGlobalRef = new_weak_global_ref;
+  table.GetStringLength = get_string_length;
+  table.GetStringRegion = get_string_region;
+  table.RegisterNatives = register_natives;
+  return table;
+}
+
+JNINativeInterface *host_jni_functions() {
+  static JNINativeInterface table = make_functions();
+  return &table;
+}
+
+JNIEnv *host_jni_env() {
+  static JNIEnv env{host_jni_functions()};
+  return &env;
+}
+
+static jint get_env(JavaVM *, void **env, jint) {
+  *env = host_jni_env();
+  return JNI_OK;
+}
+
+static jint attach_current_thread(JavaVM *, JNIEnv **env, void *) {
+  *env = host_jni_env();
+  return JNI_OK;
+}
+
+static jint detach_current_thread(JavaVM *) { return JNI_OK; }
+
+JavaVM *host_java_vm() {
+  static const JNIInvokeInterface invoke{
+      .AttachCurrentThread = attach_current_thread,
+      .DetachCurrentThread = detach_current_thread,
+      .GetEnv = get_env,
+      .AttachCurrentThreadAsDaemon = attach_current_thread,
+  };
+  static JavaVM vm{&invoke};
+  return &vm;
+}
+
+NativeOnModuleLoaded host_load_module() {
+  static NativeOnModuleLoaded callback = [] {
+    NativeOnModuleLoaded loaded = native_init(mock_hook_api());
+    JNI_OnLoad(host_java_vm(), nullptr);
+    return loaded;
+  }();
+  return callback;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  Measurement
+ * -----------------------------------------------------------------------------
+ */
+
+int64_t host_now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long host_rss_kib() {
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) return -1;
+  long size = 0, resident = 0;
+  int fields = fscanf(file, "%ld %ld", &size, &resident);
+  fclose(file);
+  return fields == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+long host_private_dirty_kib() {
+  FILE *file = fopen("/proc/self/smaps_rollup", "r");
+  if (file == nullptr) return -1;
+  char line[128];
+  long kib = -1;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    if (sscanf(line, "Private_Dirty: %ld kB", &kib) == 1) break;
+  }
+  fclose(file);
+  return kib;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "native_api.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <jni.h>
+#include <type_traits>
+
+/*
+ * =========================================================================================
+ *  Host test support
+ * =========================================================================================
+ *
+ * The module's sources build unchanged for the host against the stand-in
+ * headers in `include/`. This file supplies what those headers declare and
+ * what LSPosed would provide on a device:
+ *
+ *   __android_log_print       writes to stderr when HOST_TEST_LOG is set
+ *   __system_property_*       a small in-memory property store
+ *   __loader_dlsym/dlclose    the linker's entry points, forwarding to
+ *                             `dlsym`/`dlclose` (found by `dlsym` only in
+ *                             tests built with `ENABLE_EXPORTS`)
+ *   mock_hook_api()           a `NativeAPIEntries` whose `hookFunc` records
+ *                             target -> replacement instead of patching and
+ *                             hands out the target itself as the backup
+ *   host_jni_functions()      a JNI function table of distinct stubs that
+ *                             count their calls, and a `JavaVM` serving it;
+ *                             its strings come from `host_jstring`, and it
+ *                             records what `RegisterNatives` binds
+ *   host_load_module()        `native_init` and `JNI_OnLoad`, as on a device
+ *
+ * With the mock API, "calling the hooked function" means calling
+ * `mock_replacement(target)`, which runs the module's real replacement and,
+ * through the backup, the real target. Tests are plain executables that
+ * return non-zero (or abort on a failed `CHECK`) on failure.
+ */
+
+#define CHECK(cond)                                                            \
+  ((cond) ? (void)0 : host_check_failed(#cond, __FILE__, __LINE__))
+
+[[noreturn]] void host_check_failed(const char *expr, const char *file,
+                                    int line);
+
+/**
+ * @brief Sets (or adds) a system property and bumps its serial.
+ */
+void host_property_set(const char *name, const char *value);
+
+/**
+ * @brief Number of `__system_property_get` calls that reached the store.
+ */
+uint64_t host_property_reads();
+
+/**
+ * @brief Number of calls that reached the `__loader_dlsym` stand-in.
+ */
+uint64_t host_loader_dlsym_calls();
+
+const NativeAPIEntries *mock_hook_api();
+
+/**
+ * @brief The replacement currently installed on `target`, or nullptr.
+ */
+void *mock_replacement(void *target);
+
+template <typename Fn> Fn mock_replacement(Fn target) {
+  void *replace = mock_replacement(reinterpret_cast<void *>(target));
+  return reinterpret_cast<Fn>(replace);
+}
+
+/**
+ * @brief Number of hooks currently installed through `mock_hook_api`.
+ */
+size_t mock_hook_count();
+
+/**
+ * @brief Calls `target` the way a caller of the patched function would: the
+ *        replacement if one is installed, the target itself otherwise.
+ */
+template <typename R, typename... Params, typename... Args>
+R mock_call(R (*target)(Params...), Args... args) {
+  R (*replace)(Params...) = mock_replacement(target);
+  return (replace != nullptr ? replace : target)(args...);
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ *  JNI
+ * -----------------------------------------------------------------------------
+ */
+
+template <auto Member> struct JniStub;
+
+// One distinct function per table entry, so that hooks on different entries
+// never share a target. Returns a value-initialized result, except where
+// `host_support.cpp` sets a more useful entry.
+template <typename R, typename... Args,
+          R (*JNINativeInterface::*Member)(JNIEnv *, Args...)>
+struct JniStub<Member> {
+  static inline std::atomic<uint64_t> calls{0};
+
+  static R call(JNIEnv *, Args...) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    if constexpr (!std::is_void_v<R>) return R{};
+  }
+};
+
+/**
+ * @brief Calls of the host table's entry `Member` so far.
+ */
+template <auto Member> uint64_t host_jni_calls() {
+  return JniStub<Member>::calls.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief The host JNI function table. Entries may be replaced before
+ *        `host_load_module`.
+ */
+JNINativeInterface *host_jni_functions();
+
+JNIEnv *host_jni_env();
+JavaVM *host_java_vm();
+
+/**
+ * @brief A `jstring` of the host table with the characters of `text`, which
+ *        must be ASCII. Never freed.
+ */
+jstring host_jstring(const char *text);
+
+/**
+ * @brief The function most recently bound to `name` through the host
+ *        table's `RegisterNatives`, or nullptr.
+ */
+void *host_registered_native(const char *name);
+
+/**
+ * @brief Runs `native_init` with `mock_hook_api()` and then `JNI_OnLoad`
+ *        with `host_java_vm()`, once per process.
+ *
+ * @return The library-load callback returned by `native_init`.
+ */
+NativeOnModuleLoaded host_load_module();
+
+/**
+ * @brief Monotonic time in nanoseconds, for benchmarks.
+ */
+int64_t host_now_ns();
+
+/**
+ * @brief Resident set size of this process in KiB.
+ */
+long host_rss_kib();
+
+/**
+ * @brief Private dirty memory of this process in KiB, from
+ *        `/proc/self/smaps_rollup`: pages that are not, or no longer, shared
+ *        with the file they map or with a parent process.
+ */
+long host_private_dirty_kib();
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the NDK's <android/log.h>; see `host_support.cpp`.
+
+enum {
+  ANDROID_LOG_VERBOSE = 2,
+  ANDROID_LOG_DEBUG,
+  ANDROID_LOG_INFO,
+  ANDROID_LOG_WARN,
+  ANDROID_LOG_ERROR,
+  ANDROID_LOG_FATAL,
+};
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt,
+                                   ...) __attribute__((format(printf, 3, 4)));
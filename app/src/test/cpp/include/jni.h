@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+
+/*
+ * Host stand-in for the NDK's <jni.h>, with just the types and function table
+ * entries the module uses. The real `JNINativeInterface` has a few hundred
+ * entries in a fixed order; tests fill their tables by member name, so the
+ * order here does not matter.
+ */
+
+typedef uint8_t jboolean;
+typedef int8_t jbyte;
+typedef uint16_t jchar;
+typedef int16_t jshort;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef float jfloat;
+typedef double jdouble;
+typedef jint jsize;
+
+class _jobject {};
+class _jclass : public _jobject {};
+class _jstring : public _jobject {};
+class _jthrowable : public _jobject {};
+class _jarray : public _jobject {};
+class _jbyteArray : public _jarray {};
+
+typedef _jobject *jobject;
+typedef _jclass *jclass;
+typedef _jstring *jstring;
+typedef _jthrowable *jthrowable;
+typedef _jarray *jarray;
+typedef _jbyteArray *jbyteArray;
+typedef jobject jweak;
+
+union jvalue {
+  jboolean z;
+  jbyte b;
+  jchar c;
+  jshort s;
+  jint i;
+  jlong j;
+  jfloat f;
+  jdouble d;
+  jobject l;
+};
+
+struct _jmethodID;
+typedef _jmethodID *jmethodID;
+struct _jfieldID;
+typedef _jfieldID *jfieldID;
+
+typedef struct {
+  const char *name;
+  const char *signature;
+  void *fnPtr;
+} JNINativeMethod;
+
+#define JNI_VERSION_1_6 0x00010006
+#define JNI_OK 0
+#define JNI_ERR (-1)
+#define JNI_EDETACHED (-2)
+#define JNI_TRUE 1
+#define JNI_FALSE 0
+#define JNIEXPORT __attribute__((visibility("default")))
+#define JNICALL
+
+struct _JNIEnv;
+struct _JavaVM;
+typedef _JNIEnv JNIEnv;
+typedef _JavaVM JavaVM;
+
+struct JNINativeInterface {
+  void *reserved0;
+  jint (*GetVersion)(JNIEnv *);
+  jclass (*FindClass)(JNIEnv *, const char *);
+  jthrowable (*ExceptionOccurred)(JNIEnv *);
+  void (*ExceptionClear)(JNIEnv *);
+  jobject (*NewGlobalRef)(JNIEnv *, jobject);
+  void (*DeleteGlobalRef)(JNIEnv *, jobject);
+  void (*DeleteLocalRef)(JNIEnv *, jobject);
+  jboolean (*IsSameObject)(JNIEnv *, jobject, jobject);
+  jclass (*GetObjectClass)(JNIEnv *, jobject);
+  jmethodID (*GetMethodID)(JNIEnv *, jclass, const char *, const char *);
+  jobject (*CallObjectMethod)(JNIEnv *, jobject, jmethodID, ...);
+  void (*CallVoidMethod)(JNIEnv *, jobject, jmethodID, ...);
+  jfieldID (*GetFieldID)(JNIEnv *, jclass, const char *, const char *);
+  jmethodID (*GetStaticMethodID)(JNIEnv *, jclass, const char *,
+                                 const char *);
+  jfieldID (*GetStaticFieldID)(JNIEnv *, jclass, const char *, const char *);
+  jstring (*NewString)(JNIEnv *, const jchar *, jsize);
+  jsize (*GetStringLength)(JNIEnv *, jstring);
+  jstring (*NewStringUTF)(JNIEnv *, const char *);
+  jsize (*GetStringUTFLength)(JNIEnv *, jstring);
+  void (*GetStringUTFRegion)(JNIEnv *, jstring, jsize, jsize, char *);
+  const char *(*GetStringUTFChars)(JNIEnv *, jstring, jboolean *);
+  void (*ReleaseStringUTFChars)(JNIEnv *, jstring, const char *);
+  jint (*RegisterNatives)(JNIEnv *, jclass, const JNINativeMethod *, jint);
+  jint (*GetJavaVM)(JNIEnv *, JavaVM **);
+  void (*GetStringRegion)(JNIEnv *, jstring, jsize, jsize, jchar *);
+  jweak (*NewWeakGlobalRef)(JNIEnv *, jobject);
+  void (*DeleteWeakGlobalRef)(JNIEnv *, jweak);
+  jboolean (*ExceptionCheck)(JNIEnv *);
+  void *(*GetDirectBufferAddress)(JNIEnv *, jobject);
+  jlong (*GetDirectBufferCapacity)(JNIEnv *, jobject);
+  jboolean (*IsInstanceOf)(JNIEnv *, jobject, jclass);
+  jsize (*GetArrayLength)(JNIEnv *, jarray);
+  jbyteArray (*NewByteArray)(JNIEnv *, jsize);
+  void (*GetByteArrayRegion)(JNIEnv *, jbyteArray, jsize, jsize, jbyte *);
+  void (*SetByteArrayRegion)(JNIEnv *, jbyteArray, jsize, jsize,
+                             const jbyte *);
+  void *(*GetPrimitiveArrayCritical)(JNIEnv *, jarray, jboolean *);
+  void (*ReleasePrimitiveArrayCritical)(JNIEnv *, jarray, void *, jint);
+  jobject (*CallObjectMethodA)(JNIEnv *, jobject, jmethodID, const jvalue *);
+  void (*CallVoidMethodA)(JNIEnv *, jobject, jmethodID, const jvalue *);
+  jobject (*CallStaticObjectMethodA)(JNIEnv *, jclass, jmethodID,
+                                     const jvalue *);
+};
+
+struct _JNIEnv {
+  const JNINativeInterface *functions;
+
+  jclass FindClass(const char *name) {
+    return functions->FindClass(this, name);
+  }
+  void ExceptionClear() { functions->ExceptionClear(this); }
+  jboolean ExceptionCheck() { return functions->ExceptionCheck(this); }
+  jobject NewGlobalRef(jobject object) {
+    return functions->NewGlobalRef(this, object);
+  }
+  void DeleteGlobalRef(jobject object) {
+    functions->DeleteGlobalRef(this, object);
+  }
+  void DeleteLocalRef(jobject object) {
+    functions->DeleteLocalRef(this, object);
+  }
+  jboolean IsSameObject(jobject a, jobject b) {
+    return functions->IsSameObject(this, a, b);
+  }
+  jclass GetObjectClass(jobject object) {
+    return functions->GetObjectClass(this, object);
+  }
+  jmethodID GetMethodID(jclass clazz, const char *name, const char *sig) {
+    return functions->GetMethodID(this, clazz, name, sig);
+  }
+  jobject CallObjectMethodA(jobject object, jmethodID method,
+                            const jvalue *args) {
+    return functions->CallObjectMethodA(this, object, method, args);
+  }
+  jint GetJavaVM(JavaVM **vm) { return functions->GetJavaVM(this, vm); }
+  jstring NewStringUTF(const char *chars) {
+    return functions->NewStringUTF(this, chars);
+  }
+  jsize GetStringLength(jstring string) {
+    return functions->GetStringLength(this, string);
+  }
+  void GetStringRegion(jstring string, jsize start, jsize length,
+                       jchar *buffer) {
+    functions->GetStringRegion(this, string, start, length, buffer);
+  }
+  jint RegisterNatives(jclass clazz, const JNINativeMethod *methods,
+                       jint count) {
+    return functions->RegisterNatives(this, clazz, methods, count);
+  }
+  jweak NewWeakGlobalRef(jobject object) {
+    return functions->NewWeakGlobalRef(this, object);
+  }
+  void DeleteWeakGlobalRef(jweak object) {
+    functions->DeleteWeakGlobalRef(this, object);
+  }
+};
+
+struct JNIInvokeInterface {
+  void *reserved0;
+  void *reserved1;
+  void *reserved2;
+  jint (*DestroyJavaVM)(JavaVM *);
+  jint (*AttachCurrentThread)(JavaVM *, JNIEnv **, void *);
+  jint (*DetachCurrentThread)(JavaVM *);
+  jint (*GetEnv)(JavaVM *, void **, jint);
+  jint (*AttachCurrentThreadAsDaemon)(JavaVM *, JNIEnv **, void *);
+};
+
+struct _JavaVM {
+  const JNIInvokeInterface *functions;
+
+  jint AttachCurrentThread(JNIEnv **env, void *args) {
+    return functions->AttachCurrentThread(this, env, args);
+  }
+  jint AttachCurrentThreadAsDaemon(JNIEnv **env, void *args) {
+    return functions->AttachCurrentThreadAsDaemon(this, env, args);
+  }
+  jint DetachCurrentThread() { return functions->DetachCurrentThread(this); }
+  jint GetEnv(void **env, jint version) {
+    return functions->GetEnv(this, env, version);
+  }
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Host stand-in for bionic's <sys/system_properties.h>, backed by the fake
+// property store in `host_support.cpp`.
+
+#define PROP_NAME_MAX 32
+#define PROP_VALUE_MAX 92
+
+struct prop_info;
+
+extern "C" {
+int __system_property_get(const char *name, char *value);
+const prop_info *__system_property_find(const char *name);
+uint32_t __system_property_serial(const prop_info *info);
+void __system_property_read_callback(
+    const prop_info *info,
+    void (*callback)(void *cookie, const char *name, const char *value,
+                     uint32_t serial),
+    void *cookie);
+}
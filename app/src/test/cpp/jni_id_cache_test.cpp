@@ -0,0 +1,30 @@
+#include "hook_manager.hpp"
+#include "host_support.hpp"
+#include "jni_id_cache.hpp"
+#include "jni_profiler.hpp"
+
+// While another hook holds the `Get*ID` entries, enabling the cache cannot
+// attach; it does once they are free again.
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  JNINativeInterface *functions = host_jni_functions();
+  jni_profiler_init(functions);
+  jni_profiler_select(kJniProfileAll);
+  void *profiler = mock_replacement((void *)functions->GetMethodID);
+  CHECK(profiler != nullptr);
+
+  jni_id_cache_init(host_java_vm(), functions);
+  jni_id_cache_enable(true);
+  CHECK(mock_replacement((void *)functions->GetMethodID) == profiler);
+
+  jni_profiler_select(0);
+  jni_id_cache_enable(false);
+  jni_id_cache_enable(true);
+  void *cache = mock_replacement((void *)functions->GetMethodID);
+  CHECK(cache != nullptr && cache != profiler);
+  CHECK(mock_replacement((void *)functions->GetStaticFieldID) != nullptr);
+  jni_id_cache_enable(false);
+  CHECK(mock_hook_count() == 0);
+  return 0;
+}
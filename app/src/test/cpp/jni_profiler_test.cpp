@@ -0,0 +1,60 @@
+#include "config.hpp"
+#include "hook_manager.hpp"
+#include "hook_thread.hpp"
+#include "host_support.hpp"
+#include "jni_profiler.hpp"
+
+// The profiler wraps the selected entries of a JNI function table, except
+// entries another hook claimed, always reaches the backup, and samples on a
+// countdown of its own.
+
+static jclass (*backup_find_class)(JNIEnv *, const char *);
+static jclass fake_find_class(JNIEnv *env, const char *name) {
+  return backup_find_class(env, name);
+}
+static Hook find_class_hook{kHookFindClass, (void *)fake_find_class,
+                            (void **)&backup_find_class};
+
+int main() {
+  hook_manager_init(mock_hook_api());
+  JNINativeInterface *functions = host_jni_functions();
+  JNIEnv *env = host_jni_env();
+  CHECK(hook_attach(find_class_hook, (void *)functions->FindClass));
+  ModuleConfig config = kDefaultConfig;
+  config.sample_every = 4;
+  config_publish(config);
+
+  // The selection waits for the table.
+  jni_profiler_select(kJniProfileAll);
+  CHECK(mock_replacement(functions->GetArrayLength) == nullptr);
+  jni_profiler_init(functions);
+  CHECK(mock_replacement(functions->GetArrayLength) != nullptr);
+  CHECK(mock_replacement(functions->NewStringUTF) != nullptr);
+  CHECK(mock_replacement(functions->FindClass) == nullptr);
+
+  HookThreadState &state = hook_thread_state();
+  state.countdown = 1000;
+  uint64_t before = host_jni_calls<&JNINativeInterface::GetArrayLength>();
+  for (int i = 0; i < 10; ++i) {
+    mock_call(functions->GetArrayLength, env, jarray{});
+  }
+  CHECK(host_jni_calls<&JNINativeInterface::GetArrayLength>() == before + 10);
+  // Calls 1, 5 and 9 were sampled; the watchdog's countdown did not move.
+  CHECK(state.profile_countdown == 3);
+  CHECK(!state.profiling);
+  CHECK(state.countdown == 1000);
+
+  // JNI calls our own code makes are not the app's.
+  {
+    HookBypass bypass;
+    mock_call(functions->GetArrayLength, env, jarray{});
+  }
+  CHECK(state.profile_countdown == 3);
+  CHECK(host_jni_calls<&JNINativeInterface::GetArrayLength>() == before + 11);
+
+  jni_profiler_report();
+  jni_profiler_select(0);
+  CHECK(mock_replacement(functions->GetArrayLength) == nullptr);
+  CHECK(mock_hook_count() == 0);
+  return 0;
+}
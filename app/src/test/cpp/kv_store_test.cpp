@@ -0,0 +1,56 @@
+#include "host_support.hpp"
+#include "kv_store.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Lookups stay bounded when the writer died mid-write, the next write heals
+// the slot, and the `fopen` hook follows the store's setting.
+
+static KvSlot &slot_of(int fd, std::string_view key) {
+  auto *base = static_cast<uint8_t *>(
+      mmap(nullptr, kKvFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  CHECK(base != MAP_FAILED);
+  auto *slots = reinterpret_cast<KvSlot *>(base + sizeof(KvHeader));
+  for (uint32_t i = 0; i < kKvCapacity; ++i) {
+    if (slots[i].type.load() != kKvEmpty &&
+        memcmp(slots[i].key, key.data(), key.size()) == 0) {
+      return slots[i];
+    }
+  }
+  host_check_failed("key not found", __FILE__, __LINE__);
+}
+
+int main() {
+  char path[] = "/tmp/kv_store_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  unlink(path);
+  KvStore &store = module_settings();
+  CHECK(store.map(fd, true));
+  CHECK(store.put("test", {kKvLong, 7}));
+  CHECK(store.get_long("test", -1) == 7);
+
+  // A writer that died between its two sequence stores.
+  KvSlot &slot = slot_of(fd, "test");
+  slot.seq.fetch_add(1);
+  CHECK(store.get_long("test", -1) == -1);
+  CHECK(store.put("test", {kKvLong, 8}));
+  CHECK(slot.seq.load() % 2 == 0);
+  CHECK(store.get_long("test", -1) == 8);
+
+  char banned[] = "/tmp/banned_XXXXXX";
+  int banned_fd = mkstemp(banned);
+  CHECK(banned_fd >= 0);
+  close(banned_fd);
+  host_load_module();
+  CHECK(mock_call(fopen, banned, "r") == nullptr);
+  CHECK(store.put("fopen_block_banned", {kKvBool, 0}));
+  FILE *file = mock_call(fopen, banned, "r");
+  CHECK(file != nullptr);
+  fclose(file);
+  unlink(banned);
+  return 0;
+}
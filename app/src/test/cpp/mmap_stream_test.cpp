@@ -0,0 +1,97 @@
+#include "host_support.hpp"
+#include "mmap_stream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// A mapped stream behaves like the stdio stream `backup_fopen` would return:
+// the same random sequence of reads, seeks and position queries gives the
+// same bytes and results on both. Opens the mapping cannot serve fall back.
+
+constexpr size_t kFileSize = 200'003;
+constexpr int kOps = 20000;
+constexpr size_t kMaxRead = 9000;
+
+static void check_same(FILE *mapped, FILE *plain, std::mt19937 &random) {
+  std::vector<char> a(kMaxRead), b(kMaxRead);
+  for (int op = 0; op < kOps; ++op) {
+    switch (random() % 6) {
+    case 0: {
+      size_t size = random() % kMaxRead;
+      size_t got = fread(a.data(), 1, size, mapped);
+      CHECK(got == fread(b.data(), 1, size, plain));
+      CHECK(std::equal(a.begin(), a.begin() + got, b.begin()));
+      break;
+    }
+    case 1:
+      CHECK(fgetc(mapped) == fgetc(plain));
+      break;
+    case 2: {
+      static constexpr int kWhence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+      int whence = kWhence[random() % 3];
+      long offset = static_cast<long>(random() % (2 * kFileSize)) -
+                    static_cast<long>(kFileSize / 2);
+      int result = fseek(mapped, offset, whence);
+      CHECK(result == fseek(plain, offset, whence));
+      break;
+    }
+    case 3:
+      CHECK(ftell(mapped) == ftell(plain));
+      break;
+    case 4:
+      CHECK(!feof(mapped) == !feof(plain));
+      break;
+    case 5:
+      rewind(mapped);
+      rewind(plain);
+      break;
+    }
+  }
+}
+
+int main() {
+  char dir_template[] = "/tmp/mmap_stream_testXXXXXX";
+  CHECK(mkdtemp(dir_template) != nullptr);
+  std::string dir = dir_template;
+  std::string path = dir + "/asset";
+  std::string small = dir + "/small";
+
+  std::mt19937 random(7);
+  std::vector<char> bytes(kFileSize);
+  for (char &byte : bytes) byte = static_cast<char>(random());
+  FILE *out = fopen(path.c_str(), "w");
+  CHECK(out != nullptr);
+  CHECK(fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size());
+  fclose(out);
+  out = fopen(small.c_str(), "w");
+  CHECK(out != nullptr && fputs("tiny", out) >= 0);
+  fclose(out);
+
+  mmap_stream_configure(dir + "/", 64);
+  FILE *mapped = mmap_stream_open(path.c_str(), "rbe");
+  FILE *plain = fopen(path.c_str(), "r");
+  CHECK(mapped != nullptr && plain != nullptr);
+  check_same(mapped, plain, random);
+  CHECK(fclose(mapped) == 0);
+  fclose(plain);
+
+  // Left to `backup_fopen`, with `errno` untouched.
+  errno = 1234;
+  CHECK(mmap_stream_open(path.c_str(), "r+") == nullptr);
+  CHECK(mmap_stream_open(small.c_str(), "r") == nullptr);
+  CHECK(mmap_stream_open((dir + "/./asset").c_str(), "r") == nullptr);
+  CHECK(mmap_stream_open((dir + "/missing").c_str(), "r") == nullptr);
+  CHECK(mmap_stream_open("/etc/hostname", "r") == nullptr);
+  CHECK(errno == 1234);
+
+  mmap_stream_configure("", 0);
+  CHECK(mmap_stream_open(path.c_str(), "r") == nullptr);
+  unlink(path.c_str());
+  unlink(small.c_str());
+  rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include "host_support.hpp"
+#include "mutf8.hpp"
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Differential fuzz test of the transcoders against scalar ports of ART's
+// `ConvertModifiedUtf8ToUtf16` and `ConvertUtf16ToModifiedUtf8`. Whatever
+// the decoder accepts must decode like ART, the encoder must match ART on
+// any UTF-16 input, and overlong forms must be rejected.
+
+static std::vector<uint16_t> art_decode(const std::vector<uint8_t> &in) {
+  std::vector<uint16_t> out;
+  for (size_t i = 0; i < in.size();) {
+    uint8_t one = in[i++];
+    if ((one & 0x80) == 0) {
+      out.push_back(one);
+      continue;
+    }
+    uint8_t two = in[i++];
+    if ((one & 0x20) == 0) {
+      out.push_back(((one & 0x1f) << 6) | (two & 0x3f));
+      continue;
+    }
+    uint8_t three = in[i++];
+    if ((one & 0x10) == 0) {
+      out.push_back(((one & 0x0f) << 12) | ((two & 0x3f) << 6) |
+                    (three & 0x3f));
+      continue;
+    }
+    uint8_t four = in[i++];
+    uint32_t code = ((one & 0x0f) << 18) | ((two & 0x3f) << 12) |
+                    ((three & 0x3f) << 6) | (four & 0x3f);
+    out.push_back((code >> 10) + 0xd7c0);
+    out.push_back((code & 0x3ff) + 0xdc00);
+  }
+  return out;
+}
+
+static std::vector<uint8_t> art_encode(const std::vector<uint16_t> &in) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < in.size(); ++i) {
+    uint32_t ch = in[i];
+    if (ch != 0 && ch <= 0x7f) {
+      out.push_back(ch);
+    } else if (ch <= 0x7ff) {
+      out.push_back(0xc0 | (ch >> 6));
+      out.push_back(0x80 | (ch & 0x3f));
+    } else if (ch >= 0xd800 && ch <= 0xdbff && i + 1 < in.size() &&
+               in[i + 1] >= 0xdc00 && in[i + 1] <= 0xdfff) {
+      uint32_t code = ((ch - 0xd800) << 10) + (in[++i] - 0xdc00) + 0x10000;
+      out.push_back(0xf0 | (code >> 18));
+      out.push_back(0x80 | ((code >> 12) & 0x3f));
+      out.push_back(0x80 | ((code >> 6) & 0x3f));
+      out.push_back(0x80 | (code & 0x3f));
+    } else {
+      out.push_back(0xe0 | (ch >> 12));
+      out.push_back(0x80 | ((ch >> 6) & 0x3f));
+      out.push_back(0x80 | (ch & 0x3f));
+    }
+  }
+  return out;
+}
+
+static ptrdiff_t decode(const std::vector<uint8_t> &in,
+                        std::vector<uint16_t> &out) {
+  out.resize(in.size());
+  ptrdiff_t n = mutf8_to_utf16(reinterpret_cast<const char *>(in.data()),
+                               in.size(), out.data());
+  if (n >= 0) out.resize(n);
+  return n;
+}
+
+static std::vector<uint8_t> encode(const std::vector<uint16_t> &in) {
+  std::vector<uint8_t> out(4 * in.size());
+  ptrdiff_t n = utf16_to_mutf8(in.data(), in.size(),
+                               reinterpret_cast<char *>(out.data()),
+                               out.size());
+  CHECK(n >= 0);
+  out.resize(n);
+  return out;
+}
+
+static bool rejected(std::vector<uint8_t> bytes) {
+  std::vector<uint16_t> units;
+  return decode(bytes, units) < 0;
+}
+
+// Appends `code` in `size` bytes, overlong if `size` is larger than needed.
+static void put(std::vector<uint8_t> &out, uint32_t code, int size) {
+  static const uint8_t kLead[] = {0, 0, 0xc0, 0xe0, 0xf0};
+  out.push_back(kLead[size] | (code >> (6 * (size - 1))));
+  for (int k = size - 2; k >= 0; --k) {
+    out.push_back(0x80 | ((code >> (6 * k)) & 0x3f));
+  }
+}
+
+int main() {
+  CHECK(!rejected({0xc0, 0x80}));
+  CHECK(rejected({0xc0, 0x81}));
+  CHECK(rejected({0xc1, 0xbf}));
+  CHECK(rejected({0xe0, 0x80, 0x80}));
+  CHECK(rejected({0xe0, 0x9f, 0xbf}));
+  CHECK(!rejected({0xe0, 0xa0, 0x80}));
+  CHECK(rejected({0xf0, 0x8f, 0xbf, 0xbf}));
+  CHECK(!rejected({0xf0, 0x90, 0x80, 0x80}));
+  CHECK(!rejected({0xf4, 0x8f, 0xbf, 0xbf}));
+  CHECK(rejected({0xf4, 0x90, 0x80, 0x80}));
+  CHECK(rejected({0xed, 0xa0}));
+  // The JVM's 6-byte form of a pair, two 3-byte surrogates, is well formed.
+  CHECK(!rejected({0xed, 0xa0, 0x80, 0xed, 0xb0, 0x80}));
+
+  std::mt19937 random(1);
+  auto below = [&](uint32_t n) { return random() % n; };
+  std::vector<uint8_t> bytes;
+  std::vector<uint16_t> units;
+  uint64_t accepted = 0;
+  for (int round = 0; round < 200000; ++round) {
+    // Bytes: ASCII runs long enough for the vector paths, encoded code
+    // points (some overlong), and raw bytes.
+    bytes.clear();
+    for (uint32_t parts = below(12); parts > 0; --parts) {
+      switch (below(4)) {
+      case 0:
+        for (uint32_t n = below(40); n > 0; --n) {
+          bytes.push_back(1 + below(127));
+        }
+        break;
+      case 1: {
+        static const uint32_t kTop[] = {0x80, 0x800, 0x10000, 0x110000};
+        int size = 2 + below(3);
+        uint32_t code = below(kTop[size - 1]);
+        if (below(8) == 0 && size > 2) size = 2 + below(size - 1);
+        put(bytes, code, size);
+        break;
+      }
+      case 2:
+        put(bytes, below(0x10000), 3);
+        break;
+      default:
+        bytes.push_back(below(256));
+      }
+    }
+    if (decode(bytes, units) >= 0) {
+      ++accepted;
+      CHECK(units == art_decode(bytes));
+      // Not `bytes` itself: a pair may have come as two 3-byte surrogates.
+      std::vector<uint16_t> again;
+      CHECK(decode(encode(units), again) >= 0 && again == units);
+    }
+
+    // Units: ASCII runs and arbitrary units, including lone surrogates.
+    units.clear();
+    for (uint32_t n = below(64); n > 0; --n) {
+      units.push_back(below(3) == 0 ? below(0x10000) : 1 + below(127));
+    }
+    std::vector<uint8_t> encoded = encode(units);
+    CHECK(encoded == art_encode(units));
+    std::vector<uint16_t> decoded;
+    CHECK(decode(encoded, decoded) >= 0);
+    CHECK(decoded == units);
+  }
+  CHECK(accepted > 10000);
+  return 0;
+}
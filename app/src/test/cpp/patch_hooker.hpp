@@ -0,0 +1,80 @@
+#pragma once
+
+#include "native_api.hpp"
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * A `NativeAPIEntries` that really patches code, for the functions of the
+ * synthetic library (see `CMakeLists.txt`), each compiled with a pad of nops
+ * at its entry. `patch_hook` stands in for the framework's `hookFunc`: it
+ * rewrites the pad into an absolute jump to the replacement and hands out
+ * the code after the pad as the backup, so no instruction has to be
+ * relocated. `patch_unhook` writes the nops back.
+ *
+ * Defines `HOST_PATCH_HOOKER` on the architectures it supports.
+ */
+
+#if defined(__x86_64__)
+#define HOST_PATCH_HOOKER 1
+constexpr size_t kPadBytes = 16;
+// movabs r11, imm64; jmp r11
+inline void write_jump(uint8_t *at, void *to) {
+  static const uint8_t kMovabs[] = {0x49, 0xbb};
+  static const uint8_t kJmp[] = {0x41, 0xff, 0xe3};
+  memcpy(at, kMovabs, sizeof(kMovabs));
+  memcpy(at + 2, &to, sizeof(to));
+  memcpy(at + 10, kJmp, sizeof(kJmp));
+}
+inline void write_pad(uint8_t *at) { memset(at, 0x90, kPadBytes); }
+#elif defined(__aarch64__)
+#define HOST_PATCH_HOOKER 1
+constexpr size_t kPadBytes = 64;
+// ldr x16, #8; br x16; .quad to
+inline void write_jump(uint8_t *at, void *to) {
+  static const uint32_t kCode[] = {0x58000050, 0xd61f0200};
+  memcpy(at, kCode, sizeof(kCode));
+  memcpy(at + sizeof(kCode), &to, sizeof(to));
+}
+inline void write_pad(uint8_t *at) {
+  static const uint32_t kNop = 0xd503201f;
+  for (size_t i = 0; i < kPadBytes; i += 4) memcpy(at + i, &kNop, 4);
+}
+#endif
+
+#ifdef HOST_PATCH_HOOKER
+
+inline bool set_writable(void *target, bool writable) {
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t start = reinterpret_cast<uintptr_t>(target) & ~(page - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(target) + kPadBytes;
+  int prot = PROT_READ | PROT_EXEC | (writable ? PROT_WRITE : 0);
+  return mprotect(reinterpret_cast<void *>(start), end - start, prot) == 0;
+}
+
+inline int patch_hook(void *target, void *replace, void **backup) {
+  auto *code = static_cast<uint8_t *>(target);
+  if (!set_writable(target, true)) return -1;
+  write_jump(code, replace);
+  set_writable(target, false);
+  __builtin___clear_cache(reinterpret_cast<char *>(code),
+                          reinterpret_cast<char *>(code + kPadBytes));
+  *backup = code + kPadBytes;
+  return 0;
+}
+
+inline int patch_unhook(void *target) {
+  auto *code = static_cast<uint8_t *>(target);
+  if (!set_writable(target, true)) return -1;
+  write_pad(code);
+  set_writable(target, false);
+  __builtin___clear_cache(reinterpret_cast<char *>(code),
+                          reinterpret_cast<char *>(code + kPadBytes));
+  return 0;
+}
+
+inline const NativeAPIEntries kPatchApi{1, patch_hook, patch_unhook};
+
+#endif
@@ -0,0 +1,61 @@
+#include "config.hpp"
+#include "host_support.hpp"
+#include "property_cache.hpp"
+#include <cstring>
+#include <sys/system_properties.h>
+
+// Whitelisted properties are answered from their copy until their serial
+// moves; other names, and properties that do not exist, always reach the
+// property area.
+
+static int get(const char *name, char *value) {
+  return mock_call(__system_property_get, name, value);
+}
+
+int main() {
+  host_load_module();
+  host_property_set("ro.build.version.sdk", "34");
+  host_property_set("debug.other", "1");
+  property_cache_configure("ro.build.version.sdk\npersist.missing");
+  ModuleConfig config = kDefaultConfig;
+  config.features = kFeaturePropertyCache;
+  config_publish(config);
+
+  char value[PROP_VALUE_MAX];
+  uint64_t reads = host_property_reads();
+  CHECK(get("ro.build.version.sdk", value) == 2 && strcmp(value, "34") == 0);
+  CHECK(host_property_reads() == reads + 1);
+  CHECK(get("ro.build.version.sdk", value) == 2 && strcmp(value, "34") == 0);
+  CHECK(host_property_reads() == reads + 1);
+
+  // An update bumps the serial: the copy is stale, the new value is kept.
+  host_property_set("ro.build.version.sdk", "35");
+  CHECK(get("ro.build.version.sdk", value) == 2 && strcmp(value, "35") == 0);
+  CHECK(host_property_reads() == reads + 2);
+  CHECK(get("ro.build.version.sdk", value) == 2 && strcmp(value, "35") == 0);
+  CHECK(host_property_reads() == reads + 2);
+
+  // Not whitelisted.
+  for (int i = 0; i < 3; ++i) {
+    CHECK(get("debug.other", value) == 1 && strcmp(value, "1") == 0);
+  }
+  CHECK(host_property_reads() == reads + 5);
+
+  // Whitelisted but missing: nothing to validate a copy against.
+  for (int i = 0; i < 3; ++i) {
+    CHECK(get("persist.missing", value) == 0 && value[0] == '\0');
+  }
+  CHECK(host_property_reads() == reads + 8);
+  // Once it exists, it is cached like the others.
+  host_property_set("persist.missing", "on");
+  CHECK(get("persist.missing", value) == 2 && strcmp(value, "on") == 0);
+  CHECK(get("persist.missing", value) == 2 && strcmp(value, "on") == 0);
+  CHECK(host_property_reads() == reads + 9);
+
+  // Disabled: every read goes through.
+  config.features = 0;
+  config_publish(config);
+  CHECK(get("ro.build.version.sdk", value) == 2);
+  CHECK(host_property_reads() == reads + 10);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "host_support.hpp"
+#include "quiescence.hpp"
+#include <thread>
+#include <vector>
+
+// Readers never see an object that a writer has already reclaimed, whether
+// it waits itself (`quiescence_synchronize`) or retires the object.
+
+struct Object {
+  std::atomic<uint64_t> magic;
+};
+
+constexpr uint64_t kLive = 0x11f3;
+constexpr uint64_t kDead = 0xdead;
+constexpr int kReaders = 4;
+constexpr int kSwaps = 2000;
+
+static std::atomic<Object *> current{nullptr};
+
+static void reclaim(void *object) {
+  static_cast<Object *>(object)->magic.store(kDead);
+  delete static_cast<Object *>(object);
+}
+
+int main() {
+  current.store(new Object{kLive});
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; ++r) {
+    readers.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        uint32_t token = quiescence_enter();
+        Object *object = current.load(std::memory_order_acquire);
+        CHECK(object->magic.load(std::memory_order_relaxed) == kLive);
+        quiescence_exit(token);
+      }
+    });
+  }
+
+  for (int i = 0; i < kSwaps; ++i) {
+    Object *previous =
+        current.exchange(new Object{kLive}, std::memory_order_acq_rel);
+    if (i % 2 == 0) {
+      quiescence_synchronize();
+      reclaim(previous);
+    } else {
+      quiescence_retire(reclaim, previous);
+      if (i % 64 == 1) quiescence_reclaim();
+    }
+  }
+  stop.store(true);
+  for (auto &reader : readers) reader.join();
+  quiescence_reclaim();
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include "host_support.hpp"
+#include "remote_file.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+// A registered file is a snapshot: the app truncating or rewriting the file
+// neither faults nor changes what hooks read, and the `fopen` block list is
+// read from it.
+
+int main() {
+  char path[] = "/tmp/remote_file_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  unlink(path);
+  std::string text(3 * 4096, 'x');
+  text += "\nsecret\n";
+  CHECK(write(fd, text.data(), text.size()) ==
+        static_cast<ssize_t>(text.size()));
+  CHECK(remote_file_map("test.txt", fd) == static_cast<long>(text.size()));
+  CHECK(ftruncate(fd, 0) == 0);
+  CHECK(remote_file_view("test.txt") == text);
+  close(fd);
+
+  char list[] = "/tmp/remote_file_list_XXXXXX";
+  fd = mkstemp(list);
+  CHECK(fd >= 0);
+  unlink(list);
+  CHECK(write(fd, "nothing\nrule_test_\n", 19) == 19);
+  CHECK(remote_file_map("fopen_blocklist.txt", fd) == 19);
+  close(fd);
+
+  char blocked[] = "/tmp/rule_test_XXXXXX";
+  fd = mkstemp(blocked);
+  CHECK(fd >= 0);
+  close(fd);
+  host_load_module();
+  CHECK(mock_call(fopen, blocked, "r") == nullptr);
+  FILE *file = mock_call(fopen, "/dev/null", "r");
+  CHECK(file != nullptr);
+  fclose(file);
+  unlink(blocked);
+  return 0;
+}
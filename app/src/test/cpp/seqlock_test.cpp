@@ -0,0 +1,70 @@
+#include "config.hpp"
+#include "freeze.hpp"
+#include "host_support.hpp"
+#include "seqlock.hpp"
+#include <cstdio>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// A child forked while another thread is in the middle of a seqlock write
+// never waits for that writer: cache slots read as misses until the child
+// writes them again, and the configuration snapshot is completed by the
+// fork handler. Most children catch the large slot mid-write; a publish is
+// over too quickly to be caught often, so the configuration check only
+// counts when a fork happens to land in one.
+
+constexpr int kForks = 200;
+
+// Large enough that the writer spends most of its time inside `write`.
+struct Big {
+  uint64_t words[512];
+};
+
+static Seqlock<Big> slot;
+
+// Exit status of a child: 1 if it saw the slot mid-write, 0 if not.
+static int child() {
+  Big value;
+  bool torn = !slot.try_read(value);
+  if (!torn) {
+    for (uint64_t word : value.words) CHECK(word == value.words[0]);
+  }
+  value.words[0] = 7;
+  slot.write(value);
+  CHECK(slot.try_read(value) && value.words[0] == 7);
+  CHECK(config_read().sample_every >= 1);
+  return torn ? 1 : 0;
+}
+
+int main() {
+  // Registers the fork handlers.
+  freeze_seal();
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    Big value{};
+    ModuleConfig config = kDefaultConfig;
+    for (uint64_t n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+      for (uint64_t &word : value.words) word = n;
+      slot.write(value);
+      config.rules_version = static_cast<uint32_t>(n);
+      config_publish(config);
+    }
+  });
+
+  int torn = 0;
+  for (int i = 0; i < kForks; ++i) {
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) _exit(child());
+    int status = 0;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) <= 1);
+    torn += WEXITSTATUS(status);
+  }
+  stop.store(true);
+  writer.join();
+  printf("%d of %d children forked mid-write\n", torn, kForks);
+  CHECK(torn > 0);
+  return 0;
+}
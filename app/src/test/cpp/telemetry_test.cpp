@@ -0,0 +1,93 @@
+#include "freeze.hpp"
+#include "host_support.hpp"
+#include "telemetry.hpp"
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Processes that map the telemetry file at the same time set it up once and
+// each publish into a slot of their own; a forked child moves to a new slot.
+
+constexpr int kChildren = 6;
+
+static TelemetryProcess *slot_of(TelemetryFile *file, pid_t pid) {
+  for (auto &process : file->process) {
+    if (process.pid.load() == static_cast<uint32_t>(pid)) return &process;
+  }
+  return nullptr;
+}
+
+static void wait_ok(pid_t pid) {
+  int status = 0;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main() {
+  freeze_seal();
+  char path[] = "/tmp/telemetry_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  unlink(path);
+  CHECK(ftruncate(fd, kTelemetrySize) == 0);
+  auto *file = static_cast<TelemetryFile *>(mmap(
+      nullptr, kTelemetrySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  CHECK(file != MAP_FAILED);
+
+  // All children map the file at once, and stay until all of them have;
+  // child `i` counts hook `i` i+1 times.
+  auto *shared = static_cast<std::atomic<int> *>(
+      mmap(nullptr, 2 * sizeof(std::atomic<int>), PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  CHECK(shared != MAP_FAILED);
+  std::atomic<int> &start = shared[0];
+  std::atomic<int> &mapped = shared[1];
+  pid_t children[kChildren];
+  for (int i = 0; i < kChildren; ++i) {
+    children[i] = fork();
+    CHECK(children[i] >= 0);
+    if (children[i] == 0) {
+      while (start.load() == 0) {
+      }
+      for (int n = 0; n <= i; ++n) stat_count(static_cast<HookId>(i));
+      CHECK(telemetry_map(fd));
+      mapped.fetch_add(1);
+      while (mapped.load() < kChildren) {
+      }
+      _exit(0);
+    }
+  }
+  start.store(1);
+  for (pid_t child : children) wait_ok(child);
+
+  CHECK(file->state.load() == kTelemetryReady);
+  for (int i = 0; i < kChildren; ++i) {
+    TelemetryProcess *process = slot_of(file, children[i]);
+    CHECK(process != nullptr);
+    CHECK(process->hooks[i].calls.load() == static_cast<uint64_t>(i) + 1);
+  }
+
+  // The parent takes over a slot of an exited child, and its own child
+  // publishes elsewhere.
+  stat_count(kHookTargetFun);
+  CHECK(telemetry_map(fd));
+  TelemetryProcess *parent = slot_of(file, getpid());
+  CHECK(parent != nullptr);
+  CHECK(parent->hooks[kHookTargetFun].calls.load() == 1);
+  pid_t child = fork();
+  CHECK(child >= 0);
+  if (child == 0) {
+    stat_count(kHookTargetFun);
+    telemetry_publish_calls();
+    telemetry_event(kEventHookInstalled, kHookFopen, 0);
+    _exit(telemetry_process.load() == parent ? 1 : 0);
+  }
+  wait_ok(child);
+  CHECK(slot_of(file, child)->hooks[kHookTargetFun].calls.load() == 2);
+  CHECK(slot_of(file, child)->event_head.load() == 1);
+  CHECK(parent->pid.load() == static_cast<uint32_t>(getpid()));
+  CHECK(parent->hooks[kHookTargetFun].calls.load() == 1);
+  CHECK(parent->event_head.load() == 0);
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "config.hpp"
+#include "hook_dispatch.hpp"
+#include "host_support.hpp"
+#include <thread>
+
+// A handler over budget is switched to pass-through within a few windows,
+// and stays there.
+
+static int original() { return 1; }
+static int (*backup_original)() = original;
+static std::atomic<int> handled{0};
+
+static int slow_handler() {
+  handled.fetch_add(1);
+  int64_t start = host_now_ns();
+  while (host_now_ns() - start < 20000) {
+  }
+  return call_backup(backup_original) + 1;
+}
+
+static HandlerSlot<int()> slot{slow_handler};
+
+static void trip() { slot.exchange(pass_through<backup_original>); }
+
+static HookBudget budget{kHookTargetFun, trip};
+
+static int fake() { return hook_dispatch(budget, slot, backup_original); }
+
+int main() {
+  ModuleConfig config = kDefaultConfig;
+  config.sample_every = 1;
+  config_publish(config);
+  watchdog_configure(1000, 20, 4);
+  watchdog_register(budget);
+  watchdog_start();
+
+  int64_t deadline = host_now_ns() + 2'000'000'000;
+  while (!budget.tripped.load() && host_now_ns() < deadline) {
+    CHECK(fake() >= 1);
+  }
+  CHECK(budget.tripped.load());
+
+  // `tripped` is set just before the swap; let the watchdog finish it.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int before = handled.load();
+  for (int i = 0; i < 100; ++i) CHECK(fake() == 1);
+  CHECK(handled.load() == before);
+  return 0;
+}